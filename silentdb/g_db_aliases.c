@@ -19,6 +19,9 @@
 	Players that are handled by updates are always buffered. Buffering happens only with updates. Aliases of the buffered players are
 	always kept in the last used first in the list order. They are also written to the file in this order.
 
+	Both the buffered players and the players read from the file are indexed by the guid hash. The buffered player of a client is
+	also remembered in the client slot, so the renames of the same client go straight to it.
+
 	Only buffered players are written to the file unless the file is truncated. Before closing the aliases database, the game should
 	ensure update of all the player aliases it wants to be stored.
 */
@@ -26,6 +29,13 @@
 #include "g_local.h"
 #include "g_db_filehandling.h"
 #include "g_db_aliases.h"
+#include "g_db_guid.h"
+#include "g_db_namescan.h"
+#include "g_db_hashindex.h"
+#include "g_db_trigram.h"
+#include "g_db_interval.h"
+#include "g_db_cursor.h"
+#include "g_db_fuzzy.h"
 
 #define DB_ALIASES_VERSION "SLEnT UADB v0.4\0"
 #define DB_ALIASES_VERSIONSIZE 16
@@ -62,8 +72,11 @@ typedef struct db_aliases_aliasesrecord_s {
 typedef struct db_aliases_insertrecord_s {
 	db_alias_t	alias;
 	struct db_aliases_insertrecord_s *next;
+	uint32_t	entry;		// the entry of the alias in the indexes or DB_ALIASES_NOENTRY
 } db_aliases_insertrecord_t;
 
+#define DB_ALIASES_NOENTRY 0xffffffff
+
 // structure is used only in the program, not in the file, the header is copied to the root,
 // the alias records are copied into the allocated array of records
 typedef struct db_playeraliases_s {
@@ -76,8 +89,17 @@ typedef struct db_playeraliases_s {
 	uint32_t	newRecords;
 	uint32_t	filePos;		// the player header position in the db file
 	uint32_t	actions;
+	uint32_t	searchEpoch;	// the name search that last found the player
+	uint32_t	searchResult;	// the position of the player in the results of that search
 } db_playeraliases_t;
 
+// one alias of the name index, either a record read from the file or an insert record
+typedef struct db_aliases_entry_s {
+	db_playeraliases_t			*player;	// the file player is replaced by the buffered one once it is buffered
+	db_aliases_aliasesrecord_t	*record;	// NULL for the insert records
+	db_alias_t					*alias;
+} db_aliases_entry_t;
+
 typedef struct db_buffered_player_s {
 	db_playeraliases_t	player;
 	struct db_buffered_player_s *next;
@@ -93,6 +115,14 @@ typedef struct db_aliases_info_s {
 	uint32_t				pool_size;
 	uint32_t				pool_index;
 	db_buffered_player_t	*buffer;
+	db_buffered_player_t	*buffer_last;	// the buffer is appended from the end
+	db_hashindex_t			player_index;	// guidHash -> players of the buffer and the file
+	// the name index, the trigram ids are the positions in the entries
+	db_trigram_t			name_index;
+	db_interval_t			activity_index;	// first_seen - last_seen of the entries
+	db_aliases_entry_t		*entries;
+	uint32_t				entry_count;
+	uint32_t				entry_size;
 	//
 	qboolean				aliases_inuse;	// if the database is usable or not
 	uint32_t				actions;
@@ -102,6 +132,8 @@ static db_aliases_info_t aliases_info;
 static db_playeraliases_t *searchedPlayer;
 static db_aliases_insertrecord_t *searchedRecord;
 static uint32_t positionIndex;
+// the buffered player of the client, renames of the same client don't need the lookup
+static db_playeraliases_t *client_players[MAX_CLIENTS];
 
 // static memory pools
 // player buffer
@@ -119,17 +151,67 @@ static uint32_t aliases_pool_index;
 typedef struct db_aliases_searchedplayer_aliases_s {
 	db_playeraliases_t	*player;
 	db_alias_t			*aliases[ALIASES_DB_MAXALIASES_FORONERESULT];
+	uint32_t			numberOfAliases;
+	qboolean			dontFit;
 } db_aliases_searchedplayer_aliases_t;
 
 typedef struct db_aliases_searchcache_s {
 	char		search_pattern[MAX_NAME_LENGTH];  // needed for fine graining the results
 	uint32_t	used_cache;						// the amount of players in search cache
 	uint32_t	iterator;						// the iterator used with the result fetching
-	// pointers to the player data, or NULL
-	const db_playeraliases_t *results[ALIASES_DB_MAXSEARCHCACHE];  // the last results as indexes
+	uint32_t	epoch;							// unique for every search, marks the found players
+	uint32_t	changes;						// aliases_changes at the search, older results are stale
+	uint32_t	used;							// the last use, the least recently used one is replaced
+	qboolean	timed;							// only the aliases active between from and to are found
+	int			from;
+	int			to;
+	qboolean	overflow;						// more players found than fit into the cache
+	qboolean	fuzzed;							// the pattern ends with ~, the names are matched with fuzzy
+	db_fuzzy_t	fuzzy;
+	// the found players and their matching aliases
+	db_aliases_searchedplayer_aliases_t results[ALIASES_DB_MAXSEARCHCACHE];
 } db_aliases_searchcache_t;
 
-static db_aliases_searchcache_t search_cache;
+// the recent searches are kept, so admins paging through the results or repeating a search
+// don't search again
+#define ALIASES_DB_SEARCHENTRIES 4
+
+typedef struct db_aliases_searchsession_s {
+	db_aliases_searchcache_t	*entry;		// the results of the last search of the client
+	uint32_t					epoch;		// the epoch of the entry when searched, the entry may be reused
+} db_aliases_searchsession_t;
+
+static db_aliases_searchcache_t search_entries[ALIASES_DB_SEARCHENTRIES];
+static db_aliases_searchcache_t *search_cache = &search_entries[0];		// the one being searched
+// the clients and the console as the last one
+static db_aliases_searchsession_t search_sessions[MAX_CLIENTS + 1];
+static uint32_t search_epoch;
+static uint32_t search_clock;
+// increased when the aliases change, the kept searches are searched again after it
+static uint32_t aliases_changes;
+// the entries of the last fetched cursor page
+static uint32_t cursor_entries[SIL_DB_MAXCURSORPAGE];
+static uint32_t cursor_count;
+
+// the page of a cursor fetch
+typedef struct db_aliases_playersearch_s {
+	char					pattern[MAX_NAME_LENGTH];	// sanitized
+	const db_fuzzy_t		*fuzzy;		// NULL if the pattern is not fuzzy
+	db_fuzzy_t				compiled;
+	qboolean				timed;
+	int						from;
+	int						to;
+	uint32_t				epoch;		// marks the visited players
+	db_alias_playervisit_f	visit;
+	void					*context;
+} db_aliases_playersearch_t;
+
+typedef struct db_aliases_cursorfetch_s {
+	const db_alias_cursor_t	*cursor;
+	db_cursorpage_t			page;
+	const db_fuzzy_t		*fuzzy;		// NULL if the pattern is not fuzzy
+	db_fuzzy_t				compiled;
+} db_aliases_cursorfetch_t;
 
 /*
 	Semi memory pool handling
@@ -205,70 +287,65 @@ static db_aliases_insertrecord_t* DB_GetAliasInsertRecord(const db_playeraliases
 	return NULL;
 }
 
-static db_playeraliases_t* DB_GetPlayer(const uint32_t guidHash, const char *guid)
+static qboolean DB_IsBufferedPlayer(const db_aliases_info_t *info, const db_playeraliases_t *player)
+{
+	return (player < info->players || player >= info->players + info->player_count) ? qtrue : qfalse;
+}
+
+// returns the buffered player, the player read from the file is returned through cachedPlayer
+static db_playeraliases_t* DB_FindPlayer(const uint32_t guidHash, const char *guid, db_playeraliases_t **cachedPlayer)
 {
 	db_aliases_info_t *info = &aliases_info;
-	db_buffered_player_t *buffered = info->buffer;
-	db_playeraliases_t *cachedPlayer = NULL;
-	uint32_t lastIndex = 0;
-	uint32_t i;
+	db_playeraliases_t *player;
+	uint32_t iterator;
 
-	while( buffered ) {
-		if( buffered->player.guidHash == guidHash && !memcmp(buffered->player.guid, guid, sizeof(buffered->player.guid)) ) {
-			// found the player from player buffer, returning that
-			return &buffered->player;
+	*cachedPlayer = NULL;
+
+	for( player = G_DB_HashIndex_First(&info->player_index, guidHash, &iterator) ; player ;
+		player = G_DB_HashIndex_Next(&info->player_index, guidHash, &iterator) ) {
+		if( !G_DB_GUID_MatchesRaw((const char*)player->guid, guid) ) {
+			continue;
 		}
-		buffered = buffered->next;
-	}
-	// search the player from the loaded data
-	lastIndex = info->player_count;
-	for( i = 0; i < lastIndex ; i++ ) {
-		cachedPlayer = &info->players[i];
-		if( cachedPlayer->guidHash == guidHash && !memcmp(cachedPlayer->guid, guid, sizeof(cachedPlayer->guid)) ) {
-			return cachedPlayer;
+		if( DB_IsBufferedPlayer(info, player) ) {
+			// there is only one buffered player for a guid
+			return player;
+		}
+		// the first one in the file wins, like with the sequential scan
+		if( !*cachedPlayer || player < *cachedPlayer ) {
+			*cachedPlayer = player;
 		}
 	}
 
 	return NULL;
 }
 
+static db_playeraliases_t* DB_GetPlayer(const uint32_t guidHash, const char *guid)
+{
+	db_playeraliases_t *cachedPlayer;
+	db_playeraliases_t *player;
+
+	player = DB_FindPlayer(guidHash, guid, &cachedPlayer);
+
+	return player ? player : cachedPlayer;
+}
+
 static db_playeraliases_t* DB_GetPlayerOrCreate(const uint32_t guidHash, const char *guid)
 {
 	db_aliases_info_t *info = &aliases_info;
-	db_buffered_player_t *bufferedPlayer = info->buffer;
 	db_buffered_player_t *player = NULL;
 	db_playeraliases_t *cachedPlayer = NULL;
-	uint32_t lastIndex = 0;
-	uint32_t i;
-	qboolean found;
+	db_playeraliases_t *bufferedPlayer;
 
-	while( bufferedPlayer ) {
-		player = bufferedPlayer;
-		if( player->player.guidHash == guidHash && !memcmp(player->player.guid, guid, sizeof(player->player.guid)) ) {
-			// found the player from player buffer, returning that
-			return &player->player;
-		}
-		bufferedPlayer = bufferedPlayer->next;
-	}
-	// store back the last non NULL player, for the pointer work
-	if( player ) {
-		bufferedPlayer = player;
-	}
-	// search the player from the loaded data
-	found = qfalse;
-	lastIndex = info->player_count;
-	for( i = 0; i < lastIndex ; i++ ) {
-		cachedPlayer = &info->players[i];
-		if( cachedPlayer->guidHash == guidHash && !memcmp(cachedPlayer->guid, guid, sizeof(cachedPlayer->guid)) ) {
-			found = qtrue;
-			break;
-		}
+	bufferedPlayer = DB_FindPlayer(guidHash, guid, &cachedPlayer);
+	if( bufferedPlayer ) {
+		// found the player from player buffer, returning that
+		return bufferedPlayer;
 	}
 
 	// player is not in the buffer, it is created and added to it now
 	player = DB_AllocPlayerAlias();
 
-	if( found ) {
+	if( cachedPlayer ) {
 		// copy data if the player was found from old
 		memcpy(&player->player, cachedPlayer, sizeof(player->player));
 		cachedPlayer->actions |= ALIASES_ACTION_SKIP;
@@ -277,6 +354,7 @@ static db_playeraliases_t* DB_GetPlayerOrCreate(const uint32_t guidHash, const c
 		memcpy(player->player.guid, guid, sizeof(player->player.guid));
 		player->player.records = NULL;
 		player->player.numberOfRecords = 0;
+		player->player.actions = ALIASES_ACTION_NONE;
 		// mark the file for rewrite
 		aliases_info.actions = ALIASES_ACTION_DIRTY;
 	}
@@ -285,18 +363,121 @@ static db_playeraliases_t* DB_GetPlayerOrCreate(const uint32_t guidHash, const c
 	player->player.numberOfInsertRecords = 0;
 	// no new records yet
 	player->player.newRecords = 0;
+	player->player.searchEpoch = 0;
 
 	// set up pointers
 	player->next = NULL;
-	if( bufferedPlayer ) {
-		bufferedPlayer->next = player;
+	if( info->buffer_last ) {
+		info->buffer_last->next = player;
 	} else {
 		info->buffer = player;
 	}
+	info->buffer_last = player;
+
+	if( G_DB_HashIndex_Insert(&info->player_index, guidHash, &player->player) == -1 ) {
+		G_LogPrintf("Aliases: out of memory when indexing a player.\n");
+	}
 
 	return &player->player;
 }
 
+static const char* DB_AliasEntryText(uint32_t id, void *context)
+{
+	return aliases_info.entries[id].alias->clean_name;
+}
+
+// adds the alias to the name and the activity indexes, returns the entry or DB_ALIASES_NOENTRY
+static uint32_t DB_IndexAlias(db_playeraliases_t *player, db_aliases_aliasesrecord_t *record, db_alias_t *alias)
+{
+	db_aliases_info_t *info = &aliases_info;
+	db_aliases_entry_t *entries;
+	uint32_t size;
+
+	if( info->entry_count == info->entry_size ) {
+		size = info->entry_size ? info->entry_size * 2 : 64;
+		entries = (db_aliases_entry_t*)realloc(info->entries, sizeof(db_aliases_entry_t) * size);
+		if( !entries ) {
+			G_LogPrintf("Aliases: out of memory when indexing an alias.\n");
+			return DB_ALIASES_NOENTRY;
+		}
+		info->entries = entries;
+		info->entry_size = size;
+	}
+
+	info->entries[info->entry_count].player = player;
+	info->entries[info->entry_count].record = record;
+	info->entries[info->entry_count].alias = alias;
+
+	if( G_DB_Trigram_Add(&info->name_index, info->entry_count, alias->clean_name) == -1 && info->name_index.buckets ) {
+		G_LogPrintf("Aliases: out of memory when indexing an alias.\n");
+		return DB_ALIASES_NOENTRY;
+	}
+	// a span missing from the activity index only hides the alias from the time searches
+	G_DB_Interval_Set(&info->activity_index, info->entry_count, alias->first_seen, alias->last_seen);
+
+	return info->entry_count++;
+}
+
+// indexes the players and the aliases read from the file
+static void DB_IndexPlayers(void)
+{
+	db_aliases_info_t *info = &aliases_info;
+	uint32_t i, j;
+
+	G_DB_HashIndex_Init(&info->player_index, info->player_count + BUFFER_POOL_SIZE / sizeof(db_buffered_player_t));
+
+	for( i = 0; i < info->player_count ; i++ ) {
+		info->players[i].searchEpoch = 0;
+		if( G_DB_HashIndex_Insert(&info->player_index, info->players[i].guidHash, &info->players[i]) == -1 ) {
+			G_LogPrintf("  Out of memory when indexing the aliases players.\n");
+			return;
+		}
+	}
+
+	// the entries of the file records first, then the trigrams over them in one build
+	info->entry_count = 0;
+	info->entry_size = info->file_header.records_count + BUFFER_POOL_SIZE / sizeof(db_buffered_player_t);
+	info->entries = (db_aliases_entry_t*)malloc(sizeof(db_aliases_entry_t) * info->entry_size);
+	if( !info->entries ) {
+		info->entry_size = 0;
+		G_LogPrintf("  Out of memory when indexing the aliases.\n");
+		return;
+	}
+
+	for( i = 0; i < info->player_count ; i++ ) {
+		for( j = 0; j < info->players[i].numberOfRecords && info->entry_count < info->entry_size ; j++ ) {
+			info->entries[info->entry_count].player = &info->players[i];
+			info->entries[info->entry_count].record = &info->players[i].records[j];
+			info->entries[info->entry_count].alias = &info->players[i].records[j].alias;
+			info->entry_count++;
+		}
+	}
+
+	if( G_DB_Trigram_Build(&info->name_index, info->entry_count, DB_AliasEntryText, NULL) == -1 ) {
+		G_LogPrintf("  Out of memory when indexing the alias names, the searches scan all aliases.\n");
+	}
+
+	for( i = 0; i < info->entry_count ; i++ ) {
+		G_DB_Interval_Set(&info->activity_index, i, info->entries[i].alias->first_seen, info->entries[i].alias->last_seen);
+	}
+	G_DB_Interval_Build(&info->activity_index);
+}
+
+static void DB_FreeIndexes(void)
+{
+	db_aliases_info_t *info = &aliases_info;
+
+	G_DB_HashIndex_Free(&info->player_index);
+	G_DB_Trigram_Free(&info->name_index);
+	G_DB_Interval_Free(&info->activity_index);
+	free(info->entries);
+	info->entries = NULL;
+	info->entry_count = 0;
+	info->entry_size = 0;
+	cursor_count = 0;
+	aliases_changes++;
+}
+
 /*
 	Aliases file handling
 */
@@ -719,6 +900,10 @@ int G_DB_InitAliases(void)
 
 	// buffer
 	aliases_info.buffer = NULL;
+	aliases_info.buffer_last = NULL;
+	memset(client_players, 0, sizeof(client_players));
+
+	DB_IndexPlayers();
 
 	aliases_info.aliases_inuse = qtrue;
 
@@ -743,7 +928,11 @@ void G_DB_CloseAliases(void)
 			DB_WriteAliasesToFile();
 		}
 	}
-	// free all dynamic memory
+	// free all dynamic memory, the buffered players were released when written
+	DB_FreeIndexes();
+	memset(client_players, 0, sizeof(client_players));
+	aliases_info.buffer = NULL;
+	aliases_info.buffer_last = NULL;
 	free(aliases_info.memory_pool);
 	free(aliases_info.players);
 }
@@ -774,6 +963,7 @@ void G_DB_CleanUpAliases(void)
 		G_LogPrintf("  Issued delete to aliases from %d players without associated records in the main database.\n", unlinkableAliases);
 		// mark the file into truncate
 		info->actions = ALIASES_ACTION_DIRTY;
+		aliases_changes++;
 	} else {
 		G_LogPrintf("  All records in the aliases database have associated player records in the main database.\n");
 	}
@@ -781,9 +971,7 @@ void G_DB_CleanUpAliases(void)
 
 void G_DB_RemoveAliases(const char *guid, uint32_t guidHash)
 {
-	db_playeraliases_t	*player;
-	char guid_l[32];
-	int i;
+	db_guid_t guid_l;
 
 	if( !aliases_info.aliases_inuse ) {
 		return;
@@ -791,23 +979,31 @@ void G_DB_RemoveAliases(const char *guid, uint32_t guidHash)
 
 	if( !guidHash ) {
 		// set up the data, ensure uppercase letters and create hash value
-		for(i=0; i < 32 && guid[i] ;i++) {
-			guid_l[i]=toupper(guid[i]);
-		}
-		if(i!=32) { return; }
+		if( !G_DB_GUID_Set(&guid_l, guid) ) { return; }
+	} else {
+		memcpy(guid_l.guid, guid, sizeof(guid_l.guid));
+		guid_l.hash = guidHash;
+	}
 
-		guidHash = BG_hashword((const uint32_t*)guid_l, 8, 0);
+	G_DB_RemoveAliasesGUID(&guid_l);
+}
 
-		player = DB_GetPlayer(guidHash, guid_l);
-	} else {
-		player = DB_GetPlayer(guidHash, guid);
+void G_DB_RemoveAliasesGUID(const db_guid_t *guid)
+{
+	db_playeraliases_t	*player;
+
+	if( !aliases_info.aliases_inuse ) {
+		return;
 	}
 
+	player = DB_GetPlayer(guid->hash, guid->guid);
+
 	if( !player ) {
 		return;
 	}
 
 	player->actions |= ALIASES_ACTION_REMOVE;
+	aliases_changes++;
 	// truncate the file, no matter if that player removed wasn't even written in the old file yet
 	aliases_info.actions = ALIASES_ACTION_DIRTY;
 }
@@ -858,45 +1054,23 @@ qboolean G_DB_RemoveAliasesShortGUID(const char *shortGuid)
 	}
 
 	searchedPlayer->actions |= ALIASES_ACTION_REMOVE;
+	aliases_changes++;
 	// truncate the file, no matter if that player removed wasn't even written in the old file yet
 	aliases_info.actions = ALIASES_ACTION_DIRTY;
 
 	return qtrue;
 }
 
-/**
- *	Function updates alias data or inserts new one if needed.
- */
-void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHash)
+// updates the alias of the buffered player or inserts new one if needed
+static void DB_UpdatePlayerAlias(db_playeraliases_t *player, const db_alias_t *alias)
 {
-	db_playeraliases_t	*player;
 	db_aliases_insertrecord_t *oldAlias;
 	db_aliases_aliasesrecord_t *oldCachedAlias;
 	db_aliases_insertrecord_t *aliasInsert = NULL;
-	uint32_t i;
-	char guid_l[32];
-
-	if( !aliases_info.aliases_inuse ) {
-		return;
-	}
 
-	if( !guidHash ) {
-		// set up the data, ensure uppercase letters and create hash value
-		for(i=0; i < 32 && guid[i] ;i++) {
-			guid_l[i]=toupper(guid[i]);
-		}
-		if(i!=32) { return; }
-
-		guidHash = BG_hashword((const uint32_t*)guid_l, 8, 0);
-
-		player = DB_GetPlayerOrCreate(guidHash, guid_l);
-	} else {
-		player = DB_GetPlayerOrCreate(guidHash, guid);
-	}
+	// the times and the names of the aliases in the kept searches change
+	aliases_changes++;
 
-	if( !player ) {
-		return;
-	}
 	// append the new alias, at this time the aliases are searched to find if the alias already exists
 	oldAlias = DB_GetAliasInsertRecord(player, alias->clean_name);
 
@@ -904,6 +1078,9 @@ void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHa
 		oldAlias->alias.last_seen = alias->last_seen;
 		oldAlias->alias.time_played += alias->time_played;
 		Q_strncpyz(oldAlias->alias.name, alias->name, sizeof(oldAlias->alias.name));
+		if( oldAlias->entry != DB_ALIASES_NOENTRY ) {
+			G_DB_Interval_Set(&aliases_info.activity_index, oldAlias->entry, oldAlias->alias.first_seen, oldAlias->alias.last_seen);
+		}
 		// needs to be shifted to the front, since it is the last used
 		if( oldAlias != player->insertlist ) {
 			db_aliases_insertrecord_t *tmp = player->insertlist;
@@ -951,9 +1128,78 @@ void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHa
 	aliasInsert->next = player->insertlist;
 	player->insertlist = aliasInsert;
 	player->numberOfInsertRecords++;
+
+	aliasInsert->entry = DB_IndexAlias(player, NULL, &aliasInsert->alias);
 	// done
 }
 
+void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHash)
+{
+	db_playeraliases_t	*player;
+	db_guid_t guid_l;
+
+	if( !aliases_info.aliases_inuse ) {
+		return;
+	}
+
+	if( !guidHash ) {
+		// set up the data, ensure uppercase letters and create hash value
+		if( !G_DB_GUID_Set(&guid_l, guid) ) { return; }
+
+		player = DB_GetPlayerOrCreate(guid_l.hash, guid_l.guid);
+	} else {
+		player = DB_GetPlayerOrCreate(guidHash, guid);
+	}
+
+	if( !player ) {
+		return;
+	}
+
+	DB_UpdatePlayerAlias(player, alias);
+}
+
+void G_DB_UpdateClientAlias(int clientNum, const char *guid, const db_alias_t *alias, uint32_t guidHash)
+{
+	db_playeraliases_t	*player;
+	db_guid_t guid_l;
+
+	if( !aliases_info.aliases_inuse ) {
+		return;
+	}
+
+	if( clientNum < 0 || clientNum >= MAX_CLIENTS ) {
+		G_DB_UpdateAlias(guid, alias, guidHash);
+		return;
+	}
+
+	if( !guidHash ) {
+		if( !G_DB_GUID_Set(&guid_l, guid) ) { return; }
+		guid = guid_l.guid;
+		guidHash = guid_l.hash;
+	}
+
+	player = client_players[clientNum];
+	// the buffered players stay in place until the database is closed, the guid check covers the reused slots
+	if( !player || player->guidHash != guidHash || !G_DB_GUID_MatchesRaw((const char*)player->guid, guid) ) {
+		player = DB_GetPlayerOrCreate(guidHash, guid);
+		client_players[clientNum] = player;
+		if( !player ) {
+			return;
+		}
+	}
+
+	DB_UpdatePlayerAlias(player, alias);
+}
+
+void G_DB_ClearClientAlias(int clientNum)
+{
+	if( clientNum < 0 || clientNum >= MAX_CLIENTS ) {
+		return;
+	}
+	client_players[clientNum] = NULL;
+	search_sessions[clientNum].entry = NULL;
+}
+
 /**
 	Function returns the number of aliases and sets the internal iterator to the first alias if available.
 
@@ -963,44 +1209,34 @@ void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHa
 */
 int G_DB_GetAliases(const char *guid, const int start)
 {
-	db_aliases_info_t *info = &aliases_info;
-	db_buffered_player_t *buffered = info->buffer;
-	db_playeraliases_t *player = NULL;
-	uint32_t guidHash;
-	uint32_t i;
-	char guid_l[32];
-	qboolean found;
+	db_guid_t guid_l;
 
 	if( !aliases_info.aliases_inuse ) {
 		return -1;
 	}
 
 	// set up the data, ensure uppercase letters and create hash value
-	for(i=0; i < 32 && guid[i] ;i++) {
-		guid_l[i]=toupper(guid[i]);
-	}
-	if(i!=32) { return -2; }
+	if( !G_DB_GUID_Set(&guid_l, guid) ) { return -2; }
 
-	guidHash = BG_hashword((const uint32_t*)guid_l, 8, 0);
+	return G_DB_GetAliasesGUID(&guid_l, start);
+}
 
-	// only from buffer
-	found = qfalse;
-	while( buffered ) {
-		player = &buffered->player;
-		buffered = buffered->next;
-		if( player->actions & ALIASES_ACTION_REMOVE ) {
-			continue;
-		}
-		if( player->guidHash == guidHash && !memcmp(player->guid, guid_l, sizeof(player->guid)) ) {
-			searchedPlayer = player;
-			found = qtrue;
-			break;
-		}
+int G_DB_GetAliasesGUID(const db_guid_t *guid, const int start)
+{
+	db_playeraliases_t *cachedPlayer;
+	db_playeraliases_t *player = NULL;
+	uint32_t i;
+
+	if( !aliases_info.aliases_inuse ) {
+		return -1;
 	}
 
-	if( !found ) {
+	// only from buffer
+	player = DB_FindPlayer(guid->hash, guid->guid, &cachedPlayer);
+	if( !player || (player->actions & ALIASES_ACTION_REMOVE) ) {
 		return -3;
 	}
+	searchedPlayer = player;
 
 	// moving the position to the correct place
 	// start from insert buffer and then the old records
@@ -1126,134 +1362,492 @@ int G_DB_SearchAliasesShortGUID(const char *guid, const int start)
 	return (searchedPlayer->newRecords + searchedPlayer->numberOfRecords);
 }
 
-static int DB_SearchNamePatterns(const db_playeraliases_t *player, const char *pattern)
+// returns the player currently holding the aliases of the entry
+static db_playeraliases_t* DB_GetEntryPlayer(const db_aliases_entry_t *entry)
 {
-	db_aliases_insertrecord_t *inserts = player->insertlist;
-	db_aliases_aliasesrecord_t *old = NULL;
-	uint32_t i;
+	db_playeraliases_t *player = entry->player;
+	db_playeraliases_t *cachedPlayer;
 
-	while( inserts ) {
-		if( strstr(inserts->alias.clean_name, pattern) != NULL ) {
-			if( search_cache.used_cache == ALIASES_DB_MAXSEARCHCACHE ) {
-				return -1;
-			}
-			search_cache.results[search_cache.used_cache] = player;
-			search_cache.used_cache++;
-			return 1;
+	if( !DB_IsBufferedPlayer(&aliases_info, player) && (player->actions & ALIASES_ACTION_SKIP) ) {
+		// the player was copied to the buffer, the records are shared with the copy
+		player = DB_FindPlayer(player->guidHash, (const char*)player->guid, &cachedPlayer);
+	}
+
+	return player;
+}
+
+// returns the player of the entry if the entry matches the search, NULL otherwise. The fuzzy
+// pattern is used instead of the pattern if set.
+static db_playeraliases_t* DB_MatchAliasEntry(uint32_t id, const char *pattern, const db_fuzzy_t *fuzzy, qboolean timed, int from, int to)
+{
+	const db_aliases_entry_t *entry = &aliases_info.entries[id];
+	db_playeraliases_t *player;
+
+	// the index candidates are verified, the entries of the outdated records are skipped
+	if( entry->record && (entry->record->actions & ALIASES_ACTION_SKIP) ) {
+		return NULL;
+	}
+	if( fuzzy ? !G_DB_Fuzzy_Matches(fuzzy, entry->alias->clean_name) : !strstr(entry->alias->clean_name, pattern) ) {
+		return NULL;
+	}
+	if( timed && (entry->alias->first_seen > to || entry->alias->last_seen < from) ) {
+		return NULL;
+	}
+	player = DB_GetEntryPlayer(entry);
+	if( !player || (player->actions & (ALIASES_ACTION_REMOVE | ALIASES_ACTION_SKIP)) ) {
+		return NULL;
+	}
+
+	return player;
+}
+
+static qboolean DB_SearchAliasVisit(uint32_t id, void *context)
+{
+	const db_aliases_entry_t *entry = &aliases_info.entries[id];
+	db_aliases_searchedplayer_aliases_t *result;
+	db_playeraliases_t *player;
+
+	player = DB_MatchAliasEntry(id, search_cache->search_pattern, search_cache->fuzzed ? &search_cache->fuzzy : NULL,
+		search_cache->timed, search_cache->from, search_cache->to);
+	if( !player ) {
+		return qtrue;
+	}
+
+	if( player->searchEpoch == search_cache->epoch ) {
+		result = &search_cache->results[player->searchResult];
+	} else {
+		if( search_cache->used_cache == ALIASES_DB_MAXSEARCHCACHE ) {
+			search_cache->overflow = qtrue;
+			return qfalse;
 		}
-		inserts = inserts->next;
+		result = &search_cache->results[search_cache->used_cache];
+		result->player = player;
+		result->numberOfAliases = 0;
+		result->dontFit = qfalse;
+		player->searchEpoch = search_cache->epoch;
+		player->searchResult = search_cache->used_cache;
+		search_cache->used_cache++;
 	}
 
-	for( i = 0; i < player->numberOfRecords ; i++ ) {
-		old = &player->records[i];
-		if( old->actions & ALIASES_ACTION_SKIP ) {
-			continue;
+	if( result->numberOfAliases == ALIASES_DB_MAXALIASES_FORONERESULT ) {
+		result->dontFit = qtrue;
+	} else {
+		result->aliases[result->numberOfAliases] = entry->alias;
+		result->numberOfAliases++;
+	}
+
+	return qtrue;
+}
+
+// visits the candidates of the name from the trigram index, -1 if the index can't be used
+static int DB_SearchAliasNames(const char *pattern, const db_fuzzy_t *fuzzy, db_trigram_visit_f visit, void *context)
+{
+	if( fuzzy ) {
+		return G_DB_Trigram_SearchApprox(&aliases_info.name_index, fuzzy->pattern, fuzzy->maxErrors, visit, context);
+	}
+	return G_DB_Trigram_Search(&aliases_info.name_index, pattern, visit, context);
+}
+
+static db_aliases_searchsession_t* DB_GetAliasSession(int clientNum)
+{
+	if( clientNum < 0 || clientNum >= MAX_CLIENTS ) {
+		return &search_sessions[MAX_CLIENTS];
+	}
+	return &search_sessions[clientNum];
+}
+
+static int DB_AliasSearchResult(const db_aliases_searchcache_t *entry)
+{
+	return entry->overflow ? -2 : (int)entry->used_cache;
+}
+
+// true if the kept search has the same parameters and the aliases haven't changed after it
+static qboolean DB_AliasSearchMatches(const db_aliases_searchcache_t *entry, const char *pattern, qboolean timed, int from, int to)
+{
+	if( !entry->epoch || entry->changes != aliases_changes || entry->timed != timed ) {
+		return qfalse;
+	}
+	if( timed && (entry->from != from || entry->to != to) ) {
+		return qfalse;
+	}
+	return strcmp(entry->search_pattern, pattern) ? qfalse : qtrue;
+}
+
+// finds a kept search for the session or takes the least recently used one to be searched,
+// returns qtrue if the search needs to be done
+static qboolean DB_BeginAliasSearch(db_aliases_searchsession_t *session, const char *pattern, qboolean timed, int from, int to)
+{
+	char sanitized[MAX_NAME_LENGTH];
+	db_aliases_searchcache_t *entry = NULL;
+	uint32_t i;
+
+	G_DB_NameScan_Sanitize(pattern ? pattern : "", sanitized, sizeof(sanitized));
+
+	for( i = 0; i < ALIASES_DB_SEARCHENTRIES ; i++ ) {
+		if( DB_AliasSearchMatches(&search_entries[i], sanitized, timed, from, to) ) {
+			entry = &search_entries[i];
+			break;
+		}
+		if( !entry || search_entries[i].used < entry->used ) {
+			entry = &search_entries[i];
 		}
-		if( strstr(old->alias.clean_name, pattern) != NULL ) {
-			if( search_cache.used_cache == ALIASES_DB_MAXSEARCHCACHE ) {
-				return -1;
+	}
+
+	search_cache = entry;
+	session->entry = entry;
+	entry->used = ++search_clock;
+	if( i < ALIASES_DB_SEARCHENTRIES ) {
+		session->epoch = entry->epoch;
+		return qfalse;
+	}
+
+	entry->used_cache = 0;
+	entry->iterator = 0;
+	entry->overflow = qfalse;
+	entry->timed = timed;
+	entry->from = from;
+	entry->to = to;
+	entry->changes = aliases_changes;
+	// the epoch is shared by all the entries, since the found players are marked with it
+	entry->epoch = ++search_epoch;
+	session->epoch = entry->epoch;
+	Q_strncpyz(entry->search_pattern, sanitized, sizeof(entry->search_pattern));
+	entry->fuzzed = G_DB_Fuzzy_Compile(&entry->fuzzy, entry->search_pattern);
+
+	return qtrue;
+}
+
+int G_DB_SearchAliasesNamePatternSession(int clientNum, const char *pattern)
+{
+	db_aliases_info_t *info = &aliases_info;
+	uint32_t i;
+
+	if( !info->aliases_inuse ) {
+		return -1;
+	}
+
+	if( !DB_BeginAliasSearch(DB_GetAliasSession(clientNum), pattern, qfalse, 0, 0) ) {
+		return DB_AliasSearchResult(search_cache);
+	}
+
+	if( DB_SearchAliasNames(search_cache->search_pattern, search_cache->fuzzed ? &search_cache->fuzzy : NULL, DB_SearchAliasVisit, NULL) == -1 ) {
+		// too short pattern or no index, all the aliases are checked
+		for( i = 0; i < info->entry_count ; i++ ) {
+			if( !DB_SearchAliasVisit(i, NULL) ) {
+				break;
 			}
-			search_cache.results[search_cache.used_cache] = player;
-			search_cache.used_cache++;
-			return 1;
 		}
 	}
 
-	return 0;
+	return DB_AliasSearchResult(search_cache);
 }
 
 int G_DB_SearchAliasesNamePattern(const char *pattern)
+{
+	return G_DB_SearchAliasesNamePatternSession(-1, pattern);
+}
+
+int G_DB_SearchAliasesActivitySession(int clientNum, int from, int to, const char *pattern)
 {
 	db_aliases_info_t *info = &aliases_info;
-	db_buffered_player_t *buffered = info->buffer;
-	db_playeraliases_t *cachedPlayer = NULL;
-	db_playeraliases_t *player = NULL;
-	uint32_t i, lastIndex;
 
 	if( !info->aliases_inuse ) {
 		return -1;
 	}
 
-	memset(&search_cache, 0, sizeof(search_cache));
+	if( !DB_BeginAliasSearch(DB_GetAliasSession(clientNum), pattern, qtrue, from, to) ) {
+		return DB_AliasSearchResult(search_cache);
+	}
 
-	Q_strncpyz(search_cache.search_pattern, G_DB_SanitizeName(pattern), sizeof(search_cache.search_pattern));
+	// the name narrows the search down better than the time when it can be used with the index
+	if( DB_SearchAliasNames(search_cache->search_pattern, search_cache->fuzzed ? &search_cache->fuzzy : NULL, DB_SearchAliasVisit, NULL) == -1 ) {
+		G_DB_Interval_Search(&info->activity_index, from, to, DB_SearchAliasVisit, NULL);
+	}
 
-	// through the buffer
-	while( buffered ) {
-		player = &buffered->player;
-		buffered = buffered->next;
-		if( player->actions & ALIASES_ACTION_REMOVE ) {
-			continue;
-		}
-		if( DB_SearchNamePatterns(player, search_cache.search_pattern) == -1 ) {
-			return -2;
-		}
+	return DB_AliasSearchResult(search_cache);
+}
+
+int G_DB_SearchAliasesActivity(int from, int to, const char *pattern)
+{
+	return G_DB_SearchAliasesActivitySession(-1, from, to, pattern);
+}
+
+static void DB_SetPlayerSearch(db_aliases_playersearch_t *search, const char *pattern, qboolean timed, int from, int to)
+{
+	G_DB_NameScan_Sanitize(pattern ? pattern : "", search->pattern, sizeof(search->pattern));
+	search->fuzzy = G_DB_Fuzzy_Compile(&search->compiled, search->pattern) ? &search->compiled : NULL;
+	search->timed = timed;
+	search->from = from;
+	search->to = to;
+}
+
+int G_DB_EstimateAliasPlayers(const char *pattern, qboolean timed, int from, int to)
+{
+	db_aliases_info_t *info = &aliases_info;
+	db_aliases_playersearch_t search;
+	int estimate;
+
+	if( !info->aliases_inuse ) {
+		return -1;
 	}
 
-	// through cache
-	lastIndex = info->player_count;
-	for( i = 0; i < lastIndex ; i++ ) {
-		cachedPlayer = &info->players[i];
-		if( cachedPlayer->actions & (ALIASES_ACTION_REMOVE | ALIASES_ACTION_SKIP) ) {
-			continue;
-		}
-		if( DB_SearchNamePatterns(cachedPlayer, search_cache.search_pattern) == -1 ) {
-			return -2;
+	DB_SetPlayerSearch(&search, pattern, timed, from, to);
+	if( search.fuzzy ) {
+		estimate = G_DB_Trigram_EstimateApprox(&info->name_index, search.fuzzy->pattern, search.fuzzy->maxErrors);
+	} else {
+		estimate = G_DB_Trigram_Estimate(&info->name_index, search.pattern);
+	}
+
+	// every player has at least one alias, so the entries are an upper bound of the players too
+	return (estimate >= 0) ? estimate : (int)info->entry_count;
+}
+
+static qboolean DB_PlayerAliasVisit(uint32_t id, void *context)
+{
+	db_aliases_playersearch_t *search = (db_aliases_playersearch_t*)context;
+	db_playeraliases_t *player;
+
+	player = DB_MatchAliasEntry(id, search->pattern, search->fuzzy, search->timed, search->from, search->to);
+	if( !player || player->searchEpoch == search->epoch ) {
+		return qtrue;
+	}
+	// every player once, the epoch is not shared with the kept searches
+	player->searchEpoch = search->epoch;
+
+	return search->visit((const char*)player->guid, player->guidHash, search->context);
+}
+
+int G_DB_VisitAliasPlayers(const char *pattern, qboolean timed, int from, int to, db_alias_playervisit_f visit, void *context)
+{
+	db_aliases_info_t *info = &aliases_info;
+	db_aliases_playersearch_t search;
+	uint32_t i;
+
+	if( !info->aliases_inuse ) {
+		return -1;
+	}
+
+	DB_SetPlayerSearch(&search, pattern, timed, from, to);
+	search.epoch = ++search_epoch;
+	search.visit = visit;
+	search.context = context;
+
+	if( DB_SearchAliasNames(search.pattern, search.fuzzy, DB_PlayerAliasVisit, &search) == -1 ) {
+		if( timed ) {
+			G_DB_Interval_Search(&info->activity_index, from, to, DB_PlayerAliasVisit, &search);
+		} else {
+			for( i = 0; i < info->entry_count ; i++ ) {
+				if( !DB_PlayerAliasVisit(i, &search) ) {
+					break;
+				}
+			}
 		}
 	}
 
-	return search_cache.used_cache;
+	return 0;
+}
+
+static qboolean DB_CursorAliasVisit(uint32_t id, void *context)
+{
+	db_aliases_cursorfetch_t *fetch = (db_aliases_cursorfetch_t*)context;
+	const db_alias_cursor_t *cursor = fetch->cursor;
+
+	if( id < fetch->page.from || !DB_MatchAliasEntry(id, cursor->pattern, fetch->fuzzy, cursor->timed, cursor->from, cursor->to) ) {
+		return qtrue;
+	}
+
+	return G_DB_CursorPage_Offer(&fetch->page, id);
+}
+
+int G_DB_OpenAliasCursor(db_alias_cursor_t *cursor, const char *pattern)
+{
+	db_aliases_info_t *info = &aliases_info;
+	db_fuzzy_t fuzzy;
+	int estimate;
+
+	memset(cursor, 0, sizeof(db_alias_cursor_t));
+	cursor_count = 0;
+
+	if( !info->aliases_inuse ) {
+		cursor->finished = qtrue;
+		cursor->exact = qtrue;
+		return -1;
+	}
+
+	G_DB_NameScan_Sanitize(pattern ? pattern : "", cursor->pattern, sizeof(cursor->pattern));
+
+	// the candidates of the index are an upper bound until the cursor reaches the end
+	if( G_DB_Fuzzy_Compile(&fuzzy, cursor->pattern) ) {
+		estimate = G_DB_Trigram_EstimateApprox(&info->name_index, fuzzy.pattern, fuzzy.maxErrors);
+	} else {
+		estimate = G_DB_Trigram_Estimate(&info->name_index, cursor->pattern);
+	}
+	cursor->total = (estimate >= 0) ? (uint32_t)estimate : info->entry_count;
+
+	return 0;
 }
 
-static void DB_GetAliasResults(const db_playeraliases_t *player, db_alias_searchresult_t* results)
+int G_DB_OpenAliasActivityCursor(db_alias_cursor_t *cursor, int from, int to, const char *pattern)
 {
-	db_aliases_insertrecord_t *inserts = player->insertlist;
-	db_aliases_aliasesrecord_t *old = NULL;
+	if( G_DB_OpenAliasCursor(cursor, pattern) == -1 ) {
+		return -1;
+	}
+
+	cursor->timed = qtrue;
+	cursor->from = from;
+	cursor->to = to;
+
+	return 0;
+}
+
+int G_DB_FetchAliasCursor(db_alias_cursor_t *cursor, uint32_t count)
+{
+	db_aliases_info_t *info = &aliases_info;
+	db_aliases_cursorfetch_t fetch;
 	uint32_t i;
 
-	memset(results, 0, sizeof(db_alias_searchresult_t));
+	cursor_count = 0;
 
-	memcpy(&results->guid, &player->guid, sizeof(player->guid));
+	// an empty page would never finish the cursor
+	if( !info->aliases_inuse || count == 0 ) {
+		return -1;
+	}
+	if( cursor->finished ) {
+		return 0;
+	}
 
-	while( inserts ) {
-		if( strstr(inserts->alias.clean_name, search_cache.search_pattern) ) {
-			if( results->numberOfAliases == ALIASES_DB_MAXALIASES_FORONERESULT ) {
-				results->dontFit = qtrue;
-				return;
+	fetch.cursor = cursor;
+	fetch.fuzzy = G_DB_Fuzzy_Compile(&fetch.compiled, cursor->pattern) ? &fetch.compiled : NULL;
+	G_DB_CursorPage_Begin(&fetch.page, cursor->position, count, qtrue);
+
+	// the name narrows the search down better than the time when it can be used with the index
+	if( DB_SearchAliasNames(cursor->pattern, fetch.fuzzy, DB_CursorAliasVisit, &fetch) == -1 ) {
+		if( cursor->timed ) {
+			G_DB_CursorPage_Begin(&fetch.page, cursor->position, count, qfalse);
+			G_DB_Interval_Search(&info->activity_index, cursor->from, cursor->to, DB_CursorAliasVisit, &fetch);
+		} else {
+			for( i = cursor->position; i < info->entry_count ; i++ ) {
+				if( !DB_CursorAliasVisit(i, &fetch) ) {
+					break;
+				}
 			}
-			results->aliases[results->numberOfAliases] = &inserts->alias;
-			results->numberOfAliases++;
 		}
-		results->totalPlayTime += inserts->alias.time_played;
+	}
+
+	cursor_count = G_DB_CursorPage_End(&fetch.page);
+	memcpy(cursor_entries, fetch.page.ids, sizeof(uint32_t) * cursor_count);
+	if( cursor_count ) {
+		cursor->position = cursor_entries[cursor_count - 1] + 1;
+	}
+	cursor->returned += cursor_count;
+
+	if( !fetch.page.more ) {
+		cursor->finished = qtrue;
+		cursor->exact = qtrue;
+		cursor->total = cursor->returned;
+	} else if( cursor->total <= cursor->returned ) {
+		cursor->total = cursor->returned + 1;
+	}
+
+	return (int)cursor_count;
+}
+
+const db_alias_cursorresult_t* G_DB_GetAliasCursorResult(int position)
+{
+	static db_alias_cursorresult_t result;
+	const db_aliases_entry_t *entry;
+	const db_playeraliases_t *player;
+
+	if( position < 0 || (uint32_t)position >= cursor_count || cursor_entries[position] >= aliases_info.entry_count ) {
+		return NULL;
+	}
+
+	entry = &aliases_info.entries[cursor_entries[position]];
+	player = DB_GetEntryPlayer(entry);
+	if( !player ) {
+		return NULL;
+	}
+
+	memcpy(result.guid, player->guid, sizeof(player->guid));
+	result.guid[sizeof(result.guid) - 1] = 0;
+	result.alias = entry->alias;
+
+	return &result;
+}
+
+// the time played with all the aliases of the player
+static uint32_t DB_PlayerPlayTime(const db_playeraliases_t *player)
+{
+	const db_aliases_insertrecord_t *inserts = player->insertlist;
+	uint32_t playTime = 0;
+	uint32_t i;
+
+	while( inserts ) {
+		playTime += inserts->alias.time_played;
 		inserts = inserts->next;
 	}
 
 	for( i = 0; i < player->numberOfRecords ; i++ ) {
-		old = &player->records[i];
-		if( old->actions & ALIASES_ACTION_SKIP ) {
+		if( player->records[i].actions & ALIASES_ACTION_SKIP ) {
 			continue;
 		}
-		if( strstr(old->alias.clean_name, search_cache.search_pattern) != NULL ) {
-			if( results->numberOfAliases == ALIASES_DB_MAXALIASES_FORONERESULT ) {
-				results->dontFit = qtrue;
-				return;
-			}
-			results->aliases[results->numberOfAliases] = &old->alias;
-			results->numberOfAliases++;
-		}
-		results->totalPlayTime += old->alias.time_played;
+		playTime += player->records[i].alias.time_played;
+	}
+
+	return playTime;
+}
+
+static void DB_GetAliasResults(const db_aliases_searchedplayer_aliases_t *found, db_alias_searchresult_t* results)
+{
+	const db_playeraliases_t *player = found->player;
+
+	memset(results, 0, sizeof(db_alias_searchresult_t));
+
+	memcpy(&results->guid, &player->guid, sizeof(player->guid));
+
+	// the matching aliases were collected by the search
+	memcpy(results->aliases, found->aliases, sizeof(db_alias_t*) * found->numberOfAliases);
+	results->numberOfAliases = found->numberOfAliases;
+	results->dontFit = found->dontFit;
+	results->totalPlayTime = DB_PlayerPlayTime(player);
+}
+
+int G_DB_GetAliasesPlayTime(const char *guid, uint32_t guidHash)
+{
+	const db_playeraliases_t *player;
+
+	if( !aliases_info.aliases_inuse ) {
+		return -1;
 	}
+
+	player = DB_GetPlayer(guidHash, guid);
+	if( !player || (player->actions & ALIASES_ACTION_REMOVE) ) {
+		return 0;
+	}
+
+	return (int)DB_PlayerPlayTime(player);
 }
 
-db_alias_searchresult_t *G_DB_GetAliasesSearchResult(int position)
+db_alias_searchresult_t *G_DB_GetAliasesSearchResultSession(int clientNum, int position)
 {
 	static db_alias_searchresult_t result;
+	const db_aliases_searchsession_t *session = DB_GetAliasSession(clientNum);
+	const db_aliases_searchcache_t *entry = session->entry;
 
-	if( position < 0 || (uint32_t)position >= search_cache.used_cache ) {
+	// the entry may have been taken by another search or the aliases may have changed
+	if( !entry || entry->epoch != session->epoch || entry->changes != aliases_changes ) {
+		return NULL;
+	}
+	if( position < 0 || (uint32_t)position >= entry->used_cache ) {
 		return NULL;
 	}
 
-	DB_GetAliasResults(search_cache.results[position], &result);
+	DB_GetAliasResults(&entry->results[position], &result);
 
 	return &result;
 }
+
+db_alias_searchresult_t *G_DB_GetAliasesSearchResult(int position)
+{
+	return G_DB_GetAliasesSearchResultSession(-1, position);
+}
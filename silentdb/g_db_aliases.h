@@ -4,11 +4,14 @@
  *  Changelog ( date, changes, author ):
  *  2012-09-03, Initial version, gaoesa
  *  2012-09-06, Base work done with memory management (online !aliases works), gaoesa
+ *  2026-10-17, Approximate name searches with the pattern~ and pattern~N syntax, agent
 */
 
 #ifndef __G_DB_ALIASES_H__
 #define __G_DB_ALIASES_H__
 
+#include "g_db_guid.h"
+
 // structure is used in the file as well as in the program
 typedef struct db_alias_s {
 	char name[36];
@@ -52,6 +55,7 @@ void G_DB_CleanUpAliases(void);
  *  @param guidHash Optional guid hash. If set to 0, the guid hash is calculated from the guid.
  */
 void G_DB_RemoveAliases(const char *guid, uint32_t guidHash);
+void G_DB_RemoveAliasesGUID(const db_guid_t *guid);
 
 /**
  *  Function removes aliases from that player from the database.
@@ -72,6 +76,24 @@ qboolean G_DB_RemoveAliasesShortGUID(const char *shortGuid);
  */
 void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHash);
 
+/**
+ *  Function works like G_DB_UpdateAlias, but remembers the player of the client slot, so the repeated updates of the same
+ *  client, like the renames, don't need to look up the player again.
+ *
+ *  @param clientNum The client slot of the player.
+ *  @param guid The 32 character silEnT GUID of the player.
+ *  @param alias The fully set alias data.
+ *  @param guidHash The silEnT GUID hash or 0 to calculate it in the function.
+ */
+void G_DB_UpdateClientAlias(int clientNum, const char *guid, const db_alias_t *alias, uint32_t guidHash);
+
+/**
+ *  Function forgets the player and the search results remembered for the client slot. Called when the client disconnects.
+ *
+ *  @param clientNum The client slot.
+ */
+void G_DB_ClearClientAlias(int clientNum);
+
 /**
  *  Function returns the number of aliases and sets the internal iterator to the first alias if available.
  *
@@ -80,6 +102,7 @@ void G_DB_UpdateAlias(const char *guid, const db_alias_t *alias, uint32_t guidHa
  *  @return the number of aliases to read with G_DB_GetNextAlias function calls or, -1 if aliases not in use, -2 if bad guid or -3 if not found
 */
 int G_DB_GetAliases(const char *guid, const int start);
+int G_DB_GetAliasesGUID(const db_guid_t *guid, const int start);
 
 /**
  *  Function searches the alias database for the player using the short guid. After this function the players can
@@ -94,11 +117,24 @@ int G_DB_SearchAliasesShortGUID(const char *guid, const int start);
 /**
  *  Function is used to search all users that have used the name.
  *
- *  @param pattern The searched pattern. Must not have color codes in it.
+ *  @param pattern The searched pattern. Must not have color codes in it. The pattern ending with ~ and optionally
+ *                 the amount of the allowed edits, like "nade~1", is searched approximately, see g_db_fuzzy.h.
  *  @return number of found records or -1 if aliases not in use or -2 if all the found ones can't fit into the results.
  */
 int G_DB_SearchAliasesNamePattern(const char *pattern);
 
+/**
+ *  Function is used to search all users that have used a name during the time window. The alias was in use during
+ *  the window if its first_seen - last_seen span overlaps the window. The results are read like the results of
+ *  G_DB_SearchAliasesNamePattern.
+ *
+ *  @param from The start of the window, in the same time as the alias times.
+ *  @param to The end of the window, inclusive.
+ *  @param pattern The optional searched pattern, NULL or empty to find all names. Must not have color codes in it.
+ *  @return number of found records or -1 if aliases not in use or -2 if all the found ones can't fit into the results.
+ */
+int G_DB_SearchAliasesActivity(int from, int to, const char *pattern);
+
 /**
  *	Function returns the found data of the player.
  *
@@ -107,6 +143,141 @@ int G_DB_SearchAliasesNamePattern(const char *pattern);
  */
 db_alias_searchresult_t *G_DB_GetAliasesSearchResult(int position);
 
+/**
+ *  Function returns the total time the player has played with all the aliases.
+ *
+ *  @param guid The 32 character silEnT GUID of the player, in the form stored in the main database.
+ *  @param guidHash The guid hash of the player.
+ *  @return The time played, 0 if the player has no aliases, or -1 if aliases not in use.
+ */
+int G_DB_GetAliasesPlayTime(const char *guid, uint32_t guidHash);
+
+// called once for every player with a matching alias, return qfalse to stop the visits
+typedef qboolean (*db_alias_playervisit_f)(const char *guid, uint32_t guidHash, void *context);
+
+/**
+ *  Function estimates the amount of the players G_DB_VisitAliasPlayers would visit, without visiting them.
+ *
+ *  @param pattern The searched pattern like with G_DB_SearchAliasesNamePattern, NULL or empty to find all names.
+ *  @param timed qtrue if only the aliases in use during the window from - to are searched.
+ *  @param from The start of the window.
+ *  @param to The end of the window, inclusive.
+ *  @return An upper bound of the players or -1 if aliases not in use.
+ */
+int G_DB_EstimateAliasPlayers(const char *pattern, qboolean timed, int from, int to);
+
+/**
+ *  Function visits the players having an alias matching the search, without the result limit of the other
+ *  searches. The aliases must not be changed by the visit.
+ *
+ *  @param pattern The searched pattern like with G_DB_SearchAliasesNamePattern, NULL or empty to find all names.
+ *  @param timed qtrue if only the aliases in use during the window from - to are searched.
+ *  @param from The start of the window.
+ *  @param to The end of the window, inclusive.
+ *  @param visit Function called with the 32 character GUID, without NUL, and the GUID hash of the player.
+ *  @param context Passed to the visit function.
+ *  @return 0 or -1 if aliases not in use.
+ */
+int G_DB_VisitAliasPlayers(const char *pattern, qboolean timed, int from, int to, db_alias_playervisit_f visit, void *context);
+
+// Search sessions
+//
+// Every client has its own search results, so searches of different admins don't replace each
+// other's results. The recent searches are kept and a repeated search with the same parameters
+// reuses the results while the aliases haven't changed. The functions without the session use the
+// session of the console.
+
+/**
+ *  Function searches the name pattern like G_DB_SearchAliasesNamePattern into the results of the client.
+ *
+ *  @param clientNum The searching client, -1 for the console.
+ *  @param pattern The searched pattern. Must not have color codes in it.
+ *  @return number of found records or -1 if aliases not in use or -2 if all the found ones can't fit into the results.
+ */
+int G_DB_SearchAliasesNamePatternSession(int clientNum, const char *pattern);
+
+/**
+ *  Function searches the activity like G_DB_SearchAliasesActivity into the results of the client.
+ *
+ *  @param clientNum The searching client, -1 for the console.
+ *  @param from The start of the window, in the same time as the alias times.
+ *  @param to The end of the window, inclusive.
+ *  @param pattern The optional searched pattern, NULL or empty to find all names.
+ *  @return number of found records or -1 if aliases not in use or -2 if all the found ones can't fit into the results.
+ */
+int G_DB_SearchAliasesActivitySession(int clientNum, int from, int to, const char *pattern);
+
+/**
+ *	Function returns the found data of the player from the results of the client.
+ *
+ *  @param clientNum The searching client, -1 for the console.
+ *  @param position The index in the search results of the client.
+ *  @return The found data of the player or NULL, also if the aliases changed after the search.
+ */
+db_alias_searchresult_t *G_DB_GetAliasesSearchResultSession(int clientNum, int position);
+
+// Streaming search cursors
+//
+// The cursor hands out the matching aliases a page at a time, one result per alias, without the
+// result limits of the searches above. Only the last fetched page is kept, the cursor itself is
+// owned by the caller and continues from where the last page ended.
+
+typedef struct db_alias_cursor_s {
+	char		pattern[36];	// sanitized like the clean names
+	qboolean	timed;			// only the aliases active between from and to are found
+	int			from;
+	int			to;
+	uint32_t	position;		// the alias entry the next page starts from
+	uint32_t	returned;		// the amount of the fetched aliases
+	uint32_t	total;			// the amount of the matches, an upper bound until exact is set
+	qboolean	exact;
+	qboolean	finished;		// all the matches have been fetched
+} db_alias_cursor_t;
+
+typedef struct db_alias_cursorresult_s {
+	char				guid[33];	// the silEnT GUID of the player
+	const db_alias_t	*alias;
+} db_alias_cursorresult_t;
+
+/**
+ *  Function opens a cursor for the aliases matching the pattern. Nothing is searched before the first fetch.
+ *
+ *  @param cursor The cursor to open.
+ *  @param pattern The searched pattern, NULL or empty to find all names. Must not have color codes in it.
+ *  @return 0 on success or -1 if aliases not in use.
+ */
+int G_DB_OpenAliasCursor(db_alias_cursor_t *cursor, const char *pattern);
+
+/**
+ *  Function opens a cursor for the aliases matching the pattern that were in use during the time window, see
+ *  G_DB_SearchAliasesActivity.
+ *
+ *  @param cursor The cursor to open.
+ *  @param from The start of the window, in the same time as the alias times.
+ *  @param to The end of the window, inclusive.
+ *  @param pattern The optional searched pattern, NULL or empty to find all names.
+ *  @return 0 on success or -1 if aliases not in use.
+ */
+int G_DB_OpenAliasActivityCursor(db_alias_cursor_t *cursor, int from, int to, const char *pattern);
+
+/**
+ *  Function fetches the next page of the matching aliases, the page is read with G_DB_GetAliasCursorResult.
+ *
+ *  @param cursor The opened cursor.
+ *  @param count The size of the page, from 1 to SIL_DB_MAXCURSORPAGE.
+ *  @return The amount of the fetched aliases, 0 once the cursor is finished, or -1 if aliases not in use
+ *  or the count is 0.
+ */
+int G_DB_FetchAliasCursor(db_alias_cursor_t *cursor, uint32_t count);
+
+/**
+ *	Function returns an alias of the last fetched cursor page.
+ *
+ *  @param position The index in the page. Between 0 - G_DB_FetchAliasCursor
+ *  @return The alias and its player or NULL. The data is overwritten by the next call.
+ */
+const db_alias_cursorresult_t* G_DB_GetAliasCursorResult(int position);
+
 /**
  *  Function return an alias pointed by internal iterator. Before this function is called, the iterator must be set with G_DB_GetAliases.
  *  After the function call the iterator is advanced to the next alias until all the aliases are iterated. If all the aliases are
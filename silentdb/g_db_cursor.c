@@ -0,0 +1,87 @@
+/*
+ *  Module contains the page collection of the streaming search cursors of the database modules.
+ *
+ *  The unordered collection keeps the largest collected id at the top of the heap, a smaller id
+ *  replaces it once the page is full. The page is sorted by taking the heap apart from the top.
+ */
+
+#include "g_local.h"
+#include "g_db_cursor.h"
+
+static void DB_CursorPage_SiftDown(uint32_t *ids, uint32_t count, uint32_t i)
+{
+	uint32_t id = ids[i];
+	uint32_t child;
+
+	while( (child = i * 2 + 1) < count ) {
+		if( child + 1 < count && ids[child + 1] > ids[child] ) {
+			child++;
+		}
+		if( ids[child] <= id ) {
+			break;
+		}
+		ids[i] = ids[child];
+		i = child;
+	}
+	ids[i] = id;
+}
+
+void G_DB_CursorPage_Begin(db_cursorpage_t *page, uint32_t from, uint32_t size, qboolean ordered)
+{
+	page->count = 0;
+	page->size = size < SIL_DB_MAXCURSORPAGE ? size : SIL_DB_MAXCURSORPAGE;
+	page->from = from;
+	page->ordered = ordered;
+	page->more = qfalse;
+}
+
+qboolean G_DB_CursorPage_Offer(db_cursorpage_t *page, uint32_t id)
+{
+	uint32_t i;
+
+	if( id < page->from ) {
+		return qtrue;
+	}
+
+	if( page->count == page->size ) {
+		page->more = qtrue;
+		if( page->ordered || !page->size ) {
+			return qfalse;
+		}
+		if( id < page->ids[0] ) {
+			page->ids[0] = id;
+			DB_CursorPage_SiftDown(page->ids, page->count, 0);
+		}
+		return qtrue;
+	}
+
+	if( page->ordered ) {
+		page->ids[page->count++] = id;
+		return qtrue;
+	}
+
+	// sift up
+	for( i = page->count++; i > 0 && page->ids[(i - 1) / 2] < id ; i = (i - 1) / 2 ) {
+		page->ids[i] = page->ids[(i - 1) / 2];
+	}
+	page->ids[i] = id;
+
+	return qtrue;
+}
+
+uint32_t G_DB_CursorPage_End(db_cursorpage_t *page)
+{
+	uint32_t i;
+	uint32_t id;
+
+	if( !page->ordered ) {
+		for( i = page->count; i > 1 ; i-- ) {
+			id = page->ids[0];
+			page->ids[0] = page->ids[i - 1];
+			page->ids[i - 1] = id;
+			DB_CursorPage_SiftDown(page->ids, i - 1, 0);
+		}
+	}
+
+	return page->count;
+}
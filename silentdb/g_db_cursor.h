@@ -0,0 +1,59 @@
+/*
+ *  Module contains the page collection of the streaming search cursors of the database modules.
+ *
+ *  A cursor hands out the matches of a search in the ascending order of their ids, one page at a
+ *  time, and continues from the id after the last one of the page. The page collects the matches
+ *  from the id onwards. With the sources visiting the ids in ascending order the collection stops
+ *  as soon as the page is full and one more match is seen. With the other sources the page keeps
+ *  the smallest ids in a bounded heap, so the memory follows the size of the page and not the
+ *  amount of the matches either way.
+ *
+ *  The ids are the user cache positions for the user searches and the alias entry indexes for
+ *  the alias searches.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_CURSOR_H__
+#define __G_DB_CURSOR_H__
+
+#define SIL_DB_MAXCURSORPAGE	64
+
+typedef struct db_cursorpage_s {
+	uint32_t	ids[SIL_DB_MAXCURSORPAGE];	// a max-heap while collecting unordered, sorted after
+	uint32_t	count;
+	uint32_t	size;		// the size of the page, at most SIL_DB_MAXCURSORPAGE
+	uint32_t	from;		// the smallest id taken to the page
+	qboolean	ordered;	// the ids are offered in ascending order
+	qboolean	more;		// there are matches after the page
+} db_cursorpage_t;
+
+/**
+ * Function starts the collection of a page.
+ *
+ * @param page The page to start.
+ * @param from The smallest id taken to the page, the smaller ids are skipped by the offer.
+ * @param size The size of the page, limited to SIL_DB_MAXCURSORPAGE.
+ * @param ordered qtrue if the ids are offered in ascending order.
+ */
+void G_DB_CursorPage_Begin(db_cursorpage_t *page, uint32_t from, uint32_t size, qboolean ordered);
+
+/**
+ * Function offers a matching id to the page.
+ *
+ * @param page The page collecting the matches.
+ * @param id The matching id.
+ * @return qfalse if the collection can stop, the page is final.
+ */
+qboolean G_DB_CursorPage_Offer(db_cursorpage_t *page, uint32_t id);
+
+/**
+ * Function ends the collection, the ids of the page are sorted ascending.
+ *
+ * @param page The collected page.
+ * @return The amount of the ids in the page.
+ */
+uint32_t G_DB_CursorPage_End(db_cursorpage_t *page);
+
+#endif
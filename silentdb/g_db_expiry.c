@@ -0,0 +1,119 @@
+/*
+ *  Module contains an expiry queue for the pruning of the database modules.
+ *
+ *  The build collects the entries to the array and orders them bottom up, which is linear in the
+ *  amount of the entries. The array only grows, the pruning passes don't give the memory back.
+ */
+
+#include "g_local.h"
+#include "g_db_expiry.h"
+
+#define DB_EXPIRY_MINSIZE	64
+
+static void DB_Expiry_SiftUp(db_expiry_t *queue, uint32_t pos)
+{
+	db_expiry_item_t item = queue->items[pos];
+	uint32_t parent;
+
+	while( pos > 0 ) {
+		parent = (pos - 1) / 2;
+		if( queue->items[parent].expires <= item.expires ) {
+			break;
+		}
+		queue->items[pos] = queue->items[parent];
+		pos = parent;
+	}
+	queue->items[pos] = item;
+}
+
+static void DB_Expiry_SiftDown(db_expiry_t *queue, uint32_t pos)
+{
+	db_expiry_item_t item = queue->items[pos];
+	uint32_t child;
+
+	while( (child = pos * 2 + 1) < queue->count ) {
+		if( child + 1 < queue->count && queue->items[child + 1].expires < queue->items[child].expires ) {
+			child++;
+		}
+		if( item.expires <= queue->items[child].expires ) {
+			break;
+		}
+		queue->items[pos] = queue->items[child];
+		pos = child;
+	}
+	queue->items[pos] = item;
+}
+
+int G_DB_Expiry_Build(db_expiry_t *queue, uint32_t count, db_expiry_time_f expiry, void *context)
+{
+	uint32_t expires;
+	uint32_t i;
+
+	G_DB_Expiry_Free(queue);
+
+	queue->size = count > DB_EXPIRY_MINSIZE ? count : DB_EXPIRY_MINSIZE;
+	queue->items = (db_expiry_item_t*)malloc(sizeof(db_expiry_item_t) * queue->size);
+	if( !queue->items ) {
+		queue->size = 0;
+		return -1;
+	}
+
+	for( i = 0; i < count ; i++ ) {
+		if( expiry(i, &expires, context) ) {
+			queue->items[queue->count].expires = expires;
+			queue->items[queue->count].id = i;
+			queue->count++;
+		}
+	}
+
+	for( i = queue->count / 2; i > 0 ; i-- ) {
+		DB_Expiry_SiftDown(queue, i - 1);
+	}
+
+	return 0;
+}
+
+void G_DB_Expiry_Free(db_expiry_t *queue)
+{
+	free(queue->items);
+	memset(queue, 0, sizeof(db_expiry_t));
+}
+
+int G_DB_Expiry_Push(db_expiry_t *queue, uint32_t id, uint32_t expires)
+{
+	db_expiry_item_t *memory;
+	uint32_t size;
+
+	if( queue->count == queue->size ) {
+		size = queue->size ? queue->size * 2 : DB_EXPIRY_MINSIZE;
+		memory = (db_expiry_item_t*)realloc(queue->items, sizeof(db_expiry_item_t) * size);
+		if( !memory ) {
+			return -1;
+		}
+		queue->items = memory;
+		queue->size = size;
+	}
+
+	queue->items[queue->count].expires = expires;
+	queue->items[queue->count].id = id;
+	DB_Expiry_SiftUp(queue, queue->count++);
+
+	return 0;
+}
+
+qboolean G_DB_Expiry_Pop(db_expiry_t *queue, uint32_t now, uint32_t *id, uint32_t *expires)
+{
+	if( !queue->count || queue->items[0].expires >= now ) {
+		return qfalse;
+	}
+
+	*id = queue->items[0].id;
+	*expires = queue->items[0].expires;
+
+	queue->items[0] = queue->items[--queue->count];
+	if( queue->count ) {
+		DB_Expiry_SiftDown(queue, 0);
+	}
+
+	return qtrue;
+}
@@ -0,0 +1,75 @@
+/*
+ *  Module contains an expiry queue for the pruning of the database modules.
+ *
+ *  The queue is a binary min-heap of the expiry times of the ids, so the earliest expiry is always
+ *  at the top. A pruning pass pops only the ids that have expired and stops at the first one that
+ *  has not, so the cost follows the amount of the expirations and not the amount of the ids.
+ *
+ *  The queue does not support moving an id. When the expiry of an id changes, the caller pushes the
+ *  new time and remembers it, the old entries are recognized as stale when they are popped.
+ *
+ *  The ids are the user cache positions, the expiry time comes from the retention policy of the
+ *  level of the user.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_EXPIRY_H__
+#define __G_DB_EXPIRY_H__
+
+typedef struct db_expiry_item_s {
+	uint32_t	expires;
+	uint32_t	id;
+} db_expiry_item_t;
+
+typedef struct db_expiry_s {
+	db_expiry_item_t	*items;		// the heap, the earliest expiry first
+	uint32_t			count;
+	uint32_t			size;
+} db_expiry_t;
+
+// returns qtrue and the expiry time of the id, qfalse if the id never expires
+typedef qboolean (*db_expiry_time_f)(uint32_t id, uint32_t *expires, void *context);
+
+/**
+ * Function builds the queue for the ids from 0 to count - 1 at once, this is faster than pushing
+ * the ids one by one.
+ *
+ * @param queue The queue to build. Old content is freed.
+ * @param count The amount of the ids.
+ * @param expiry Function returning the expiry time of an id.
+ * @param context Passed to the expiry function.
+ * @return 0 on success, -1 if out of memory. The queue is left empty on failure.
+ */
+int G_DB_Expiry_Build(db_expiry_t *queue, uint32_t count, db_expiry_time_f expiry, void *context);
+
+/**
+ * Function releases the memory of the queue and leaves it empty.
+ *
+ * @param queue The queue to free.
+ */
+void G_DB_Expiry_Free(db_expiry_t *queue);
+
+/**
+ * Function adds an expiry time of the id to the queue.
+ *
+ * @param queue The queue to add to.
+ * @param id The id.
+ * @param expires The expiry time.
+ * @return 0 on success, -1 if out of memory.
+ */
+int G_DB_Expiry_Push(db_expiry_t *queue, uint32_t id, uint32_t expires);
+
+/**
+ * Function removes the earliest entry of the queue if it has expired.
+ *
+ * @param queue The queue to pop from.
+ * @param now The current time, the entries expiring before it have expired.
+ * @param id The id of the removed entry.
+ * @param expires The expiry time of the removed entry.
+ * @return qtrue if an entry was removed, qfalse if the queue is empty or nothing has expired.
+ */
+qboolean G_DB_Expiry_Pop(db_expiry_t *queue, uint32_t now, uint32_t *id, uint32_t *expires);
+
+#endif
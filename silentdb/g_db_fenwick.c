@@ -0,0 +1,88 @@
+/*
+ *  Module contains an order statistic index for the positional seeks of the database modules.
+ *
+ *  The build adds every node to its parent once, instead of adding the positions one by one. The
+ *  search walks down from the largest power of two block, so the visited nodes are the ones whose
+ *  blocks end before the searched position.
+ */
+
+#include "g_local.h"
+#include "g_db_fenwick.h"
+
+int G_DB_Fenwick_Build(db_fenwick_t *index, uint32_t size, db_fenwick_counted_f counted, void *context)
+{
+	uint32_t i;
+	uint32_t parent;
+
+	G_DB_Fenwick_Free(index);
+
+	index->tree = (uint32_t*)calloc(size + 1, sizeof(uint32_t));
+	if( !index->tree ) {
+		return -1;
+	}
+	index->size = size;
+
+	for( i = 1; i <= size ; i++ ) {
+		if( counted(i - 1, context) ) {
+			index->tree[i]++;
+			index->total++;
+		}
+		parent = i + (i & (~i + 1));
+		if( parent <= size ) {
+			index->tree[parent] += index->tree[i];
+		}
+	}
+
+	return 0;
+}
+
+void G_DB_Fenwick_Free(db_fenwick_t *index)
+{
+	free(index->tree);
+	memset(index, 0, sizeof(db_fenwick_t));
+}
+
+void G_DB_Fenwick_Set(db_fenwick_t *index, uint32_t position, qboolean counted)
+{
+	uint32_t i;
+
+	if( position >= index->size ) {
+		return;
+	}
+
+	if( counted ) {
+		index->total++;
+		for( i = position + 1; i <= index->size ; i += i & (~i + 1) ) {
+			index->tree[i]++;
+		}
+	} else {
+		index->total--;
+		for( i = position + 1; i <= index->size ; i += i & (~i + 1) ) {
+			index->tree[i]--;
+		}
+	}
+}
+
+uint32_t G_DB_Fenwick_Find(const db_fenwick_t *index, uint32_t n)
+{
+	uint32_t position = 0;
+	uint32_t step = 1;
+
+	if( !n || n > index->total ) {
+		return index->size;
+	}
+
+	while( step <= index->size / 2 ) {
+		step <<= 1;
+	}
+
+	// the largest position with less than n counted before it
+	for( ; step ; step >>= 1 ) {
+		if( position + step <= index->size && index->tree[position + step] < n ) {
+			position += step;
+			n -= index->tree[position];
+		}
+	}
+
+	return position;
+}
@@ -0,0 +1,65 @@
+/*
+ *  Module contains an order statistic index for the positional seeks of the database modules.
+ *
+ *  The index is a Fenwick tree over the counted positions of the caller's array. Every node of the
+ *  tree holds the amount of the counted positions in a power of two sized block ending at it, so a
+ *  position is counted or uncounted and the n:th counted position is found by walking one node per
+ *  bit of the size. Listing from the n:th counted record does not need to step over the records
+ *  before it.
+ *
+ *  The positions are the user cache positions, the counted ones are the users shown in the listing.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_FENWICK_H__
+#define __G_DB_FENWICK_H__
+
+typedef struct db_fenwick_s {
+	uint32_t	*tree;		// 1-based, the node i counts the positions i - (i & -i) to i - 1
+	uint32_t	size;		// the amount of the positions
+	uint32_t	total;		// the amount of the counted positions
+} db_fenwick_t;
+
+// returns qtrue if the position is counted
+typedef qboolean (*db_fenwick_counted_f)(uint32_t position, void *context);
+
+/**
+ * Function builds the index for the positions from 0 to size - 1 in linear time.
+ *
+ * @param index The index to build. Old content is freed.
+ * @param size The amount of the positions.
+ * @param counted Function telling if a position is counted.
+ * @param context Passed to the counted function.
+ * @return 0 on success, -1 if out of memory. The index is left empty on failure.
+ */
+int G_DB_Fenwick_Build(db_fenwick_t *index, uint32_t size, db_fenwick_counted_f counted, void *context);
+
+/**
+ * Function releases all the memory of the index and leaves it empty.
+ *
+ * @param index The index to free.
+ */
+void G_DB_Fenwick_Free(db_fenwick_t *index);
+
+/**
+ * Function counts or uncounts the position. The caller keeps track of the counted positions,
+ * counting a counted position twice breaks the index.
+ *
+ * @param index The index to update.
+ * @param position The position, 0 - size-1.
+ * @param counted qtrue to count the position, qfalse to uncount it.
+ */
+void G_DB_Fenwick_Set(db_fenwick_t *index, uint32_t position, qboolean counted);
+
+/**
+ * Function finds the n:th counted position.
+ *
+ * @param index The index to search.
+ * @param n The number of the counted position, starting from 1.
+ * @return The position or size if there are less than n counted positions.
+ */
+uint32_t G_DB_Fenwick_Find(const db_fenwick_t *index, uint32_t n);
+
+#endif
@@ -178,3 +178,42 @@ int G_DB_WriteBlockToFile(FILE *handle, void *block, size_t block_size, int pos)
 
 	return filePos;
 }
+
+int G_DB_ReadConfigLine(FILE *handle, char *line, uint32_t size)
+{
+	char buffer[1024];
+	char *start;
+	char *end;
+
+	if( !size ) {
+		return -1;
+	}
+
+	while( fgets(buffer, sizeof(buffer), handle) ) {
+		end = strstr(buffer, "//");
+		if( end ) {
+			*end = '\0';
+		}
+		end = strchr(buffer, '#');
+		if( end ) {
+			*end = '\0';
+		}
+
+		start = buffer;
+		while( *start && isspace((unsigned char)*start) ) {
+			start++;
+		}
+		end = start + strlen(start);
+		while( end > start && isspace((unsigned char)end[-1]) ) {
+			end--;
+		}
+		*end = '\0';
+
+		if( *start ) {
+			Q_strncpyz(line, start, size);
+			return (int)strlen(line);
+		}
+	}
+
+	return -1;
+}
@@ -12,6 +12,7 @@
 #define DB_FILEMODE_READ "rb"
 #define DB_FILEMODE_TRUNCATE "wb"
 #define DB_FILEMODE_UPDATE "r+b"
+#define DB_FILEMODE_READTEXT "r"
 /**
 	Function opens any database file. Hides directory structure, always opens from inside the g_dbdirectory.
 	Mode is passed to fopen as is and returns the handle for easy fail checks, same as using fopen directly
@@ -100,4 +101,15 @@ int G_DB_ReadBlockFromDBFile(FILE *handle, void *block, size_t block_size, int p
  */
 int G_DB_WriteBlockToFile(FILE *handle, void *block, size_t block_size, int pos);
 
+/**
+ *	Function reads the next setting line from a text file opened with DB_FILEMODE_READTEXT. The comments starting
+ *	with // or # and the white space around the setting are removed, the lines left empty are skipped.
+ *
+ * @param handle The handle to the file to read.
+ * @param line The buffer for the setting. The characters that don't fit are dropped.
+ * @param size The size of the buffer.
+ * @return The length of the setting or -1 when the file ends.
+ */
+int G_DB_ReadConfigLine(FILE *handle, char *line, uint32_t size);
+
 #endif
@@ -0,0 +1,132 @@
+/*
+ *  Module contains the approximate name matching of the database modules.
+ *
+ *  The matching computes the edit distance column by column, one column per character of the name.
+ *  The column is kept as the vertical deltas of the pattern positions in two words, so a column is
+ *  a handful of word operations. The distance of the whole pattern is followed at the last position
+ *  and the name matches as soon as it drops to the allowed amount of edits. The distances of the
+ *  first row are zero, so the match may start anywhere in the name.
+ */
+
+#include "g_local.h"
+#include "g_db_fuzzy.h"
+
+// the look-alike characters, the first character of a group is what the others fold to
+static const char *db_fuzzy_homoglyphs[] = {
+	"a4@\xe0\xe1\xe2\xe3\xe4\xe5\xc0\xc1\xc2\xc3\xc4\xc5",
+	"b8",
+	"c(\xe7\xc7",
+	"e3\xe8\xe9\xea\xeb\xc8\xc9\xca\xcb",
+	"g96",
+	"l1i!|\xec\xed\xee\xef\xcc\xcd\xce\xcf",
+	"n\xf1\xd1",
+	"o0\xf2\xf3\xf4\xf5\xf6\xf8\xd2\xd3\xd4\xd5\xd6\xd8",
+	"s5$",
+	"t7+",
+	"u\xf9\xfa\xfb\xfc\xd9\xda\xdb\xdc",
+	"y\xfd\xff\xdd",
+	"z2",
+	NULL
+};
+
+static char db_fuzzy_fold[256];
+static qboolean db_fuzzy_foldready;
+
+static void DB_Fuzzy_BuildFold(void)
+{
+	const char *group;
+	int i;
+
+	for( i = 0; i < 256 ; i++ ) {
+		db_fuzzy_fold[i] = (char)i;
+	}
+	for( i = 0; db_fuzzy_homoglyphs[i] ; i++ ) {
+		for( group = db_fuzzy_homoglyphs[i] + 1; *group ; group++ ) {
+			db_fuzzy_fold[(uint8_t)*group] = db_fuzzy_homoglyphs[i][0];
+		}
+	}
+	db_fuzzy_foldready = qtrue;
+}
+
+char G_DB_Fuzzy_Fold(char c)
+{
+	if( !db_fuzzy_foldready ) {
+		DB_Fuzzy_BuildFold();
+	}
+	return db_fuzzy_fold[(uint8_t)c];
+}
+
+qboolean G_DB_Fuzzy_Compile(db_fuzzy_t *fuzzy, const char *pattern)
+{
+	const char *tilde = strrchr(pattern, '~');
+	uint32_t length;
+	uint32_t i;
+
+	if( !tilde || tilde == pattern ) {
+		return qfalse;
+	}
+	if( tilde[1] && (tilde[1] < '0' || tilde[1] > '9' || tilde[2]) ) {
+		// the ~ is a part of the name
+		return qfalse;
+	}
+	length = (uint32_t)(tilde - pattern);
+	if( length > SIL_DB_FUZZY_MAXPATTERN ) {
+		return qfalse;
+	}
+
+	if( !db_fuzzy_foldready ) {
+		DB_Fuzzy_BuildFold();
+	}
+
+	memset(fuzzy->peq, 0, sizeof(fuzzy->peq));
+	for( i = 0; i < length ; i++ ) {
+		fuzzy->pattern[i] = db_fuzzy_fold[(uint8_t)pattern[i]];
+		fuzzy->peq[(uint8_t)fuzzy->pattern[i]] |= (uint64_t)1 << i;
+	}
+	fuzzy->pattern[length] = '\0';
+	fuzzy->length = length;
+
+	if( tilde[1] ) {
+		fuzzy->maxErrors = (uint32_t)(tilde[1] - '0');
+	} else {
+		fuzzy->maxErrors = length > 8 ? 2 : 1;
+	}
+	if( fuzzy->maxErrors >= length ) {
+		// every name would match
+		fuzzy->maxErrors = length - 1;
+	}
+
+	return qtrue;
+}
+
+qboolean G_DB_Fuzzy_Matches(const db_fuzzy_t *fuzzy, const char *name)
+{
+	const uint64_t last = (uint64_t)1 << (fuzzy->length - 1);
+	uint64_t pv = ~(uint64_t)0;
+	uint64_t mv = 0;
+	uint64_t eq, xv, xh, ph, mh;
+	uint32_t score = fuzzy->length;
+
+	for( ; *name ; name++ ) {
+		eq = fuzzy->peq[(uint8_t)db_fuzzy_fold[(uint8_t)*name]];
+		xv = eq | mv;
+		xh = (((eq & pv) + pv) ^ pv) | eq;
+		ph = mv | ~(xh | pv);
+		mh = pv & xh;
+		if( ph & last ) {
+			score++;
+		} else if( mh & last ) {
+			score--;
+		}
+		// the first row stays zero, nothing is shifted in
+		ph <<= 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+		if( score <= fuzzy->maxErrors ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
@@ -0,0 +1,59 @@
+/*
+ *  Module contains the approximate name matching of the database modules.
+ *
+ *  A fuzzy pattern matches the names having a substring within the allowed amount of edits from
+ *  the pattern, an edit is an inserted, a removed or a changed character. Before the comparison
+ *  both the pattern and the names are folded with a homoglyph table, so the look-alike characters
+ *  like 0 and o or 1, i and l are equal and cost no edits. The matching uses the bit-parallel
+ *  algorithm of Myers, the whole pattern is one 64 bit word, so a name is checked with a few
+ *  operations per character whatever the amount of the allowed edits.
+ *
+ *  A search pattern is fuzzy when it ends with ~ and optionally the amount of the allowed edits,
+ *  like nade~ or nade~2. Without the amount, one edit is allowed for the patterns up to eight
+ *  characters and two for the longer ones. ~0 finds the look-alike names only.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_FUZZY_H__
+#define __G_DB_FUZZY_H__
+
+#define SIL_DB_FUZZY_MAXPATTERN	64	// the bits of the word
+
+typedef struct db_fuzzy_s {
+	uint64_t	peq[256];		// the pattern positions of every folded character
+	uint32_t	length;
+	uint32_t	maxErrors;		// less than the length
+	char		pattern[SIL_DB_FUZZY_MAXPATTERN + 1];	// folded, without the ~ suffix
+} db_fuzzy_t;
+
+/**
+ * Function returns the character the homoglyph table folds the character to. The folded
+ * characters fold to themselves.
+ *
+ * @param c The lower case character.
+ * @return The folded character.
+ */
+char G_DB_Fuzzy_Fold(char c);
+
+/**
+ * Function compiles the fuzzy search pattern.
+ *
+ * @param fuzzy The compiled pattern.
+ * @param pattern The sanitized search pattern.
+ * @return qfalse if the pattern is not fuzzy or the part before the ~ is empty or too long. The
+ *         pattern is searched as an exact substring then.
+ */
+qboolean G_DB_Fuzzy_Compile(db_fuzzy_t *fuzzy, const char *pattern);
+
+/**
+ * Function checks if the name has a substring within the allowed edits from the pattern.
+ *
+ * @param fuzzy The compiled pattern.
+ * @param name The sanitized name.
+ * @return qtrue if the name matches
+ */
+qboolean G_DB_Fuzzy_Matches(const db_fuzzy_t *fuzzy, const char *name);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ *  Module contains the canonical GUID value used with the database modules.
+ *
+ *  The comparisons are done with two 16 byte compares when SSE2 is available, otherwise with
+ *  memcmp. The GUIDs have no alignment requirements.
+ */
+
+#include "g_local.h"
+#include "g_db_guid.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DB_GUID_SSE2
+#include <emmintrin.h>
+#endif
+
+// seed of the second half of the fingerprint, any value other than 0 will do
+#define DB_GUID_CHECKSEED	0x9e3779b9u
+
+qboolean G_DB_GUID_Set(db_guid_t *out, const char *guid)
+{
+	uint32_t words[SIL_SHRUBBOT_DB_GUIDLEN/4];
+	int i;
+
+	for( i = 0; i < SIL_SHRUBBOT_DB_GUIDLEN && guid[i] ; i++ ) {
+		out->guid[i] = toupper(guid[i]);
+	}
+	if( i != SIL_SHRUBBOT_DB_GUIDLEN ) {
+		memset(out, 0, sizeof(db_guid_t));
+		return qfalse;
+	}
+
+	// BG_hashword reads words, the guid in the struct has no alignment
+	memcpy(words, out->guid, sizeof(words));
+	out->hash = BG_hashword(words, SIL_SHRUBBOT_DB_GUIDLEN/4, 0);
+	out->check = BG_hashword(words, SIL_SHRUBBOT_DB_GUIDLEN/4, DB_GUID_CHECKSEED);
+
+	return qtrue;
+}
+
+qboolean G_DB_GUID_MatchesRaw(const char *a, const char *b)
+{
+#ifdef DB_GUID_SSE2
+	__m128i lo = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b));
+	__m128i hi = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(b + 16)));
+
+	return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff ? qtrue : qfalse;
+#else
+	return memcmp(a, b, SIL_SHRUBBOT_DB_GUIDLEN) ? qfalse : qtrue;
+#endif
+}
+
+qboolean G_DB_GUID_Matches(const char *stored, const db_guid_t *guid)
+{
+	return G_DB_GUID_MatchesRaw(stored, guid->guid);
+}
+
+qboolean G_DB_GUID_Equals(const db_guid_t *a, const db_guid_t *b)
+{
+	if( a->hash != b->hash || a->check != b->check ) {
+		return qfalse;
+	}
+	return G_DB_GUID_MatchesRaw(a->guid, b->guid);
+}
+
+#ifdef DB_GUID_SSE2
+// upper cases the 16 characters, only a-z are changed like with toupper in the C locale
+static __m128i DB_GUID_ToUpper16(__m128i chars)
+{
+	// signed compares, the characters over 127 are negative and never in the range
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('z' + 1)));
+
+	return _mm_sub_epi8(chars, _mm_and_si128(lower, _mm_set1_epi8(0x20)));
+}
+#endif
+
+qboolean G_DB_GUID_MatchesNoCase(const char *stored, const char *guid)
+{
+#ifdef DB_GUID_SSE2
+	__m128i lo = _mm_cmpeq_epi8(DB_GUID_ToUpper16(_mm_loadu_si128((const __m128i*)stored)), DB_GUID_ToUpper16(_mm_loadu_si128((const __m128i*)guid)));
+	__m128i hi = _mm_cmpeq_epi8(DB_GUID_ToUpper16(_mm_loadu_si128((const __m128i*)(stored + 16))), DB_GUID_ToUpper16(_mm_loadu_si128((const __m128i*)(guid + 16))));
+
+	return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff ? qtrue : qfalse;
+#else
+	int i;
+
+	for( i = 0; i < SIL_SHRUBBOT_DB_GUIDLEN ; i++ ) {
+		if( toupper(stored[i]) != toupper(guid[i]) ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+#endif
+}
@@ -0,0 +1,67 @@
+/*
+ *  Module contains the canonical GUID value used with the database modules.
+ *
+ *  The GUIDs are given to the database in many forms, lower or upper case, with or without the
+ *  terminating NUL. The canonical form is the upper case 32 character GUID without NUL, which is
+ *  the form stored in the database files. The normalization and the hashes are done once when the
+ *  GUID enters the database and the fast path functions accept the ready value.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, GUID length shared with the user database, case folded on both sides, agent
+*/
+
+#ifndef __G_DB_GUID_H__
+#define __G_DB_GUID_H__
+
+#define SIL_SHRUBBOT_DB_GUIDLEN			32
+
+typedef struct db_guid_s {
+	char		guid[SIL_SHRUBBOT_DB_GUIDLEN];	// upper case, no terminating NUL
+	uint32_t	hash;						// BG_hashword of the guid, the same value that is stored in the records
+	uint32_t	check;						// second half of the 64 bit fingerprint
+} db_guid_t;
+
+/**
+ * Function normalizes the GUID to the canonical form and calculates the fingerprint.
+ *
+ * @param out The canonical GUID.
+ * @param guid At least 32 characters of GUID, the terminating NUL is not needed.
+ * @return qfalse if the GUID is shorter than 32 characters, out is cleared then.
+ */
+qboolean G_DB_GUID_Set(db_guid_t *out, const char *guid);
+
+/**
+ * Function compares two canonical GUIDs, the fingerprints are compared before the GUIDs.
+ *
+ * @return qtrue if the GUIDs are equal
+ */
+qboolean G_DB_GUID_Equals(const db_guid_t *a, const db_guid_t *b);
+
+/**
+ * Function compares the 32 character GUID stored in a record to the canonical GUID.
+ *
+ * @param stored The GUID in the record, compared exactly.
+ * @param guid The canonical GUID.
+ * @return qtrue if the GUIDs are equal
+ */
+qboolean G_DB_GUID_Matches(const char *stored, const db_guid_t *guid);
+
+/**
+ * Same as G_DB_GUID_MatchesRaw but both GUIDs may be in any case. All the 32 characters are
+ * compared, so a shorter GUID must be padded with NULs like in the records.
+ *
+ * @param stored The GUID in the record.
+ * @param guid The searched GUID.
+ * @return qtrue if the GUIDs are equal ignoring the case
+ */
+qboolean G_DB_GUID_MatchesNoCase(const char *stored, const char *guid);
+
+/**
+ * Function compares two 32 character GUIDs exactly.
+ *
+ * @return qtrue if the GUIDs are equal
+ */
+qboolean G_DB_GUID_MatchesRaw(const char *a, const char *b);
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ *  Module contains a generic open addressing hash index for the database modules.
+ *
+ *  Linear probing is used. The slot arrays are allocated in one block each, so the index does not
+ *  fragment the server memory with small allocations even with hundreds of thousands of records.
+ *  Removed entries leave a marker to the slot so the probe chains stay intact. The markers are
+ *  dropped when the index is rebuilt on growth.
+ */
+
+#include "g_local.h"
+#include "g_db_hashindex.h"
+
+#define HASHINDEX_MINSIZE	64
+
+// marks a removed entry, never handed out
+static char hashindex_deleted;
+#define HASHINDEX_DELETED ((void*)&hashindex_deleted)
+
+// fibonacci hashing, spreads also the keys that are not good hash values themselves
+#define HASHINDEX_SLOT(index, key) (((uint32_t)(key) * 2654435769u) >> (index)->shift)
+
+static uint32_t DB_HashIndex_SizeFor(uint32_t expected)
+{
+	uint32_t size = HASHINDEX_MINSIZE;
+
+	// keep the load factor below 3/4
+	while( size / 4 * 3 <= expected ) {
+		size <<= 1;
+	}
+	return size;
+}
+
+static uint32_t DB_HashIndex_Shift(uint32_t size)
+{
+	uint32_t shift = 32;
+
+	while( size > 1 ) {
+		size >>= 1;
+		shift--;
+	}
+	return shift;
+}
+
+static int DB_HashIndex_Allocate(db_hashindex_t *index, uint32_t size)
+{
+	index->keys = (uint32_t*)malloc(sizeof(uint32_t) * size);
+	index->values = (void**)malloc(sizeof(void*) * size);
+
+	if( !index->keys || !index->values ) {
+		free(index->keys);
+		free(index->values);
+		memset(index, 0, sizeof(db_hashindex_t));
+		return -1;
+	}
+
+	memset(index->values, 0, sizeof(void*) * size);
+	index->size = size;
+	index->shift = DB_HashIndex_Shift(size);
+	index->used = 0;
+	index->deleted = 0;
+
+	return 0;
+}
+
+static void DB_HashIndex_Place(db_hashindex_t *index, uint32_t key, void *value)
+{
+	uint32_t mask = index->size - 1;
+	uint32_t slot = HASHINDEX_SLOT(index, key);
+
+	while( index->values[slot] && index->values[slot] != HASHINDEX_DELETED ) {
+		slot = (slot + 1) & mask;
+	}
+	if( index->values[slot] == HASHINDEX_DELETED ) {
+		index->deleted--;
+	}
+	index->keys[slot] = key;
+	index->values[slot] = value;
+	index->used++;
+}
+
+static int DB_HashIndex_Rebuild(db_hashindex_t *index, uint32_t size)
+{
+	db_hashindex_t old = *index;
+	uint32_t i;
+
+	if( DB_HashIndex_Allocate(index, size) == -1 ) {
+		// keep the old one working
+		*index = old;
+		return -1;
+	}
+
+	for( i = 0; i < old.size ; i++ ) {
+		if( old.values[i] && old.values[i] != HASHINDEX_DELETED ) {
+			DB_HashIndex_Place(index, old.keys[i], old.values[i]);
+		}
+	}
+
+	free(old.keys);
+	free(old.values);
+
+	return 0;
+}
+
+void G_DB_HashIndex_Init(db_hashindex_t *index, uint32_t expected)
+{
+	memset(index, 0, sizeof(db_hashindex_t));
+	DB_HashIndex_Allocate(index, DB_HashIndex_SizeFor(expected));
+}
+
+void G_DB_HashIndex_Free(db_hashindex_t *index)
+{
+	free(index->keys);
+	free(index->values);
+	memset(index, 0, sizeof(db_hashindex_t));
+}
+
+int G_DB_HashIndex_Insert(db_hashindex_t *index, uint32_t key, void *value)
+{
+	if( !value ) {
+		return -1;
+	}
+
+	if( (index->used + index->deleted + 1) >= index->size / 4 * 3 ) {
+		// grow only if the live entries need it, otherwise just clean up the removed ones
+		if( DB_HashIndex_Rebuild(index, DB_HashIndex_SizeFor(index->used + 1)) == -1
+			&& (!index->size || index->used + index->deleted + 1 >= index->size) ) {
+			// the probe loops end only at an empty slot, so the last one is never used
+			return -1;
+		}
+	}
+
+	DB_HashIndex_Place(index, key, value);
+
+	return 0;
+}
+
+qboolean G_DB_HashIndex_Remove(db_hashindex_t *index, uint32_t key, const void *value)
+{
+	uint32_t mask = index->size - 1;
+	uint32_t slot;
+
+	if( !index->size ) {
+		return qfalse;
+	}
+
+	slot = HASHINDEX_SLOT(index, key);
+	while( index->values[slot] ) {
+		if( index->values[slot] == value && index->keys[slot] == key ) {
+			index->values[slot] = HASHINDEX_DELETED;
+			index->used--;
+			index->deleted++;
+			return qtrue;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	return qfalse;
+}
+
+static void* DB_HashIndex_Scan(const db_hashindex_t *index, uint32_t key, uint32_t slot, uint32_t *iterator)
+{
+	uint32_t mask = index->size - 1;
+
+	while( index->values[slot] ) {
+		if( index->keys[slot] == key && index->values[slot] != HASHINDEX_DELETED ) {
+			*iterator = slot;
+			return index->values[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	*iterator = slot;
+	return NULL;
+}
+
+void* G_DB_HashIndex_First(const db_hashindex_t *index, uint32_t key, uint32_t *iterator)
+{
+	if( !index->size ) {
+		*iterator = 0;
+		return NULL;
+	}
+
+	return DB_HashIndex_Scan(index, key, HASHINDEX_SLOT(index, key), iterator);
+}
+
+void* G_DB_HashIndex_Next(const db_hashindex_t *index, uint32_t key, uint32_t *iterator)
+{
+	if( !index->size || !index->values[*iterator] ) {
+		// the previous call already reached the end of the probe chain
+		return NULL;
+	}
+
+	return DB_HashIndex_Scan(index, key, (*iterator + 1) & (index->size - 1), iterator);
+}
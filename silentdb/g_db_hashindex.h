@@ -0,0 +1,79 @@
+/*
+ *  Module contains a generic open addressing hash index for the database modules.
+ *
+ *  The index maps 32 bit keys (normally the GUID hashes already stored in the records) to pointers
+ *  owned by the caller. The same key may be stored any number of times. The caller iterates all the
+ *  entries stored with the key and does the final comparison of the actual data, exactly like the
+ *  loops comparing the hashes first did before.
+ *
+ *  The index never owns the data it points to. The caller is responsible to remove the entries before
+ *  the pointed data is released or the key of the data changes.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, Inserts fail instead of filling the last empty slot, agent
+*/
+
+#ifndef __G_DB_HASHINDEX_H__
+#define __G_DB_HASHINDEX_H__
+
+typedef struct db_hashindex_s {
+	uint32_t	*keys;
+	void		**values;		// NULL marks a free slot
+	uint32_t	size;			// number of slots, always a power of two
+	uint32_t	shift;			// 32 - log2(size), used to spread the keys
+	uint32_t	used;			// stored entries
+	uint32_t	deleted;		// removed entries still reserving a slot
+} db_hashindex_t;
+
+/**
+ * Function initializes the index for the expected amount of entries. The index grows automatically
+ * if more entries are inserted. Zero filled index is valid and empty, so the static indexes can be
+ * used without calling this function.
+ *
+ * @param index The index to initialize. Old content is not freed.
+ * @param expected The amount of entries the index is expected to store.
+ */
+void G_DB_HashIndex_Init(db_hashindex_t *index, uint32_t expected);
+
+/**
+ * Function releases all the memory of the index and leaves it empty and usable.
+ *
+ * @param index The index to free.
+ */
+void G_DB_HashIndex_Free(db_hashindex_t *index);
+
+/**
+ * Function stores a value with the key. Dublicates are not checked.
+ *
+ * @param index The index to insert to.
+ * @param key The key of the value.
+ * @param value The stored pointer, must not be NULL.
+ * @return 0 on success, -1 if out of memory
+ */
+int G_DB_HashIndex_Insert(db_hashindex_t *index, uint32_t key, void *value);
+
+/**
+ * Function removes the exact key value pair from the index.
+ *
+ * @param index The index to remove from.
+ * @param key The key the value was stored with.
+ * @param value The stored pointer.
+ * @return qtrue if the entry was found and removed
+ */
+qboolean G_DB_HashIndex_Remove(db_hashindex_t *index, uint32_t key, const void *value);
+
+/**
+ * Functions iterate all values stored with the key. G_DB_HashIndex_First sets the iterator and
+ * returns the first value, G_DB_HashIndex_Next returns the following ones. NULL is returned when
+ * there are no more values with the key. The index must not be modified during the iteration.
+ *
+ * @param index The index to search.
+ * @param key The searched key.
+ * @param iterator Caller owned iteration state.
+ * @return The stored pointer or NULL.
+ */
+void* G_DB_HashIndex_First(const db_hashindex_t *index, uint32_t key, uint32_t *iterator);
+void* G_DB_HashIndex_Next(const db_hashindex_t *index, uint32_t key, uint32_t *iterator);
+
+#endif
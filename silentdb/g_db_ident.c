@@ -0,0 +1,170 @@
+/*
+ *  Module contains the ident helpers of the database modules.
+ *
+ *  The excluded prefixes are kept in one array and indexed by the hash of the prefix. A mask of the
+ *  prefix lengths in use tells which lengths of the checked ident need a lookup.
+ */
+
+#include "g_local.h"
+#include "g_db_filehandling.h"
+#include "g_db_hashindex.h"
+#include "g_db_ident.h"
+
+typedef struct db_identprefix_s {
+	uint8_t		bytes[SIL_DB_IDENT_LENGTH];
+	uint32_t	length;
+} db_identprefix_t;
+
+// the prefixes used when the file does not exist
+static const char *db_ident_defaultprefixes[] = {
+	"000C29",				// VMware
+	"005056",				// VMware
+	"0000000023C34600",		// bad ident from 0.6.0, this can come from valid data also, but it is rare enough
+	NULL
+};
+
+static db_identprefix_t *prefixes;
+static uint32_t prefix_count;
+static uint32_t prefix_size;
+static db_hashindex_t prefix_index;
+static uint32_t prefix_lengths;		// bit n is set if a prefix of n bytes exists
+
+static const db_identprefix_t* DB_Ident_FindPrefix(const uint8_t *ident, uint32_t length)
+{
+	const db_identprefix_t *prefix;
+	uint32_t iterator;
+	uint32_t hash = G_DB_Ident_Hash(ident, length);
+
+	for( prefix = G_DB_HashIndex_First(&prefix_index, hash, &iterator) ; prefix ;
+		prefix = G_DB_HashIndex_Next(&prefix_index, hash, &iterator) ) {
+		if( prefix->length == length && !memcmp(prefix->bytes, ident, length) ) {
+			return prefix;
+		}
+	}
+
+	return NULL;
+}
+
+static void DB_Ident_AddPrefix(const char *string)
+{
+	db_identprefix_t prefix;
+	db_identprefix_t *memory;
+	uint32_t i;
+
+	memset(&prefix, 0, sizeof(prefix));
+	prefix.length = G_DB_Ident_FromString(string, prefix.bytes, sizeof(prefix.bytes));
+	if( !prefix.length || string[prefix.length * 2] ) {
+		G_LogPrintf("  Ignoring invalid ident prefix \"%s\" in %s.\n", string, SIL_DB_IDENTEXCLUDE_FILENAME);
+		return;
+	}
+	if( DB_Ident_FindPrefix(prefix.bytes, prefix.length) ) {
+		return;
+	}
+
+	if( prefix_count == prefix_size ) {
+		// the index points to the array, so it is rebuilt after the array moves
+		memory = (db_identprefix_t*)realloc(prefixes, sizeof(db_identprefix_t) * (prefix_size ? prefix_size * 2 : 16));
+		if( !memory ) {
+			return;
+		}
+		prefixes = memory;
+		prefix_size = prefix_size ? prefix_size * 2 : 16;
+		G_DB_HashIndex_Free(&prefix_index);
+		for( i = 0; i < prefix_count ; i++ ) {
+			G_DB_HashIndex_Insert(&prefix_index, G_DB_Ident_Hash(prefixes[i].bytes, prefixes[i].length), &prefixes[i]);
+		}
+	}
+
+	prefixes[prefix_count] = prefix;
+	if( G_DB_HashIndex_Insert(&prefix_index, G_DB_Ident_Hash(prefix.bytes, prefix.length), &prefixes[prefix_count]) == -1 ) {
+		return;
+	}
+	prefix_count++;
+	prefix_lengths |= 1 << prefix.length;
+}
+
+void G_DB_Ident_LoadExclusions(void)
+{
+	FILE *handle = NULL;
+	char line[64];
+	int i;
+
+	G_DB_Ident_FreeExclusions();
+
+	if( !G_DB_File_Open(&handle, SIL_DB_IDENTEXCLUDE_FILENAME, DB_FILEMODE_READTEXT) ) {
+		for( i = 0; db_ident_defaultprefixes[i] ; i++ ) {
+			DB_Ident_AddPrefix(db_ident_defaultprefixes[i]);
+		}
+		return;
+	}
+
+	while( G_DB_ReadConfigLine(handle, line, sizeof(line)) != -1 ) {
+		DB_Ident_AddPrefix(line);
+	}
+	G_DB_File_Close(&handle);
+
+	G_LogPrintf("  Read %d excluded ident prefixes from %s.\n", prefix_count, SIL_DB_IDENTEXCLUDE_FILENAME);
+}
+
+void G_DB_Ident_FreeExclusions(void)
+{
+	G_DB_HashIndex_Free(&prefix_index);
+	free(prefixes);
+	prefixes = NULL;
+	prefix_count = 0;
+	prefix_size = 0;
+	prefix_lengths = 0;
+}
+
+qboolean G_DB_Ident_IsExcluded(const uint8_t *ident, uint32_t length)
+{
+	uint32_t shortest, longest;
+	uint32_t i;
+
+	// the short prefixes are for the MAC addresses, the longer ones for the full idents
+	if( length > SIL_DB_IDENT_MACLENGTH ) {
+		shortest = SIL_DB_IDENT_MACLENGTH + 1;
+		longest = length;
+	} else {
+		shortest = 1;
+		longest = length;
+	}
+
+	for( i = shortest; i <= longest ; i++ ) {
+		if( (prefix_lengths & (1 << i)) && DB_Ident_FindPrefix(ident, i) ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+uint32_t G_DB_Ident_Hash(const uint8_t *ident, uint32_t length)
+{
+	uint32_t words[(SIL_DB_IDENT_LENGTH + 3) / 4];
+
+	memset(words, 0, sizeof(words));
+	memcpy(words, ident, length < sizeof(words) ? length : sizeof(words));
+
+	return BG_hashword(words, sizeof(words) / 4, length);
+}
+
+uint32_t G_DB_Ident_FromString(const char *string, uint8_t *ident, uint32_t size)
+{
+	uint32_t count = 0;
+	int high, low;
+
+	while( count < size ) {
+		high = isxdigit((unsigned char)string[0]) ? toupper((unsigned char)string[0]) : -1;
+		low = (high != -1 && isxdigit((unsigned char)string[1])) ? toupper((unsigned char)string[1]) : -1;
+		if( low == -1 ) {
+			break;
+		}
+		high = high <= '9' ? high - '0' : high - 'A' + 10;
+		low = low <= '9' ? low - '0' : low - 'A' + 10;
+		ident[count++] = (uint8_t)((high << 4) | low);
+		string += 2;
+	}
+
+	return count;
+}
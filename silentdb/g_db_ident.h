@@ -0,0 +1,64 @@
+/*
+ *  Module contains the ident helpers of the database modules.
+ *
+ *  Some idents are shared by a lot of players, like the MAC addresses of the virtual machines, and
+ *  they can't be used for identifying anyone. These are excluded with a set of prefixes read from
+ *  the file SIL_DB_IDENTEXCLUDE_FILENAME in the database directory, one hexadecimal prefix per line.
+ *  The prefixes up to the length of a MAC address are matched against the short idents and the
+ *  longer ones against the full length idents. Without the file the built in prefixes are used.
+ *
+ *  The prefixes are stored in a hash index by their length and bytes, so checking an ident costs
+ *  one lookup for each prefix length in use.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_IDENT_H__
+#define __G_DB_IDENT_H__
+
+#define SIL_DB_IDENTEXCLUDE_FILENAME	"identexclude.cfg"
+// the length of the short idents made of the MAC address
+#define SIL_DB_IDENT_MACLENGTH			6
+
+/**
+ * Function reads the excluded ident prefixes. Called when the database is initialized, before
+ * the indexes are built. The old prefixes are freed.
+ */
+void G_DB_Ident_LoadExclusions(void);
+
+/**
+ * Function frees the excluded ident prefixes. No ident is excluded after this.
+ */
+void G_DB_Ident_FreeExclusions(void);
+
+/**
+ * Function checks if the ident is excluded from identifying the players.
+ *
+ * @param ident The ident bytes.
+ * @param length The length of the ident, SIL_DB_IDENT_MACLENGTH for the short idents.
+ * @return qtrue if the ident must not be used
+ */
+qboolean G_DB_Ident_IsExcluded(const uint8_t *ident, uint32_t length);
+
+/**
+ * Function calculates the hash of the ident, the length is part of the hash.
+ *
+ * @param ident The ident bytes.
+ * @param length The length of the ident, at most SIL_DB_IDENT_LENGTH.
+ * @return The hash value.
+ */
+uint32_t G_DB_Ident_Hash(const uint8_t *ident, uint32_t length);
+
+/**
+ * Function converts the hexadecimal ident string to bytes. The conversion stops at the first
+ * character that is not a hexadecimal digit or when the output is full.
+ *
+ * @param string The hexadecimal string, case insensitive.
+ * @param ident The output bytes.
+ * @param size The size of the output.
+ * @return The amount of the converted bytes.
+ */
+uint32_t G_DB_Ident_FromString(const char *string, uint8_t *ident, uint32_t size);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ *  Module contains an interval index for the activity spans of the database modules.
+ *
+ *  The tree is an implicit binary tree over the sorted items, the node n has the children 2n and
+ *  2n + 1 and the leaf of the item i is leaves + i. A node holds the latest end of the spans below
+ *  it, so the subtrees ending before the window are skipped as a whole.
+ */
+
+#include "g_local.h"
+#include "g_db_interval.h"
+
+#define DB_INTERVAL_UNSET	0xffffffff	// the id has no span
+#define DB_INTERVAL_TAIL	0xfffffffe	// the id is in the tail
+#define DB_INTERVAL_NOEND	((int32_t)0x80000000)
+
+// the tail is merged when it grows over this plus the eighth of the sorted part
+#define DB_INTERVAL_MINTAIL	32
+
+static int DB_Interval_CompareItems(const void *a, const void *b)
+{
+	const db_interval_item_t *itemA = (const db_interval_item_t*)a;
+	const db_interval_item_t *itemB = (const db_interval_item_t*)b;
+
+	if( itemA->first != itemB->first ) {
+		return itemA->first < itemB->first ? -1 : 1;
+	}
+	return itemA->id < itemB->id ? -1 : (itemA->id > itemB->id);
+}
+
+static void DB_Interval_UpdateLeaf(db_interval_t *index, uint32_t position, int32_t last)
+{
+	uint32_t node = index->leaves + position;
+
+	index->tree[node] = last;
+	for( node >>= 1; node ; node >>= 1 ) {
+		index->tree[node] = index->tree[2 * node] > index->tree[2 * node + 1] ? index->tree[2 * node] : index->tree[2 * node + 1];
+	}
+}
+
+static int DB_Interval_Grow(db_interval_t *index, uint32_t id)
+{
+	uint32_t size = index->size ? index->size : 64;
+	void *memory;
+	uint32_t i;
+
+	while( size <= id ) {
+		size *= 2;
+	}
+
+	memory = realloc(index->first, sizeof(int32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	index->first = (int32_t*)memory;
+	memory = realloc(index->last, sizeof(int32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	index->last = (int32_t*)memory;
+	memory = realloc(index->position, sizeof(uint32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	index->position = (uint32_t*)memory;
+
+	for( i = index->size; i < size ; i++ ) {
+		index->position[i] = DB_INTERVAL_UNSET;
+	}
+	index->size = size;
+
+	return 0;
+}
+
+static int DB_Interval_AddTail(db_interval_t *index, uint32_t id)
+{
+	uint32_t *memory;
+
+	if( index->tailcount == index->tailsize ) {
+		memory = (uint32_t*)realloc(index->tail, sizeof(uint32_t) * (index->tailsize ? index->tailsize * 2 : DB_INTERVAL_MINTAIL));
+		if( !memory ) {
+			return -1;
+		}
+		index->tail = memory;
+		index->tailsize = index->tailsize ? index->tailsize * 2 : DB_INTERVAL_MINTAIL;
+	}
+
+	index->tail[index->tailcount++] = id;
+	index->position[id] = DB_INTERVAL_TAIL;
+
+	return 0;
+}
+
+void G_DB_Interval_Free(db_interval_t *index)
+{
+	free(index->first);
+	free(index->last);
+	free(index->position);
+	free(index->items);
+	free(index->tree);
+	free(index->tail);
+	memset(index, 0, sizeof(db_interval_t));
+}
+
+int G_DB_Interval_Build(db_interval_t *index)
+{
+	db_interval_item_t *items;
+	int32_t *tree;
+	uint32_t count = 0;
+	uint32_t leaves = 1;
+	uint32_t i;
+
+	for( i = 0; i < index->count ; i++ ) {
+		if( index->position[i] != DB_INTERVAL_UNSET ) {
+			count++;
+		}
+	}
+	while( leaves < count ) {
+		leaves <<= 1;
+	}
+
+	items = (db_interval_item_t*)malloc(sizeof(db_interval_item_t) * (count ? count : 1));
+	tree = (int32_t*)malloc(sizeof(int32_t) * 2 * leaves);
+	if( !items || !tree ) {
+		free(items);
+		free(tree);
+		return -1;
+	}
+
+	count = 0;
+	for( i = 0; i < index->count ; i++ ) {
+		if( index->position[i] != DB_INTERVAL_UNSET ) {
+			items[count].first = index->first[i];
+			items[count].id = i;
+			count++;
+		}
+	}
+	qsort(items, count, sizeof(db_interval_item_t), DB_Interval_CompareItems);
+
+	// the leaves first, then the inner nodes bottom up
+	for( i = 0; i < leaves ; i++ ) {
+		if( i < count ) {
+			tree[leaves + i] = index->last[items[i].id];
+			index->position[items[i].id] = i;
+		} else {
+			tree[leaves + i] = DB_INTERVAL_NOEND;
+		}
+	}
+	for( i = leaves - 1; i > 0 ; i-- ) {
+		tree[i] = tree[2 * i] > tree[2 * i + 1] ? tree[2 * i] : tree[2 * i + 1];
+	}
+
+	free(index->items);
+	free(index->tree);
+	index->items = items;
+	index->sorted = count;
+	index->tree = tree;
+	index->leaves = leaves;
+	index->tailcount = 0;
+
+	return 0;
+}
+
+int G_DB_Interval_Set(db_interval_t *index, uint32_t id, int32_t first, int32_t last)
+{
+	uint32_t position;
+
+	if( id >= index->size && DB_Interval_Grow(index, id) == -1 ) {
+		return -1;
+	}
+	if( id >= index->count ) {
+		index->count = id + 1;
+	}
+
+	position = index->position[id];
+	if( position < index->sorted && index->first[id] == first ) {
+		// only the end moves, the item stays in place
+		index->last[id] = last;
+		DB_Interval_UpdateLeaf(index, position, last);
+		return 0;
+	}
+
+	index->first[id] = first;
+	index->last[id] = last;
+	if( position == DB_INTERVAL_TAIL ) {
+		return 0;
+	}
+	if( position < index->sorted ) {
+		// the start moved, the sorted item is left dead and the span goes to the tail
+		DB_Interval_UpdateLeaf(index, position, DB_INTERVAL_NOEND);
+	}
+	if( DB_Interval_AddTail(index, id) == -1 ) {
+		index->position[id] = DB_INTERVAL_UNSET;
+		return -1;
+	}
+
+	if( index->tailcount > DB_INTERVAL_MINTAIL + index->sorted / 8 ) {
+		// a failed merge leaves the tail as it was
+		G_DB_Interval_Build(index);
+	}
+
+	return 0;
+}
+
+// visits the items below the node that start at the latest at the end position
+static qboolean DB_Interval_Descend(const db_interval_t *index, uint32_t node, uint32_t start, uint32_t width, uint32_t end,
+	int32_t from, db_interval_visit_f visit, void *context, int *visited)
+{
+	uint32_t id;
+
+	if( start >= end || index->tree[node] < from ) {
+		return qtrue;
+	}
+
+	if( width == 1 ) {
+		id = index->items[start].id;
+		// the dead items of the moved spans
+		if( index->position[id] != start ) {
+			return qtrue;
+		}
+		(*visited)++;
+		return visit(id, context);
+	}
+
+	width >>= 1;
+	if( !DB_Interval_Descend(index, 2 * node, start, width, end, from, visit, context, visited) ) {
+		return qfalse;
+	}
+	return DB_Interval_Descend(index, 2 * node + 1, start + width, width, end, from, visit, context, visited);
+}
+
+int G_DB_Interval_Search(const db_interval_t *index, int32_t from, int32_t to, db_interval_visit_f visit, void *context)
+{
+	uint32_t low = 0;
+	uint32_t high = index->sorted;
+	uint32_t mid;
+	uint32_t id;
+	uint32_t i;
+	int visited = 0;
+
+	if( from > to ) {
+		return 0;
+	}
+
+	// the items starting after the window can't overlap it
+	while( low < high ) {
+		mid = low + (high - low) / 2;
+		if( index->items[mid].first <= to ) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if( low && !DB_Interval_Descend(index, 1, 0, index->leaves, low, from, visit, context, &visited) ) {
+		return visited;
+	}
+
+	for( i = 0; i < index->tailcount ; i++ ) {
+		id = index->tail[i];
+		if( index->first[id] <= to && index->last[id] >= from ) {
+			visited++;
+			if( !visit(id, context) ) {
+				break;
+			}
+		}
+	}
+
+	return visited;
+}
@@ -0,0 +1,83 @@
+/*
+ *  Module contains an interval index for the activity spans of the database modules.
+ *
+ *  Every id has a span from the first to the last time it was seen. An overlap search hands out the
+ *  ids whose span shares at least one moment with the searched window. The spans are kept sorted by
+ *  their start with a tree of the latest end over the sorted order, so a search only descends to
+ *  the parts of the order that can hold overlapping spans and the cost follows the amount of the
+ *  hits. The spans added or moved after the last build are kept in a short unsorted tail that is
+ *  merged to the sorted part when it grows.
+ *
+ *  The ids are the alias entry indexes, the span is the first and the last seen time of the alias.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_INTERVAL_H__
+#define __G_DB_INTERVAL_H__
+
+typedef struct db_interval_item_s {
+	int32_t		first;
+	uint32_t	id;
+} db_interval_item_t;
+
+typedef struct db_interval_s {
+	int32_t				*first;		// by id
+	int32_t				*last;		// by id
+	uint32_t			*position;	// by id, the position in the items or one of the special positions
+	uint32_t			count;		// the highest id + 1
+	uint32_t			size;		// allocated ids
+	db_interval_item_t	*items;		// the sorted part, ascending by the start
+	uint32_t			sorted;
+	int32_t				*tree;		// the latest end over the items, the leaves start from leaves
+	uint32_t			leaves;
+	uint32_t			*tail;		// the ids not in the sorted part
+	uint32_t			tailcount;
+	uint32_t			tailsize;
+} db_interval_t;
+
+// called for the overlapping ids, return qfalse to stop the search
+typedef qboolean (*db_interval_visit_f)(uint32_t id, void *context);
+
+/**
+ * Function releases all the memory of the index and leaves it empty.
+ *
+ * @param index The index to free.
+ */
+void G_DB_Interval_Free(db_interval_t *index);
+
+/**
+ * Function sets the span of the id. A new id is added, the span of an old id is replaced. Moving
+ * only the end of the span is cheap, moving the start moves the id to the tail.
+ *
+ * @param index The index to update.
+ * @param id The id of the span.
+ * @param first The start of the span.
+ * @param last The end of the span, not before the start.
+ * @return 0 on success, -1 if out of memory
+ */
+int G_DB_Interval_Set(db_interval_t *index, uint32_t id, int32_t first, int32_t last);
+
+/**
+ * Function sorts all the spans to the sorted part. Called after adding a lot of spans at once,
+ * the index stays usable without this too.
+ *
+ * @param index The index to sort.
+ * @return 0 on success, -1 if out of memory. The index stays usable on failure.
+ */
+int G_DB_Interval_Build(db_interval_t *index);
+
+/**
+ * Function visits the ids whose span overlaps the window, the ends are inclusive.
+ *
+ * @param index The index to search.
+ * @param from The start of the window.
+ * @param to The end of the window.
+ * @param visit Function called for the overlapping ids, in no particular order.
+ * @param context Passed to the visit function.
+ * @return The amount of the visited ids.
+ */
+int G_DB_Interval_Search(const db_interval_t *index, int32_t from, int32_t to, db_interval_visit_f visit, void *context);
+
+#endif
@@ -0,0 +1,620 @@
+/*
+ *  Module contains the packed IP addresses and the IP trie of the database modules.
+ *
+ *  The nodes and the leaves are kept in two arrays and referred with indexes, so growing the arrays
+ *  does not invalidate anything. The range walks classify every subtree by the common prefix of its
+ *  keys: the subtrees completely out of the range are skipped, the subtrees completely in the range
+ *  are visited or counted without further checks and only the subtrees on the range edges are
+ *  descended.
+ */
+
+#include "g_local.h"
+#include "g_db_iptrie.h"
+
+#define DB_IPTRIE_MINSIZE	64
+
+#define DB_IPTRIE_DIR(key, bit) (((key)[(bit) >> 3] >> (7 - ((bit) & 7))) & 1)
+
+static const uint8_t db_ip_v4prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+////////////////////////////////////////////////////////////////////////////////
+// address parsing
+
+// returns the amount of the parsed octets, -1 if an octet is invalid
+static int DB_IP_ParseV4(const char *text, uint8_t *octets, const char **end)
+{
+	int count = 0;
+	int value;
+	int digits;
+
+	while( count < 4 ) {
+		value = 0;
+		for( digits = 0; digits < 3 && *text >= '0' && *text <= '9' ; digits++ ) {
+			value = value * 10 + (*text++ - '0');
+		}
+		if( !digits ) {
+			break;
+		}
+		if( value > 255 || (*text >= '0' && *text <= '9') ) {
+			return -1;
+		}
+		octets[count++] = (uint8_t)value;
+		if( *text != '.' || count == 4 ) {
+			break;
+		}
+		text++;
+	}
+
+	*end = text;
+	return count;
+}
+
+static int DB_IP_HexValue(char c)
+{
+	if( c >= '0' && c <= '9' ) {
+		return c - '0';
+	}
+	if( c >= 'a' && c <= 'f' ) {
+		return c - 'a' + 10;
+	}
+	if( c >= 'A' && c <= 'F' ) {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static qboolean DB_IP_ParseV6(const char *text, uint8_t *addr, const char **end)
+{
+	uint16_t groups[8];
+	int count = 0;
+	int gap = -1;
+	int value;
+	int digits;
+	int i, pos;
+
+	if( text[0] == ':' ) {
+		if( text[1] != ':' ) {
+			return qfalse;
+		}
+		gap = 0;
+		text += 2;
+	}
+
+	while( count < 8 ) {
+		value = 0;
+		for( digits = 0; digits < 4 && DB_IP_HexValue(*text) >= 0 ; digits++ ) {
+			value = value * 16 + DB_IP_HexValue(*text++);
+		}
+		if( !digits ) {
+			break;
+		}
+		if( DB_IP_HexValue(*text) >= 0 ) {
+			return qfalse;
+		}
+		groups[count++] = (uint16_t)value;
+		if( *text != ':' ) {
+			break;
+		}
+		if( text[1] == ':' ) {
+			if( gap != -1 ) {
+				return qfalse;
+			}
+			gap = count;
+			text += 2;
+			continue;
+		}
+		text++;
+		if( DB_IP_HexValue(*text) < 0 ) {
+			return qfalse;
+		}
+	}
+
+	if( (gap == -1 && count != 8) || (gap != -1 && count > 7) ) {
+		return qfalse;
+	}
+
+	memset(addr, 0, SIL_DB_IP_SIZE);
+	for( i = 0; i < count ; i++ ) {
+		// the groups after the gap are placed to the end
+		pos = (gap == -1 || i < gap) ? i : 8 - count + i;
+		addr[pos * 2] = (uint8_t)(groups[i] >> 8);
+		addr[pos * 2 + 1] = (uint8_t)(groups[i] & 0xff);
+	}
+
+	*end = text;
+	return qtrue;
+}
+
+static void DB_IP_MapV4(db_ip_t *ip, const uint8_t *octets, int count)
+{
+	memset(ip, 0, sizeof(db_ip_t));
+	memcpy(ip->addr, db_ip_v4prefix, sizeof(db_ip_v4prefix));
+	memcpy(&ip->addr[sizeof(db_ip_v4prefix)], octets, count);
+}
+
+// sets the range covering all the addresses starting with the prefix bits of the address
+static void DB_IP_PrefixRange(const db_ip_t *ip, int bits, db_ip_t *low, db_ip_t *high)
+{
+	uint8_t mask;
+	int i;
+
+	for( i = 0; i < SIL_DB_IP_SIZE ; i++, bits -= 8 ) {
+		mask = (bits >= 8) ? 0xff : (bits <= 0 ? 0 : (uint8_t)(0xff00 >> bits));
+		low->addr[i] = ip->addr[i] & mask;
+		high->addr[i] = ip->addr[i] | (uint8_t)~mask;
+	}
+}
+
+qboolean G_DB_IP_Parse(const char *text, db_ip_t *ip)
+{
+	uint8_t octets[4];
+	const char *end;
+
+	if( text[0] == '[' ) {
+		if( DB_IP_ParseV6(&text[1], ip->addr, &end) && *end == ']' ) {
+			return qtrue;
+		}
+	} else if( DB_IP_ParseV4(text, octets, &end) == 4 && (*end == '\0' || *end == ':') ) {
+		DB_IP_MapV4(ip, octets, 4);
+		return qtrue;
+	} else if( DB_IP_ParseV6(text, ip->addr, &end) && *end == '\0' ) {
+		return qtrue;
+	}
+
+	memset(ip, 0, sizeof(db_ip_t));
+	return qfalse;
+}
+
+qboolean G_DB_IP_ParseRange(const char *text, db_ip_t *low, db_ip_t *high)
+{
+	char buffer[64];
+	uint8_t octets[4];
+	const char *separator;
+	const char *end;
+	db_ip_t ip;
+	int bits;
+	int count;
+
+	separator = strchr(text, '-');
+	if( !separator ) {
+		separator = strchr(text, '/');
+	}
+
+	if( separator ) {
+		if( separator - text >= (int)sizeof(buffer) ) {
+			return qfalse;
+		}
+		memcpy(buffer, text, separator - text);
+		buffer[separator - text] = '\0';
+
+		if( *separator == '-' ) {
+			if( !G_DB_IP_Parse(buffer, low) || !G_DB_IP_Parse(&separator[1], high) ) {
+				return qfalse;
+			}
+			return memcmp(low->addr, high->addr, SIL_DB_IP_SIZE) <= 0 ? qtrue : qfalse;
+		}
+
+		if( !G_DB_IP_Parse(buffer, &ip) ) {
+			return qfalse;
+		}
+		for( bits = 0, end = &separator[1]; *end >= '0' && *end <= '9' && bits <= 128 ; end++ ) {
+			bits = bits * 10 + (*end - '0');
+		}
+		if( end == &separator[1] || *end ) {
+			return qfalse;
+		}
+		// the IPv4 prefix lengths are given for the 32 bit address
+		if( !strchr(buffer, ':') ) {
+			if( bits > 32 ) {
+				return qfalse;
+			}
+			bits += 96;
+		}
+		if( bits > 128 ) {
+			return qfalse;
+		}
+		DB_IP_PrefixRange(&ip, bits, low, high);
+		return qtrue;
+	}
+
+	if( G_DB_IP_Parse(text, low) ) {
+		*high = *low;
+		return qtrue;
+	}
+
+	// a.b.c means all the addresses starting with the octets, not the text prefix
+	count = DB_IP_ParseV4(text, octets, &end);
+	if( count < 1 || *end ) {
+		return qfalse;
+	}
+	DB_IP_MapV4(&ip, octets, count);
+	DB_IP_PrefixRange(&ip, 96 + count * 8, low, high);
+
+	return qtrue;
+}
+
+qboolean G_DB_IP_IsSet(const db_ip_t *ip)
+{
+	int i;
+
+	for( i = 0; i < SIL_DB_IP_SIZE ; i++ ) {
+		if( ip->addr[i] ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
+qboolean G_DB_IP_InRange(const db_ip_t *ip, const db_ip_t *low, const db_ip_t *high)
+{
+	if( !G_DB_IP_IsSet(ip) ) {
+		return qfalse;
+	}
+	if( memcmp(ip->addr, low->addr, SIL_DB_IP_SIZE) < 0 || memcmp(ip->addr, high->addr, SIL_DB_IP_SIZE) > 0 ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the trie
+
+static void DB_IPTrie_Key(uint8_t *key, const db_ip_t *ip, uint32_t id)
+{
+	memcpy(key, ip->addr, SIL_DB_IP_SIZE);
+	key[SIL_DB_IP_SIZE] = (uint8_t)(id >> 24);
+	key[SIL_DB_IP_SIZE+1] = (uint8_t)(id >> 16);
+	key[SIL_DB_IP_SIZE+2] = (uint8_t)(id >> 8);
+	key[SIL_DB_IP_SIZE+3] = (uint8_t)id;
+}
+
+static uint32_t DB_IPTrie_KeyID(const uint8_t *key)
+{
+	return ((uint32_t)key[SIL_DB_IP_SIZE] << 24) | ((uint32_t)key[SIL_DB_IP_SIZE+1] << 16)
+		| ((uint32_t)key[SIL_DB_IP_SIZE+2] << 8) | (uint32_t)key[SIL_DB_IP_SIZE+3];
+}
+
+static qboolean DB_IPTrie_Grow(void **array, uint32_t *size, size_t itemsize)
+{
+	uint32_t newsize = *size ? *size * 2 : DB_IPTRIE_MINSIZE;
+	void *memory = realloc(*array, itemsize * newsize);
+
+	if( !memory ) {
+		return qfalse;
+	}
+	*array = memory;
+	*size = newsize;
+	return qtrue;
+}
+
+// returns the index of a node, -1 if out of memory
+static int32_t DB_IPTrie_AllocNode(db_iptrie_t *trie)
+{
+	uint32_t node;
+
+	if( trie->freenode ) {
+		node = trie->freenode - 1;
+		trie->freenode = trie->nodes[node].child[0];
+		return node;
+	}
+	if( trie->nodesused == trie->nodesize && !DB_IPTrie_Grow((void**)&trie->nodes, &trie->nodesize, sizeof(db_iptrie_node_t)) ) {
+		return -1;
+	}
+	return trie->nodesused++;
+}
+
+static void DB_IPTrie_FreeNode(db_iptrie_t *trie, uint32_t node)
+{
+	trie->nodes[node].child[0] = trie->freenode;
+	trie->freenode = node + 1;
+}
+
+// returns the index of a leaf, -1 if out of memory
+static int32_t DB_IPTrie_AllocLeaf(db_iptrie_t *trie)
+{
+	uint32_t leaf;
+
+	if( trie->freeleaf ) {
+		leaf = trie->freeleaf - 1;
+		memcpy(&trie->freeleaf, trie->leaves[leaf].key, sizeof(uint32_t));
+		return leaf;
+	}
+	if( trie->leavesused == trie->leafsize && !DB_IPTrie_Grow((void**)&trie->leaves, &trie->leafsize, sizeof(db_iptrie_leaf_t)) ) {
+		return -1;
+	}
+	return trie->leavesused++;
+}
+
+static void DB_IPTrie_FreeLeaf(db_iptrie_t *trie, uint32_t leaf)
+{
+	memcpy(trie->leaves[leaf].key, &trie->freeleaf, sizeof(uint32_t));
+	trie->freeleaf = leaf + 1;
+}
+
+static uint32_t DB_IPTrie_SubtreeCount(const db_iptrie_t *trie, uint32_t ref)
+{
+	return (ref & SIL_DB_IPTRIE_LEAF) ? 1 : trie->nodes[ref].count;
+}
+
+void G_DB_IPTrie_Init(db_iptrie_t *trie, uint32_t expected)
+{
+	memset(trie, 0, sizeof(db_iptrie_t));
+
+	if( !expected ) {
+		return;
+	}
+	// the allocation failures are not fatal here, the arrays are grown when needed
+	trie->leaves = (db_iptrie_leaf_t*)malloc(sizeof(db_iptrie_leaf_t) * expected);
+	trie->nodes = (db_iptrie_node_t*)malloc(sizeof(db_iptrie_node_t) * expected);
+	trie->leafsize = trie->leaves ? expected : 0;
+	trie->nodesize = trie->nodes ? expected : 0;
+}
+
+void G_DB_IPTrie_Free(db_iptrie_t *trie)
+{
+	free(trie->nodes);
+	free(trie->leaves);
+	memset(trie, 0, sizeof(db_iptrie_t));
+}
+
+int G_DB_IPTrie_Insert(db_iptrie_t *trie, const db_ip_t *ip, uint32_t id)
+{
+	uint8_t key[SIL_DB_IPTRIE_KEYLEN];
+	const uint8_t *best;
+	uint32_t *slot;
+	uint32_t ref;
+	uint32_t bit;
+	uint32_t dir;
+	uint32_t i;
+	int32_t leaf;
+	int32_t node;
+	uint8_t diff;
+
+	if( !G_DB_IP_IsSet(ip) ) {
+		return 0;
+	}
+
+	DB_IPTrie_Key(key, ip, id);
+
+	// everything is allocated before taking pointers, the arrays may move
+	leaf = DB_IPTrie_AllocLeaf(trie);
+	if( leaf == -1 ) {
+		return -1;
+	}
+
+	if( !trie->count ) {
+		memcpy(trie->leaves[leaf].key, key, SIL_DB_IPTRIE_KEYLEN);
+		trie->root = leaf | SIL_DB_IPTRIE_LEAF;
+		trie->count = 1;
+		return 0;
+	}
+
+	node = DB_IPTrie_AllocNode(trie);
+	if( node == -1 ) {
+		DB_IPTrie_FreeLeaf(trie, leaf);
+		return -1;
+	}
+
+	// the closest key decides the position of the new node
+	ref = trie->root;
+	while( !(ref & SIL_DB_IPTRIE_LEAF) ) {
+		ref = trie->nodes[ref].child[DB_IPTRIE_DIR(key, trie->nodes[ref].bit)];
+	}
+	best = trie->leaves[ref & ~SIL_DB_IPTRIE_LEAF].key;
+
+	for( i = 0; i < SIL_DB_IPTRIE_KEYLEN && best[i] == key[i] ; i++ ) {
+	}
+	if( i == SIL_DB_IPTRIE_KEYLEN ) {
+		// already stored
+		DB_IPTrie_FreeLeaf(trie, leaf);
+		DB_IPTrie_FreeNode(trie, node);
+		return 0;
+	}
+	diff = best[i] ^ key[i];
+	for( bit = i * 8; !(diff & 0x80) ; bit++ ) {
+		diff <<= 1;
+	}
+	dir = DB_IPTRIE_DIR(key, bit);
+
+	memcpy(trie->leaves[leaf].key, key, SIL_DB_IPTRIE_KEYLEN);
+
+	slot = &trie->root;
+	while( !(*slot & SIL_DB_IPTRIE_LEAF) && trie->nodes[*slot].bit < bit ) {
+		trie->nodes[*slot].count++;
+		slot = &trie->nodes[*slot].child[DB_IPTRIE_DIR(key, trie->nodes[*slot].bit)];
+	}
+
+	trie->nodes[node].bit = bit;
+	trie->nodes[node].child[dir] = leaf | SIL_DB_IPTRIE_LEAF;
+	trie->nodes[node].child[!dir] = *slot;
+	trie->nodes[node].count = DB_IPTrie_SubtreeCount(trie, *slot) + 1;
+	*slot = node;
+	trie->count++;
+
+	return 0;
+}
+
+qboolean G_DB_IPTrie_Remove(db_iptrie_t *trie, const db_ip_t *ip, uint32_t id)
+{
+	uint8_t key[SIL_DB_IPTRIE_KEYLEN];
+	uint32_t *slot;
+	uint32_t ref;
+	uint32_t parent = 0;
+	qboolean hasParent = qfalse;
+
+	if( !trie->count || !G_DB_IP_IsSet(ip) ) {
+		return qfalse;
+	}
+
+	DB_IPTrie_Key(key, ip, id);
+
+	ref = trie->root;
+	while( !(ref & SIL_DB_IPTRIE_LEAF) ) {
+		parent = ref;
+		hasParent = qtrue;
+		ref = trie->nodes[ref].child[DB_IPTRIE_DIR(key, trie->nodes[ref].bit)];
+	}
+	if( memcmp(trie->leaves[ref & ~SIL_DB_IPTRIE_LEAF].key, key, SIL_DB_IPTRIE_KEYLEN) ) {
+		return qfalse;
+	}
+
+	if( !hasParent ) {
+		DB_IPTrie_FreeLeaf(trie, ref & ~SIL_DB_IPTRIE_LEAF);
+		trie->count = 0;
+		return qtrue;
+	}
+
+	// the nodes above the parent lose one leaf, the parent is replaced with the other child
+	slot = &trie->root;
+	while( *slot != parent ) {
+		trie->nodes[*slot].count--;
+		slot = &trie->nodes[*slot].child[DB_IPTRIE_DIR(key, trie->nodes[*slot].bit)];
+	}
+	*slot = trie->nodes[parent].child[!DB_IPTRIE_DIR(key, trie->nodes[parent].bit)];
+
+	DB_IPTrie_FreeNode(trie, parent);
+	DB_IPTrie_FreeLeaf(trie, ref & ~SIL_DB_IPTRIE_LEAF);
+	trie->count--;
+
+	return qtrue;
+}
+
+// compares the highest bits of the keys
+static int DB_IPTrie_ComparePrefix(const uint8_t *a, const uint8_t *b, uint32_t bits)
+{
+	uint32_t bytes = bits >> 3;
+	uint8_t mask;
+	int result = memcmp(a, b, bytes);
+
+	if( result || !(bits & 7) ) {
+		return result;
+	}
+	mask = (uint8_t)(0xff00 >> (bits & 7));
+	if( (a[bytes] & mask) == (b[bytes] & mask) ) {
+		return 0;
+	}
+	return (a[bytes] & mask) < (b[bytes] & mask) ? -1 : 1;
+}
+
+// returns qtrue if all the bits of the key starting from the bit are the value (0 or 0xff)
+static qboolean DB_IPTrie_SuffixIs(const uint8_t *key, uint32_t bit, uint8_t value)
+{
+	uint32_t i = bit >> 3;
+	uint8_t mask = (uint8_t)(0xff >> (bit & 7));
+
+	if( (key[i] & mask) != (value & mask) ) {
+		return qfalse;
+	}
+	for( i++; i < SIL_DB_IPTRIE_KEYLEN ; i++ ) {
+		if( key[i] != value ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+#define DB_IPTRIE_OUTSIDE	0
+#define DB_IPTRIE_PARTIAL	1
+#define DB_IPTRIE_INSIDE	2
+
+// the keys of a subtree share the bits above the bit of the subtree root, any leaf tells them
+static int DB_IPTrie_Classify(const db_iptrie_t *trie, uint32_t ref, const uint8_t *low, const uint8_t *high)
+{
+	const uint8_t *key;
+	uint32_t leaf = ref;
+	uint32_t bit;
+	int lowResult;
+	int highResult;
+
+	while( !(leaf & SIL_DB_IPTRIE_LEAF) ) {
+		leaf = trie->nodes[leaf].child[0];
+	}
+	key = trie->leaves[leaf & ~SIL_DB_IPTRIE_LEAF].key;
+
+	if( ref & SIL_DB_IPTRIE_LEAF ) {
+		if( memcmp(key, low, SIL_DB_IPTRIE_KEYLEN) < 0 || memcmp(key, high, SIL_DB_IPTRIE_KEYLEN) > 0 ) {
+			return DB_IPTRIE_OUTSIDE;
+		}
+		return DB_IPTRIE_INSIDE;
+	}
+
+	bit = trie->nodes[ref].bit;
+	lowResult = DB_IPTrie_ComparePrefix(key, low, bit);
+	highResult = DB_IPTrie_ComparePrefix(key, high, bit);
+	if( lowResult < 0 || highResult > 0 ) {
+		return DB_IPTRIE_OUTSIDE;
+	}
+	if( (lowResult > 0 || DB_IPTrie_SuffixIs(low, bit, 0)) && (highResult < 0 || DB_IPTrie_SuffixIs(high, bit, 0xff)) ) {
+		return DB_IPTRIE_INSIDE;
+	}
+	return DB_IPTRIE_PARTIAL;
+}
+
+static qboolean DB_IPTrie_WalkAll(const db_iptrie_t *trie, uint32_t ref, db_iptrie_visit_f visit, void *context)
+{
+	if( ref & SIL_DB_IPTRIE_LEAF ) {
+		return visit(DB_IPTrie_KeyID(trie->leaves[ref & ~SIL_DB_IPTRIE_LEAF].key), context);
+	}
+	if( !DB_IPTrie_WalkAll(trie, trie->nodes[ref].child[0], visit, context) ) {
+		return qfalse;
+	}
+	return DB_IPTrie_WalkAll(trie, trie->nodes[ref].child[1], visit, context);
+}
+
+static qboolean DB_IPTrie_WalkRange(const db_iptrie_t *trie, uint32_t ref, const uint8_t *low, const uint8_t *high, db_iptrie_visit_f visit, void *context)
+{
+	switch( DB_IPTrie_Classify(trie, ref, low, high) ) {
+		case DB_IPTRIE_INSIDE:
+			return DB_IPTrie_WalkAll(trie, ref, visit, context);
+		case DB_IPTRIE_PARTIAL:
+			if( !DB_IPTrie_WalkRange(trie, trie->nodes[ref].child[0], low, high, visit, context) ) {
+				return qfalse;
+			}
+			return DB_IPTrie_WalkRange(trie, trie->nodes[ref].child[1], low, high, visit, context);
+		default:
+			return qtrue;
+	}
+}
+
+static uint32_t DB_IPTrie_CountRange(const db_iptrie_t *trie, uint32_t ref, const uint8_t *low, const uint8_t *high)
+{
+	switch( DB_IPTrie_Classify(trie, ref, low, high) ) {
+		case DB_IPTRIE_INSIDE:
+			return DB_IPTrie_SubtreeCount(trie, ref);
+		case DB_IPTRIE_PARTIAL:
+			return DB_IPTrie_CountRange(trie, trie->nodes[ref].child[0], low, high)
+				+ DB_IPTrie_CountRange(trie, trie->nodes[ref].child[1], low, high);
+		default:
+			return 0;
+	}
+}
+
+qboolean G_DB_IPTrie_Walk(const db_iptrie_t *trie, const db_ip_t *low, const db_ip_t *high, db_iptrie_visit_f visit, void *context)
+{
+	uint8_t lowKey[SIL_DB_IPTRIE_KEYLEN];
+	uint8_t highKey[SIL_DB_IPTRIE_KEYLEN];
+
+	if( !trie->count ) {
+		return qtrue;
+	}
+
+	DB_IPTrie_Key(lowKey, low, 0);
+	DB_IPTrie_Key(highKey, high, 0xffffffff);
+
+	return DB_IPTrie_WalkRange(trie, trie->root, lowKey, highKey, visit, context);
+}
+
+uint32_t G_DB_IPTrie_Count(const db_iptrie_t *trie, const db_ip_t *low, const db_ip_t *high)
+{
+	uint8_t lowKey[SIL_DB_IPTRIE_KEYLEN];
+	uint8_t highKey[SIL_DB_IPTRIE_KEYLEN];
+
+	if( !trie->count ) {
+		return 0;
+	}
+
+	DB_IPTrie_Key(lowKey, low, 0);
+	DB_IPTrie_Key(highKey, high, 0xffffffff);
+
+	return DB_IPTrie_CountRange(trie, trie->root, lowKey, highKey);
+}
@@ -0,0 +1,144 @@
+/*
+ *  Module contains the packed IP addresses and the IP trie of the database modules.
+ *
+ *  The addresses are stored as 16 byte IPv6 addresses, the IPv4 addresses are mapped to
+ *  ::ffff:a.b.c.d. The trie is a crit-bit trie keyed with the address followed by the caller's id,
+ *  so the same address can be stored for many ids. Every inner node knows the amount of the
+ *  records below it, so the amount of the records in a range is known without visiting them.
+ *
+ *  The user records store the last IP in this form, so the IPv6 users are indexed like the IPv4
+ *  ones. The text field of the record is only for showing the address.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, User records limited to IPv4 addresses, agent
+ *  2026-10-17, User records store the binary address, IPv6 included, agent
+*/
+
+#ifndef __G_DB_IPTRIE_H__
+#define __G_DB_IPTRIE_H__
+
+#define SIL_DB_IP_SIZE		16
+#define SIL_DB_IPTRIE_KEYLEN	(SIL_DB_IP_SIZE + 4)
+
+typedef struct db_ip_s {
+	uint8_t		addr[SIL_DB_IP_SIZE];	// network byte order, all zero if not set
+} db_ip_t;
+
+typedef struct db_iptrie_node_s {
+	uint32_t	child[2];	// node index or leaf index with SIL_DB_IPTRIE_LEAF set
+	uint32_t	count;		// leaves below the node
+	uint32_t	bit;		// the first differing bit of the children, counted from the highest bit of the key
+} db_iptrie_node_t;
+
+typedef struct db_iptrie_leaf_s {
+	uint8_t		key[SIL_DB_IPTRIE_KEYLEN];	// the address and the big endian id
+} db_iptrie_leaf_t;
+
+typedef struct db_iptrie_s {
+	db_iptrie_node_t	*nodes;
+	db_iptrie_leaf_t	*leaves;
+	uint32_t			nodesize;		// allocated nodes
+	uint32_t			leafsize;		// allocated leaves
+	uint32_t			nodesused;		// nodes handed out, including the free ones
+	uint32_t			leavesused;
+	uint32_t			freenode;		// free lists linked through the first word, index + 1, 0 if empty
+	uint32_t			freeleaf;
+	uint32_t			root;			// valid only when count is not 0
+	uint32_t			count;			// stored records
+} db_iptrie_t;
+
+#define SIL_DB_IPTRIE_LEAF	0x80000000u
+
+// called for the ids in the address order, return qfalse to stop the walk
+typedef qboolean (*db_iptrie_visit_f)(uint32_t id, void *context);
+
+/**
+ * Function parses an IPv4 or IPv6 address. The port is ignored if given as "a.b.c.d:port"
+ * or "[v6]:port".
+ *
+ * @param text The address.
+ * @param ip The parsed address, cleared if the text is not an address.
+ * @return qtrue if the text was an address
+ */
+qboolean G_DB_IP_Parse(const char *text, db_ip_t *ip);
+
+/**
+ * Function parses an IP search. The search can be one address, CIDR "a.b.c.d/n", range
+ * "a.b.c.d-e.f.g.h" or a partial IPv4 address "a.b.c", which means all the addresses
+ * starting with the given octets.
+ *
+ * @param text The search.
+ * @param low The first address of the range.
+ * @param high The last address of the range.
+ * @return qtrue if the text was a valid search
+ */
+qboolean G_DB_IP_ParseRange(const char *text, db_ip_t *low, db_ip_t *high);
+
+/**
+ * @return qtrue if the address is set
+ */
+qboolean G_DB_IP_IsSet(const db_ip_t *ip);
+
+/**
+ * @return qtrue if the address is set and within the range
+ */
+qboolean G_DB_IP_InRange(const db_ip_t *ip, const db_ip_t *low, const db_ip_t *high);
+
+/**
+ * Function initializes the trie for the expected amount of records. The trie grows automatically
+ * if more records are inserted. Zero filled trie is valid and empty.
+ *
+ * @param trie The trie to initialize. Old content is not freed.
+ * @param expected The amount of records the trie is expected to store.
+ */
+void G_DB_IPTrie_Init(db_iptrie_t *trie, uint32_t expected);
+
+/**
+ * Function releases all the memory of the trie and leaves it empty and usable.
+ *
+ * @param trie The trie to free.
+ */
+void G_DB_IPTrie_Free(db_iptrie_t *trie);
+
+/**
+ * Function stores the id with the address. Unset addresses are not stored.
+ *
+ * @param trie The trie to insert to.
+ * @param ip The address.
+ * @param id The id of the record.
+ * @return 0 on success, -1 if out of memory
+ */
+int G_DB_IPTrie_Insert(db_iptrie_t *trie, const db_ip_t *ip, uint32_t id);
+
+/**
+ * Function removes the id stored with the address.
+ *
+ * @param trie The trie to remove from.
+ * @param ip The address the id was stored with.
+ * @param id The id of the record.
+ * @return qtrue if the record was found and removed
+ */
+qboolean G_DB_IPTrie_Remove(db_iptrie_t *trie, const db_ip_t *ip, uint32_t id);
+
+/**
+ * Function visits the ids stored with the addresses in the range.
+ *
+ * @param trie The trie to search.
+ * @param low The first address of the range.
+ * @param high The last address of the range.
+ * @param visit Function called for the ids.
+ * @param context Passed to the visit function.
+ * @return qfalse if the walk was stopped by the visit function
+ */
+qboolean G_DB_IPTrie_Walk(const db_iptrie_t *trie, const db_ip_t *low, const db_ip_t *high, db_iptrie_visit_f visit, void *context);
+
+/**
+ * Function counts the ids stored with the addresses in the range. The records are not visited,
+ * the cost is the depth of the trie.
+ *
+ * @return The amount of the records in the range.
+ */
+uint32_t G_DB_IPTrie_Count(const db_iptrie_t *trie, const db_ip_t *low, const db_ip_t *high);
+
+#endif
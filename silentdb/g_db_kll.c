@@ -0,0 +1,221 @@
+/*
+ *  Module contains a quantile sketch for the value distributions of the database modules.
+ *
+ *  The levels are compacted bottom up right after they fill, so the values promoted from a level
+ *  are handled in the same pass. The compaction keeps the odd value of a level at the level and
+ *  promotes either the even or the odd positions by a coin flip, so the errors of the compactions
+ *  cancel out on average.
+ */
+
+#include "g_local.h"
+#include "g_db_kll.h"
+
+typedef struct db_kll_weighted_s {
+	float		value;		// first, the values are sorted with the same comparison as the levels
+	uint32_t	weight;
+} db_kll_weighted_t;
+
+// room for every value the levels can hold, so a merged sketch is never cut short
+static db_kll_weighted_t kll_values[SIL_DB_KLL_MAXLEVELS * SIL_DB_KLL_LEVELSIZE];
+
+static int DB_Kll_CompareValues(const void *a, const void *b)
+{
+	float valueA = *(const float*)a;
+	float valueB = *(const float*)b;
+
+	return valueA < valueB ? -1 : (valueA > valueB);
+}
+
+// the capacity shrinks by two thirds for every level below the top
+static uint32_t DB_Kll_Capacity(const db_kll_t *sketch, uint32_t level)
+{
+	float capacity = SIL_DB_KLL_K;
+	uint32_t depth;
+
+	for( depth = level + 1; depth < sketch->levels ; depth++ ) {
+		capacity *= 2.0f / 3.0f;
+	}
+
+	return capacity > 2.0f ? (uint32_t)(capacity + 0.999f) : 2;
+}
+
+static uint32_t DB_Kll_Coin(db_kll_t *sketch)
+{
+	uint32_t x = sketch->seed ? sketch->seed : 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	sketch->seed = x;
+
+	return x >> 31;
+}
+
+static void DB_Kll_Compact(db_kll_t *sketch, uint32_t level)
+{
+	float *items = sketch->items[level];
+	float *upper;
+	uint32_t count = sketch->counts[level];
+	uint32_t pairs = count & ~1u;
+	uint32_t i;
+
+	if( level + 1 >= SIL_DB_KLL_MAXLEVELS ) {
+		// more than 2^19 times the capacity values, the top level is just kept full
+		return;
+	}
+	if( level + 1 == sketch->levels ) {
+		sketch->counts[sketch->levels++] = 0;
+	}
+
+	qsort(items, count, sizeof(float), DB_Kll_CompareValues);
+
+	upper = sketch->items[level + 1];
+	for( i = DB_Kll_Coin(sketch); i < pairs ; i += 2 ) {
+		upper[sketch->counts[level + 1]++] = items[i];
+	}
+
+	// the odd one stays
+	if( count & 1 ) {
+		items[0] = items[count - 1];
+	}
+	sketch->counts[level] = count & 1;
+}
+
+static void DB_Kll_Compress(db_kll_t *sketch)
+{
+	uint32_t level;
+
+	for( level = 0; level < sketch->levels ; level++ ) {
+		if( sketch->counts[level] >= DB_Kll_Capacity(sketch, level) ) {
+			DB_Kll_Compact(sketch, level);
+		}
+	}
+}
+
+static void DB_Kll_Insert(db_kll_t *sketch, uint32_t level, float value)
+{
+	while( level >= sketch->levels ) {
+		sketch->counts[sketch->levels++] = 0;
+	}
+	if( sketch->counts[level] == SIL_DB_KLL_LEVELSIZE ) {
+		// only the top level of a full sketch can get here
+		sketch->counts[level]--;
+	}
+	sketch->items[level][sketch->counts[level]++] = value;
+	if( sketch->counts[level] >= DB_Kll_Capacity(sketch, level) ) {
+		DB_Kll_Compress(sketch);
+	}
+}
+
+void G_DB_Kll_Clear(db_kll_t *sketch)
+{
+	sketch->levels = 0;
+	sketch->n = 0;
+	sketch->min = 0.0f;
+	sketch->max = 0.0f;
+}
+
+void G_DB_Kll_Add(db_kll_t *sketch, float value)
+{
+	if( value != value ) {
+		return;
+	}
+
+	if( !sketch->n || value < sketch->min ) {
+		sketch->min = value;
+	}
+	if( !sketch->n || value > sketch->max ) {
+		sketch->max = value;
+	}
+	sketch->n++;
+
+	DB_Kll_Insert(sketch, 0, value);
+}
+
+void G_DB_Kll_Merge(db_kll_t *sketch, const db_kll_t *other)
+{
+	uint32_t level;
+	uint32_t i;
+
+	if( !other->n || sketch == other ) {
+		return;
+	}
+
+	if( !sketch->n || other->min < sketch->min ) {
+		sketch->min = other->min;
+	}
+	if( !sketch->n || other->max > sketch->max ) {
+		sketch->max = other->max;
+	}
+	sketch->n += other->n;
+
+	for( level = 0; level < other->levels ; level++ ) {
+		for( i = 0; i < other->counts[level] ; i++ ) {
+			DB_Kll_Insert(sketch, level, other->items[level][i]);
+		}
+	}
+}
+
+float G_DB_Kll_Quantile(const db_kll_t *sketch, float fraction)
+{
+	db_kll_weighted_t *values = kll_values;
+	uint32_t count = 0;
+	uint32_t level;
+	uint32_t i;
+	double total = 0.0;
+	double target;
+	double seen = 0.0;
+
+	if( !sketch->n ) {
+		return 0.0f;
+	}
+	if( fraction <= 0.0f ) {
+		return sketch->min;
+	}
+	if( fraction >= 1.0f ) {
+		return sketch->max;
+	}
+
+	for( level = 0; level < sketch->levels ; level++ ) {
+		for( i = 0; i < sketch->counts[level] ; i++ ) {
+			values[count].value = sketch->items[level][i];
+			values[count].weight = 1u << level;
+			total += values[count].weight;
+			count++;
+		}
+	}
+	qsort(values, count, sizeof(db_kll_weighted_t), DB_Kll_CompareValues);
+
+	target = fraction * total;
+	for( i = 0; i < count ; i++ ) {
+		seen += values[i].weight;
+		if( seen >= target ) {
+			return values[i].value;
+		}
+	}
+
+	return sketch->max;
+}
+
+float G_DB_Kll_Rank(const db_kll_t *sketch, float value)
+{
+	double total = 0.0;
+	double below = 0.0;
+	uint32_t level;
+	uint32_t i;
+
+	if( !sketch->n ) {
+		return 0.0f;
+	}
+
+	for( level = 0; level < sketch->levels ; level++ ) {
+		for( i = 0; i < sketch->counts[level] ; i++ ) {
+			total += (double)(1u << level);
+			if( sketch->items[level][i] <= value ) {
+				below += (double)(1u << level);
+			}
+		}
+	}
+
+	return total > 0.0 ? (float)(below / total) : 0.0f;
+}
@@ -0,0 +1,76 @@
+/*
+ *  Module contains a quantile sketch for the value distributions of the database modules.
+ *
+ *  The sketch is a KLL sketch. The added values go to the lowest level, a full level is sorted and
+ *  every other value of it is promoted to the next level with double weight. The capacities of the
+ *  levels shrink by two thirds from the top down, so the sketch keeps a constant amount of values
+ *  however many are added and the rank error stays around one percent. Two sketches can be merged
+ *  level by level, the result is the sketch of both value streams.
+ *
+ *  The sketch has no memory allocations, all the levels are in the structure.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, Quantiles use all the kept values, agent
+*/
+
+#ifndef __G_DB_KLL_H__
+#define __G_DB_KLL_H__
+
+#define SIL_DB_KLL_K			200		// the capacity of the top level
+#define SIL_DB_KLL_MAXLEVELS	20		// the top level has the weight 2^19
+// a level may hold up to one and a half capacities while the levels below are compacted to it
+#define SIL_DB_KLL_LEVELSIZE	(SIL_DB_KLL_K * 2)
+
+typedef struct db_kll_s {
+	float		items[SIL_DB_KLL_MAXLEVELS][SIL_DB_KLL_LEVELSIZE];
+	uint32_t	counts[SIL_DB_KLL_MAXLEVELS];
+	uint32_t	levels;		// the levels in use
+	uint32_t	n;			// the amount of the added values
+	float		min;
+	float		max;
+	uint32_t	seed;		// the state of the compaction coin
+} db_kll_t;
+
+/**
+ * Function empties the sketch. Zero filled sketch is valid and empty.
+ *
+ * @param sketch The sketch to empty.
+ */
+void G_DB_Kll_Clear(db_kll_t *sketch);
+
+/**
+ * Function adds a value to the sketch.
+ *
+ * @param sketch The sketch to update.
+ * @param value The value, NaN is ignored.
+ */
+void G_DB_Kll_Add(db_kll_t *sketch, float value);
+
+/**
+ * Function adds the values of the other sketch to the sketch.
+ *
+ * @param sketch The sketch to update.
+ * @param other The sketch to merge, not changed.
+ */
+void G_DB_Kll_Merge(db_kll_t *sketch, const db_kll_t *other);
+
+/**
+ * Function estimates the value at the fraction of the distribution, 0.5 is the median.
+ *
+ * @param sketch The sketch to query.
+ * @param fraction 0 - 1, 0 gives the smallest and 1 the largest added value.
+ * @return The estimated value or 0 if the sketch is empty.
+ */
+float G_DB_Kll_Quantile(const db_kll_t *sketch, float fraction);
+
+/**
+ * Function estimates the fraction of the added values not greater than the value.
+ *
+ * @param sketch The sketch to query.
+ * @param value The value.
+ * @return 0 - 1, 0 if the sketch is empty.
+ */
+float G_DB_Kll_Rank(const db_kll_t *sketch, float value);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ *  Module contains the name column and the name kernels of the database modules.
+ *
+ *  The vector kernels are compiled with the target attributes, so the module itself needs no
+ *  special compiler flags and the same binary runs also on the CPUs without the features. With the
+ *  compilers not supporting the attributes, SSE2 is used if the whole build targets it.
+ *
+ *  The sanitizing kernel copies the runs of the plain characters with one vector operation and
+ *  handles the color codes one by one. It reads the name in aligned blocks, so the reads never
+ *  cross a page boundary past the terminating NUL.
+ */
+
+#include "g_local.h"
+#include "g_db_namescan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DB_NAMESCAN_SSE2
+#define DB_NAMESCAN_AVX2
+#define DB_NAMESCAN_TARGET(t) __attribute__((target(t)))
+#include <immintrin.h>
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DB_NAMESCAN_SSE2
+#define DB_NAMESCAN_TARGET(t)
+#include <emmintrin.h>
+#endif
+
+typedef void (*db_namescan_sanitize_f)(const char *name, char *out, uint32_t size);
+typedef int (*db_namescan_scan_f)(const db_namecolumn_t *column, const char *pattern, uint32_t length, db_namecolumn_visit_f visit, void *context);
+
+static void DB_NameScan_SanitizeScalar(const char *name, char *out, uint32_t size);
+static int DB_NameScan_ScanScalar(const db_namecolumn_t *column, const char *pattern, uint32_t length, db_namecolumn_visit_f visit, void *context);
+
+static db_namescan_sanitize_f db_namescan_sanitize = DB_NameScan_SanitizeScalar;
+static db_namescan_scan_f db_namescan_scan = DB_NameScan_ScanScalar;
+
+////////////////////////////////////////////////////////////////////////////////
+// scalar kernels
+
+static void DB_NameScan_SanitizeScalar(const char *name, char *out, uint32_t size)
+{
+	uint32_t pos = 0;
+	uint32_t i;
+
+	for( i = 0; *name && i + 1 < size ; i++ ) {
+		if( *name == '^' ) {
+			// the color code, ^^ skips only the first one
+			name++;
+			if( *name != '^' ) {
+				if( !*name ) {
+					break;
+				}
+				name++;
+			}
+			continue;
+		}
+		out[pos++] = tolower((unsigned char)*name++);
+	}
+	out[pos] = '\0';
+}
+
+static int DB_NameScan_ScanScalar(const db_namecolumn_t *column, const char *pattern, uint32_t length, db_namecolumn_visit_f visit, void *context)
+{
+	uint32_t id;
+	int visited = 0;
+
+	for( id = 0; id < column->count ; id++ ) {
+		if( strstr(&column->names[id * SIL_DB_NAMECOLUMN_WIDTH], pattern) ) {
+			visited++;
+			if( !visit(id, context) ) {
+				break;
+			}
+		}
+	}
+
+	return visited;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// vector kernels
+
+#ifdef DB_NAMESCAN_SSE2
+static uint32_t DB_NameScan_LowestBit(uint32_t mask)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	uint32_t bit = 0;
+
+	while( !(mask & 1) ) {
+		mask >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+// lower cases the 16 characters, only A-Z are changed like with tolower in the C locale
+DB_NAMESCAN_TARGET("sse2")
+static __m128i DB_NameScan_ToLower16(__m128i chars)
+{
+	// signed compares, the characters over 127 are negative and never in the range
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+
+	return _mm_add_epi8(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+DB_NAMESCAN_TARGET("sse2")
+static void DB_NameScan_SanitizeSSE2(const char *name, char *out, uint32_t size)
+{
+	char lowered[16];
+	__m128i chars;
+	uint32_t special;
+	uint32_t offset;
+	uint32_t run;
+	uint32_t pos = 0;
+	uint32_t i = 0;
+
+	while( i + 1 < size ) {
+		// the aligned block holding the next character, the bits before it are shifted out
+		offset = (uint32_t)((size_t)name & 15);
+		chars = _mm_load_si128((const __m128i*)(name - offset));
+		special = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('^')),
+			_mm_cmpeq_epi8(chars, _mm_setzero_si128()))) >> offset;
+
+		run = special ? DB_NameScan_LowestBit(special) : 16 - offset;
+		if( run ) {
+			if( run > size - 1 - i ) {
+				run = size - 1 - i;
+			}
+			_mm_storeu_si128((__m128i*)lowered, DB_NameScan_ToLower16(chars));
+			memcpy(&out[pos], &lowered[offset], run);
+			pos += run;
+			i += run;
+			name += run;
+			continue;
+		}
+
+		if( !*name ) {
+			break;
+		}
+		// the color code, ^^ skips only the first one
+		name++;
+		if( *name != '^' ) {
+			if( !*name ) {
+				break;
+			}
+			name++;
+		}
+		i++;
+	}
+	out[pos] = '\0';
+}
+
+DB_NAMESCAN_TARGET("sse2")
+static int DB_NameScan_ScanSSE2(const db_namecolumn_t *column, const char *pattern, uint32_t length, db_namecolumn_visit_f visit, void *context)
+{
+	const __m128i first = _mm_set1_epi8(pattern[0]);
+	const __m128i last = _mm_set1_epi8(pattern[length - 1]);
+	const char *name;
+	qboolean found;
+	uint32_t id;
+	uint32_t start;
+	uint32_t mask;
+	uint32_t bit;
+	int visited = 0;
+
+	for( id = 0; id < column->count ; id++ ) {
+		name = &column->names[id * SIL_DB_NAMECOLUMN_WIDTH];
+		found = qfalse;
+		// the padding never matches the pattern, so the positions past the name need no masking
+		for( start = 0; !found && start + length < SIL_DB_NAMECOLUMN_WIDTH ; start += 16 ) {
+			mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i*)&name[start])),
+				_mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i*)&name[start + length - 1]))));
+			while( mask ) {
+				bit = DB_NameScan_LowestBit(mask);
+				if( !memcmp(&name[start + bit], pattern, length) ) {
+					found = qtrue;
+					break;
+				}
+				mask &= mask - 1;
+			}
+		}
+		if( found ) {
+			visited++;
+			if( !visit(id, context) ) {
+				break;
+			}
+		}
+	}
+
+	return visited;
+}
+#endif
+
+#ifdef DB_NAMESCAN_AVX2
+DB_NAMESCAN_TARGET("avx2")
+static int DB_NameScan_ScanAVX2(const db_namecolumn_t *column, const char *pattern, uint32_t length, db_namecolumn_visit_f visit, void *context)
+{
+	const __m256i first = _mm256_set1_epi8(pattern[0]);
+	const __m256i last = _mm256_set1_epi8(pattern[length - 1]);
+	const char *name;
+	qboolean found;
+	uint32_t id;
+	uint32_t start;
+	uint32_t mask;
+	uint32_t bit;
+	int visited = 0;
+
+	for( id = 0; id < column->count ; id++ ) {
+		name = &column->names[id * SIL_DB_NAMECOLUMN_WIDTH];
+		found = qfalse;
+		for( start = 0; !found && start + length < SIL_DB_NAMECOLUMN_WIDTH ; start += 32 ) {
+			mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i*)&name[start])),
+				_mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i*)&name[start + length - 1]))));
+			while( mask ) {
+				bit = DB_NameScan_LowestBit(mask);
+				if( !memcmp(&name[start + bit], pattern, length) ) {
+					found = qtrue;
+					break;
+				}
+				mask &= mask - 1;
+			}
+		}
+		if( found ) {
+			visited++;
+			if( !visit(id, context) ) {
+				break;
+			}
+		}
+	}
+
+	return visited;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+void G_DB_NameScan_Init(void)
+{
+#if defined(DB_NAMESCAN_AVX2)
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("sse2") ) {
+		db_namescan_sanitize = DB_NameScan_SanitizeSSE2;
+		db_namescan_scan = DB_NameScan_ScanSSE2;
+	}
+	if( __builtin_cpu_supports("avx2") ) {
+		db_namescan_scan = DB_NameScan_ScanAVX2;
+	}
+#elif defined(DB_NAMESCAN_SSE2)
+	db_namescan_sanitize = DB_NameScan_SanitizeSSE2;
+	db_namescan_scan = DB_NameScan_ScanSSE2;
+#endif
+}
+
+void G_DB_NameScan_Sanitize(const char *name, char *out, uint32_t size)
+{
+	if( !size ) {
+		return;
+	}
+	db_namescan_sanitize(name, out, size);
+}
+
+int G_DB_NameColumn_Build(db_namecolumn_t *column, uint32_t count, db_namecolumn_text_f text, void *context)
+{
+	uint32_t id;
+
+	G_DB_NameColumn_Free(column);
+
+	column->names = (char*)calloc(count + SIL_DB_NAMECOLUMN_SLACK, SIL_DB_NAMECOLUMN_WIDTH);
+	if( !column->names ) {
+		return -1;
+	}
+	column->count = count;
+
+	for( id = 0; id < count ; id++ ) {
+		G_DB_NameColumn_Set(column, id, text(id, context));
+	}
+
+	return 0;
+}
+
+void G_DB_NameColumn_Free(db_namecolumn_t *column)
+{
+	free(column->names);
+	memset(column, 0, sizeof(db_namecolumn_t));
+}
+
+void G_DB_NameColumn_Set(db_namecolumn_t *column, uint32_t id, const char *name)
+{
+	char *slot;
+
+	if( !column->names || id >= column->count ) {
+		return;
+	}
+
+	slot = &column->names[id * SIL_DB_NAMECOLUMN_WIDTH];
+	// the rest of the slot must stay zero, the vector scans rely on it
+	memset(slot, 0, SIL_DB_NAMECOLUMN_WIDTH);
+	if( name ) {
+		Q_strncpyz(slot, name, SIL_DB_NAMECOLUMN_WIDTH);
+	}
+}
+
+int G_DB_NameColumn_Scan(const db_namecolumn_t *column, const char *pattern, db_namecolumn_visit_f visit, void *context)
+{
+	size_t length;
+
+	if( !column->names || !pattern[0] ) {
+		return -1;
+	}
+
+	length = strlen(pattern);
+	if( length >= SIL_DB_NAMECOLUMN_WIDTH ) {
+		// can't fit to any name
+		return 0;
+	}
+
+	return db_namescan_scan(column, pattern, (uint32_t)length, visit, context);
+}
+
+int G_DB_NameColumn_ScanFuzzy(const db_namecolumn_t *column, const db_fuzzy_t *fuzzy, db_namecolumn_visit_f visit, void *context)
+{
+	uint32_t id;
+	int visited = 0;
+
+	if( !column->names ) {
+		return -1;
+	}
+
+	for( id = 0; id < column->count ; id++ ) {
+		if( G_DB_Fuzzy_Matches(fuzzy, &column->names[id * SIL_DB_NAMECOLUMN_WIDTH]) ) {
+			visited++;
+			if( !visit(id, context) ) {
+				break;
+			}
+		}
+	}
+
+	return visited;
+}
@@ -0,0 +1,101 @@
+/*
+ *  Module contains the name column and the name kernels of the database modules.
+ *
+ *  The column keeps the sanitized names in fixed width zero padded slots, one cache line per name,
+ *  so the scans read the names from one continuous block instead of from the big records. The
+ *  substring scan checks the first and the last character of the pattern for 16 or 32 positions at
+ *  a time and compares the whole pattern only at the positions where both match.
+ *
+ *  The kernels are selected at runtime by the features of the CPU. The scalar kernels are used
+ *  when no vector kernel is available.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, Fuzzy scan of the name column, agent
+*/
+
+#ifndef __G_DB_NAMESCAN_H__
+#define __G_DB_NAMESCAN_H__
+
+#include "g_db_fuzzy.h"
+
+#define SIL_DB_NAMECOLUMN_WIDTH		64
+// the slots after the last name, the vector loads of the last name may reach them
+#define SIL_DB_NAMECOLUMN_SLACK		2
+
+typedef struct db_namecolumn_s {
+	char		*names;		// SIL_DB_NAMECOLUMN_WIDTH bytes per id, NULL if the column is not built
+	uint32_t	count;
+} db_namecolumn_t;
+
+// returns the name of the id, NULL is stored as empty name
+typedef const char* (*db_namecolumn_text_f)(uint32_t id, void *context);
+// called for the matching ids in ascending order, return qfalse to stop the scan
+typedef qboolean (*db_namecolumn_visit_f)(uint32_t id, void *context);
+
+/**
+ * Function selects the kernels for the CPU. Called once when the database is initialized,
+ * the scalar kernels are used before that.
+ */
+void G_DB_NameScan_Init(void);
+
+/**
+ * Function removes the color codes and changes the characters to lower case. This is the
+ * reentrant version of G_DB_SanitizeName.
+ *
+ * @param name The name or the pattern to sanitize.
+ * @param out The sanitized output.
+ * @param size The size of the output, at most size - 1 characters of the name are handled.
+ */
+void G_DB_NameScan_Sanitize(const char *name, char *out, uint32_t size);
+
+/**
+ * Function builds the column for the ids from 0 to count - 1.
+ *
+ * @param column The column to build. Old content is freed.
+ * @param count The amount of the ids.
+ * @param text Function returning the name of an id.
+ * @param context Passed to the text function.
+ * @return 0 on success, -1 if out of memory. The column is left unbuilt on failure.
+ */
+int G_DB_NameColumn_Build(db_namecolumn_t *column, uint32_t count, db_namecolumn_text_f text, void *context);
+
+/**
+ * Function releases the memory of the column and leaves it unbuilt.
+ *
+ * @param column The column to free.
+ */
+void G_DB_NameColumn_Free(db_namecolumn_t *column);
+
+/**
+ * Function replaces the name of the id in the built column.
+ *
+ * @param column The column to update.
+ * @param id The id, must be less than the count of the column.
+ * @param name The new name, the characters that don't fit are dropped.
+ */
+void G_DB_NameColumn_Set(db_namecolumn_t *column, uint32_t id, const char *name);
+
+/**
+ * Function visits the ids of the names containing the pattern.
+ *
+ * @param column The column to scan.
+ * @param pattern The searched substring, not empty.
+ * @param visit Function called for the matching ids.
+ * @param context Passed to the visit function.
+ * @return The amount of the visited ids or -1 if the column is not built.
+ */
+int G_DB_NameColumn_Scan(const db_namecolumn_t *column, const char *pattern, db_namecolumn_visit_f visit, void *context);
+
+/**
+ * Function visits the ids of the names matching the fuzzy pattern.
+ *
+ * @param column The column to scan.
+ * @param fuzzy The compiled pattern.
+ * @param visit Function called for the matching ids.
+ * @param context Passed to the visit function.
+ * @return The amount of the visited ids or -1 if the column is not built.
+ */
+int G_DB_NameColumn_ScanFuzzy(const db_namecolumn_t *column, const db_fuzzy_t *fuzzy, db_namecolumn_visit_f visit, void *context);
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ *  Module contains an ordered skip list for the leaderboards of the database modules.
+ *
+ *  A node is promoted to the next level with the probability of a quarter. The span of the last
+ *  link of a level counts to the end of the list, so the spans along any path down the levels sum
+ *  up to the rank of the node the path stops at.
+ */
+
+#include "g_local.h"
+#include "g_db_skiplist.h"
+
+#define DB_SKIPLIST_NODESIZE(levels) (sizeof(db_skiplist_node_t) + sizeof(db_skiplist_link_t) * ((levels) - 1))
+
+// true if the node a comes before the node with the score and the id
+static qboolean DB_SkipList_Before(const db_skiplist_node_t *a, float score, uint32_t id)
+{
+	if( a->score != score ) {
+		return a->score > score ? qtrue : qfalse;
+	}
+	return a->id < id ? qtrue : qfalse;
+}
+
+static uint32_t DB_SkipList_RandomLevel(db_skiplist_t *list)
+{
+	uint32_t levels = 1;
+	uint32_t x = list->seed ? list->seed : 2463534242u;
+
+	// xorshift, the quality needed for the levels is low
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	list->seed = x;
+
+	while( levels < SIL_DB_SKIPLIST_MAXLEVEL && !(x & 3) ) {
+		levels++;
+		x >>= 2;
+	}
+
+	return levels;
+}
+
+static int DB_SkipList_Grow(db_skiplist_t *list, uint32_t id)
+{
+	uint32_t size = list->size ? list->size : 64;
+	db_skiplist_node_t **memory;
+
+	while( size <= id ) {
+		size *= 2;
+	}
+
+	memory = (db_skiplist_node_t**)realloc(list->nodes, sizeof(db_skiplist_node_t*) * size);
+	if( !memory ) {
+		return -1;
+	}
+	memset(&memory[list->size], 0, sizeof(db_skiplist_node_t*) * (size - list->size));
+	list->nodes = memory;
+	list->size = size;
+
+	return 0;
+}
+
+// finds the last node before the node on every level, the ranks of them are set if asked
+static void DB_SkipList_Find(const db_skiplist_t *list, float score, uint32_t id, db_skiplist_node_t **update, uint32_t *ranks)
+{
+	db_skiplist_node_t *x = list->head;
+	uint32_t rank = 0;
+	int i;
+
+	for( i = (int)list->levels - 1; i >= 0 ; i-- ) {
+		while( x->links[i].next && DB_SkipList_Before(x->links[i].next, score, id) ) {
+			rank += x->links[i].span;
+			x = x->links[i].next;
+		}
+		update[i] = x;
+		if( ranks ) {
+			ranks[i] = rank;
+		}
+	}
+}
+
+static void DB_SkipList_Link(db_skiplist_t *list, db_skiplist_node_t *node)
+{
+	db_skiplist_node_t *update[SIL_DB_SKIPLIST_MAXLEVEL];
+	uint32_t ranks[SIL_DB_SKIPLIST_MAXLEVEL];
+	uint32_t i;
+
+	DB_SkipList_Find(list, node->score, node->id, update, ranks);
+
+	for( i = list->levels; i < node->levels ; i++ ) {
+		update[i] = list->head;
+		ranks[i] = 0;
+		list->head->links[i].next = NULL;
+		list->head->links[i].span = list->count;
+	}
+	if( node->levels > list->levels ) {
+		list->levels = node->levels;
+	}
+
+	for( i = 0; i < node->levels ; i++ ) {
+		node->links[i].next = update[i]->links[i].next;
+		node->links[i].span = update[i]->links[i].span - (ranks[0] - ranks[i]);
+		update[i]->links[i].next = node;
+		update[i]->links[i].span = ranks[0] - ranks[i] + 1;
+	}
+	for( ; i < list->levels ; i++ ) {
+		update[i]->links[i].span++;
+	}
+
+	list->count++;
+}
+
+static void DB_SkipList_Unlink(db_skiplist_t *list, db_skiplist_node_t *node)
+{
+	db_skiplist_node_t *update[SIL_DB_SKIPLIST_MAXLEVEL];
+	uint32_t i;
+
+	DB_SkipList_Find(list, node->score, node->id, update, NULL);
+
+	for( i = 0; i < list->levels ; i++ ) {
+		if( update[i]->links[i].next == node ) {
+			update[i]->links[i].span += node->links[i].span - 1;
+			update[i]->links[i].next = node->links[i].next;
+		} else {
+			update[i]->links[i].span--;
+		}
+	}
+	while( list->levels > 1 && !list->head->links[list->levels - 1].next ) {
+		list->levels--;
+	}
+
+	list->count--;
+}
+
+void G_DB_SkipList_Free(db_skiplist_t *list)
+{
+	db_skiplist_node_t *node;
+	db_skiplist_node_t *next;
+
+	if( list->head ) {
+		for( node = list->head->links[0].next; node ; node = next ) {
+			next = node->links[0].next;
+			free(node);
+		}
+		free(list->head);
+	}
+	free(list->nodes);
+	memset(list, 0, sizeof(db_skiplist_t));
+}
+
+int G_DB_SkipList_Set(db_skiplist_t *list, uint32_t id, float score)
+{
+	db_skiplist_node_t *node;
+	uint32_t levels;
+
+	if( score != score ) {
+		score = 0.0f;
+	}
+
+	if( !list->head ) {
+		list->head = (db_skiplist_node_t*)calloc(1, DB_SKIPLIST_NODESIZE(SIL_DB_SKIPLIST_MAXLEVEL));
+		if( !list->head ) {
+			return -1;
+		}
+		list->head->levels = SIL_DB_SKIPLIST_MAXLEVEL;
+		list->levels = 1;
+	}
+	if( id >= list->size && DB_SkipList_Grow(list, id) == -1 ) {
+		return -1;
+	}
+
+	node = list->nodes[id];
+	if( node ) {
+		if( node->score == score ) {
+			return 0;
+		}
+		// the node is moved, its levels are kept
+		DB_SkipList_Unlink(list, node);
+	} else {
+		levels = DB_SkipList_RandomLevel(list);
+		node = (db_skiplist_node_t*)malloc(DB_SKIPLIST_NODESIZE(levels));
+		if( !node ) {
+			return -1;
+		}
+		node->id = id;
+		node->levels = levels;
+		list->nodes[id] = node;
+	}
+
+	node->score = score;
+	DB_SkipList_Link(list, node);
+
+	return 0;
+}
+
+void G_DB_SkipList_Remove(db_skiplist_t *list, uint32_t id)
+{
+	db_skiplist_node_t *node;
+
+	if( id >= list->size || !list->nodes[id] ) {
+		return;
+	}
+
+	node = list->nodes[id];
+	DB_SkipList_Unlink(list, node);
+	list->nodes[id] = NULL;
+	free(node);
+}
+
+uint32_t G_DB_SkipList_Rank(const db_skiplist_t *list, uint32_t id)
+{
+	const db_skiplist_node_t *node;
+	const db_skiplist_node_t *x;
+	uint32_t rank = 0;
+	int i;
+
+	if( id >= list->size || !list->nodes[id] ) {
+		return 0;
+	}
+
+	node = list->nodes[id];
+	x = list->head;
+	for( i = (int)list->levels - 1; i >= 0 ; i-- ) {
+		while( x->links[i].next && (x->links[i].next == node || DB_SkipList_Before(x->links[i].next, node->score, node->id)) ) {
+			rank += x->links[i].span;
+			x = x->links[i].next;
+		}
+		if( x == node ) {
+			return rank;
+		}
+	}
+
+	return 0;
+}
+
+uint32_t G_DB_SkipList_Range(const db_skiplist_t *list, uint32_t rank, uint32_t *ids, float *scores, uint32_t count)
+{
+	const db_skiplist_node_t *x;
+	uint32_t traversed = 0;
+	uint32_t copied = 0;
+	int i;
+
+	if( !list->head || !rank || rank > list->count ) {
+		return 0;
+	}
+
+	x = list->head;
+	for( i = (int)list->levels - 1; i >= 0 && traversed < rank ; i-- ) {
+		while( x->links[i].next && traversed + x->links[i].span <= rank ) {
+			traversed += x->links[i].span;
+			x = x->links[i].next;
+		}
+	}
+
+	for( ; x && copied < count ; x = x->links[0].next ) {
+		ids[copied] = x->id;
+		if( scores ) {
+			scores[copied] = x->score;
+		}
+		copied++;
+	}
+
+	return copied;
+}
+
+qboolean G_DB_SkipList_Walk(const db_skiplist_t *list, db_skiplist_visit_f visit, void *context)
+{
+	const db_skiplist_node_t *x;
+
+	if( !list->head ) {
+		return qtrue;
+	}
+
+	for( x = list->head->links[0].next; x ; x = x->links[0].next ) {
+		if( !visit(x->id, x->score, context) ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
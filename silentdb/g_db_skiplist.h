@@ -0,0 +1,102 @@
+/*
+ *  Module contains an ordered skip list for the leaderboards of the database modules.
+ *
+ *  The ids are kept in the descending order of their score, the equal scores in the ascending order
+ *  of the id. Every link of the list knows how many ids it skips, so the rank of an id and the id at
+ *  a rank are found by walking down the levels in logarithmic time, like the insertions and the
+ *  removals. The nodes are found by the id directly, so a changed score is moved without a search
+ *  by the old score.
+ *
+ *  The ids are the user cache positions, the buffered users are numbered after the cache.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, Walk in the rank order for the ranked searches, agent
+*/
+
+#ifndef __G_DB_SKIPLIST_H__
+#define __G_DB_SKIPLIST_H__
+
+#define SIL_DB_SKIPLIST_MAXLEVEL	16	// enough for 4^16 ids with the quarter promotion
+
+typedef struct db_skiplist_link_s {
+	struct db_skiplist_node_s	*next;
+	uint32_t					span;	// the amount of ids the link moves forward
+} db_skiplist_link_t;
+
+typedef struct db_skiplist_node_s {
+	float				score;
+	uint32_t			id;
+	uint32_t			levels;
+	db_skiplist_link_t	links[1];	// allocated for all the levels of the node
+} db_skiplist_node_t;
+
+typedef struct db_skiplist_s {
+	db_skiplist_node_t	*head;		// NULL until the first id is added
+	db_skiplist_node_t	**nodes;	// by id, NULL if the id is not in the list
+	uint32_t			size;		// allocated ids
+	uint32_t			count;		// the ids in the list
+	uint32_t			levels;		// the levels in use
+	uint32_t			seed;		// the state of the level generator
+} db_skiplist_t;
+
+// called for the ids in the rank order, return qfalse to stop the walk
+typedef qboolean (*db_skiplist_visit_f)(uint32_t id, float score, void *context);
+
+/**
+ * Function releases all the memory of the list and leaves it empty.
+ *
+ * @param list The list to free.
+ */
+void G_DB_SkipList_Free(db_skiplist_t *list);
+
+/**
+ * Function sets the score of the id. A new id is added, an old id is moved if the score changed.
+ *
+ * @param list The list to update.
+ * @param id The id.
+ * @param score The score, NaN is stored as zero.
+ * @return 0 on success, -1 if out of memory. The id is not in the list on failure.
+ */
+int G_DB_SkipList_Set(db_skiplist_t *list, uint32_t id, float score);
+
+/**
+ * Function removes the id from the list. Nothing is done if the id is not in the list.
+ *
+ * @param list The list to update.
+ * @param id The id.
+ */
+void G_DB_SkipList_Remove(db_skiplist_t *list, uint32_t id);
+
+/**
+ * Function returns the rank of the id, the id with the highest score has the rank 1.
+ *
+ * @param list The list to search.
+ * @param id The id.
+ * @return The rank or 0 if the id is not in the list.
+ */
+uint32_t G_DB_SkipList_Rank(const db_skiplist_t *list, uint32_t id);
+
+/**
+ * Function copies the ids from the rank onwards in the rank order.
+ *
+ * @param list The list to read.
+ * @param rank The rank of the first copied id, starting from 1.
+ * @param ids The copied ids.
+ * @param scores Optional, the scores of the copied ids.
+ * @param count The size of the output arrays.
+ * @return The amount of the copied ids, less than count at the end of the list.
+ */
+uint32_t G_DB_SkipList_Range(const db_skiplist_t *list, uint32_t rank, uint32_t *ids, float *scores, uint32_t count);
+
+/**
+ * Function walks the ids from the highest score down. The list must not be changed by the visit.
+ *
+ * @param list The list to walk.
+ * @param visit Function called for every id until it returns qfalse.
+ * @param context Passed to the visit function.
+ * @return qfalse if the visit stopped the walk.
+ */
+qboolean G_DB_SkipList_Walk(const db_skiplist_t *list, db_skiplist_visit_f visit, void *context);
+
+#endif
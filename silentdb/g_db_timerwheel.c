@@ -0,0 +1,193 @@
+/*
+ *  Module contains a hierarchical timer wheel for the timed expiries of the database modules.
+ *
+ *  The slot of an expiry on a level is the expiry shifted by the level, masked to the slot count.
+ *  An id is placed on the lowest level where its shifted expiry is less than a full turn ahead of
+ *  the shifted time of the wheel, so the ids of one slot never wrap around to a later turn. The
+ *  lists are doubly linked through the per id arrays, so an id is moved or removed in constant time.
+ */
+
+#include "g_local.h"
+#include "g_db_timerwheel.h"
+
+#define DB_TIMERWHEEL_FAR	(SIL_DB_TIMERWHEEL_LISTS - 1)
+
+static uint32_t DB_TimerWheel_List(const db_timerwheel_t *wheel, uint32_t expires)
+{
+	uint32_t shift;
+	uint32_t level;
+
+	// the late ones go to the current slot, they are handed out by the next advance
+	if( expires < wheel->now ) {
+		expires = wheel->now;
+	}
+
+	for( level = 0; level < SIL_DB_TIMERWHEEL_LEVELS ; level++ ) {
+		shift = level * SIL_DB_TIMERWHEEL_BITS;
+		if( (expires >> shift) - (wheel->now >> shift) < SIL_DB_TIMERWHEEL_SLOTS ) {
+			return level * SIL_DB_TIMERWHEEL_SLOTS + ((expires >> shift) & (SIL_DB_TIMERWHEEL_SLOTS - 1));
+		}
+	}
+
+	return DB_TIMERWHEEL_FAR;
+}
+
+static void DB_TimerWheel_Link(db_timerwheel_t *wheel, uint32_t id, uint32_t list)
+{
+	wheel->prev[id] = 0;
+	wheel->next[id] = wheel->heads[list];
+	if( wheel->heads[list] ) {
+		wheel->prev[wheel->heads[list] - 1] = id + 1;
+	}
+	wheel->heads[list] = id + 1;
+	wheel->list[id] = list + 1;
+}
+
+static void DB_TimerWheel_Unlink(db_timerwheel_t *wheel, uint32_t id)
+{
+	if( wheel->prev[id] ) {
+		wheel->next[wheel->prev[id] - 1] = wheel->next[id];
+	} else {
+		wheel->heads[wheel->list[id] - 1] = wheel->next[id];
+	}
+	if( wheel->next[id] ) {
+		wheel->prev[wheel->next[id] - 1] = wheel->prev[id];
+	}
+	wheel->list[id] = 0;
+}
+
+static int DB_TimerWheel_Grow(db_timerwheel_t *wheel, uint32_t id)
+{
+	uint32_t size = wheel->size ? wheel->size : 64;
+	void *memory;
+
+	while( size <= id ) {
+		size *= 2;
+	}
+
+	memory = realloc(wheel->expires, sizeof(uint32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	wheel->expires = (uint32_t*)memory;
+	memory = realloc(wheel->next, sizeof(uint32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	wheel->next = (uint32_t*)memory;
+	memory = realloc(wheel->prev, sizeof(uint32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	wheel->prev = (uint32_t*)memory;
+	memory = realloc(wheel->list, sizeof(uint32_t) * size);
+	if( !memory ) {
+		return -1;
+	}
+	wheel->list = (uint32_t*)memory;
+
+	memset(&wheel->list[wheel->size], 0, sizeof(uint32_t) * (size - wheel->size));
+	wheel->size = size;
+
+	return 0;
+}
+
+// detaches the list and hands out its expired ids, the others are placed again by the current time
+static int DB_TimerWheel_Drain(db_timerwheel_t *wheel, uint32_t list, db_timerwheel_expire_f expire, void *context)
+{
+	uint32_t head = wheel->heads[list];
+	uint32_t id;
+	int expired = 0;
+
+	wheel->heads[list] = 0;
+
+	while( head ) {
+		id = head - 1;
+		head = wheel->next[id];
+		wheel->list[id] = 0;
+		if( wheel->expires[id] < wheel->now ) {
+			expired++;
+			expire(id, context);
+		} else {
+			DB_TimerWheel_Link(wheel, id, DB_TimerWheel_List(wheel, wheel->expires[id]));
+		}
+	}
+
+	return expired;
+}
+
+void G_DB_TimerWheel_Init(db_timerwheel_t *wheel, uint32_t now)
+{
+	G_DB_TimerWheel_Free(wheel);
+	wheel->now = now;
+}
+
+void G_DB_TimerWheel_Free(db_timerwheel_t *wheel)
+{
+	free(wheel->expires);
+	free(wheel->next);
+	free(wheel->prev);
+	free(wheel->list);
+	memset(wheel, 0, sizeof(db_timerwheel_t));
+}
+
+int G_DB_TimerWheel_Set(db_timerwheel_t *wheel, uint32_t id, uint32_t expires)
+{
+	if( id >= wheel->size && DB_TimerWheel_Grow(wheel, id) == -1 ) {
+		return -1;
+	}
+
+	if( wheel->list[id] ) {
+		DB_TimerWheel_Unlink(wheel, id);
+	}
+	wheel->expires[id] = expires;
+	DB_TimerWheel_Link(wheel, id, DB_TimerWheel_List(wheel, expires));
+
+	return 0;
+}
+
+void G_DB_TimerWheel_Remove(db_timerwheel_t *wheel, uint32_t id)
+{
+	if( id < wheel->size && wheel->list[id] ) {
+		DB_TimerWheel_Unlink(wheel, id);
+	}
+}
+
+int G_DB_TimerWheel_Advance(db_timerwheel_t *wheel, uint32_t now, db_timerwheel_expire_f expire, void *context)
+{
+	uint32_t old = wheel->now;
+	uint32_t shift;
+	uint32_t level;
+	uint32_t block, last;
+	uint32_t list;
+	int expired = 0;
+
+	if( now < old ) {
+		now = old;
+	}
+	wheel->now = now;
+
+	// the slots of the passed time on every level, at most one turn per level. The current slot
+	// is drained also when the time does not move, it holds the ids scheduled late.
+	for( level = 0; level < SIL_DB_TIMERWHEEL_LEVELS ; level++ ) {
+		shift = level * SIL_DB_TIMERWHEEL_BITS;
+		last = (now > old ? now - 1 : now) >> shift;
+		if( last - (old >> shift) >= SIL_DB_TIMERWHEEL_SLOTS ) {
+			last = (old >> shift) + SIL_DB_TIMERWHEEL_SLOTS - 1;
+		}
+		for( block = old >> shift; block <= last ; block++ ) {
+			list = level * SIL_DB_TIMERWHEEL_SLOTS + (block & (SIL_DB_TIMERWHEEL_SLOTS - 1));
+			if( wheel->heads[list] ) {
+				expired += DB_TimerWheel_Drain(wheel, list, expire, context);
+			}
+		}
+	}
+
+	// the far ones may reach the last level now
+	shift = (SIL_DB_TIMERWHEEL_LEVELS - 1) * SIL_DB_TIMERWHEEL_BITS;
+	if( wheel->heads[DB_TIMERWHEEL_FAR] && (now >> shift) != (old >> shift) ) {
+		expired += DB_TimerWheel_Drain(wheel, DB_TIMERWHEEL_FAR, expire, context);
+	}
+
+	return expired;
+}
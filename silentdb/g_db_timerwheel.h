@@ -0,0 +1,85 @@
+/*
+ *  Module contains a hierarchical timer wheel for the timed expiries of the database modules.
+ *
+ *  Every level of the wheel has 64 slots. A slot of the first level holds the ids expiring within
+ *  one second, a slot of the next level the ids expiring within 64 seconds and so on. An id is kept
+ *  on the lowest level whose slots still reach its expiry, the ids too far even for the last level
+ *  are kept in a separate list. Advancing the wheel drains only the slots the time has passed and
+ *  moves the not yet expired ids of them to the lower levels, so the cost follows the amount of the
+ *  expirations and not the amount of the scheduled ids.
+ *
+ *  The ids are the user extras cache positions, the expiry time is the end of the mute.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_TIMERWHEEL_H__
+#define __G_DB_TIMERWHEEL_H__
+
+#define SIL_DB_TIMERWHEEL_BITS		6
+#define SIL_DB_TIMERWHEEL_SLOTS		(1 << SIL_DB_TIMERWHEEL_BITS)
+#define SIL_DB_TIMERWHEEL_LEVELS	4
+// the slots of all the levels and the list of the ids too far for the wheel
+#define SIL_DB_TIMERWHEEL_LISTS		(SIL_DB_TIMERWHEEL_LEVELS * SIL_DB_TIMERWHEEL_SLOTS + 1)
+
+typedef struct db_timerwheel_s {
+	uint32_t	*expires;	// by id
+	uint32_t	*next;		// by id, the next id of the list + 1, 0 ends the list
+	uint32_t	*prev;		// by id, the previous id of the list + 1, 0 for the first id
+	uint32_t	*list;		// by id, the list of the id + 1, 0 if the id is not scheduled
+	uint32_t	size;		// allocated ids
+	uint32_t	heads[SIL_DB_TIMERWHEEL_LISTS];	// the first id of the list + 1, 0 if empty
+	uint32_t	now;		// the ids expiring before this have been handed out
+} db_timerwheel_t;
+
+// called for the expired ids, the id is already unscheduled and may be scheduled again
+typedef void (*db_timerwheel_expire_f)(uint32_t id, void *context);
+
+/**
+ * Function empties the wheel and sets its time.
+ *
+ * @param wheel The wheel to initialize. Old content is freed.
+ * @param now The current time.
+ */
+void G_DB_TimerWheel_Init(db_timerwheel_t *wheel, uint32_t now);
+
+/**
+ * Function releases all the memory of the wheel and leaves it empty.
+ *
+ * @param wheel The wheel to free.
+ */
+void G_DB_TimerWheel_Free(db_timerwheel_t *wheel);
+
+/**
+ * Function schedules the expiry of the id, an earlier expiry of the id is replaced. An expiry
+ * before the time of the wheel is handed out by the next advance.
+ *
+ * @param wheel The wheel to update.
+ * @param id The id.
+ * @param expires The expiry time.
+ * @return 0 on success, -1 if out of memory
+ */
+int G_DB_TimerWheel_Set(db_timerwheel_t *wheel, uint32_t id, uint32_t expires);
+
+/**
+ * Function unschedules the id. Nothing is done if the id is not scheduled.
+ *
+ * @param wheel The wheel to update.
+ * @param id The id.
+ */
+void G_DB_TimerWheel_Remove(db_timerwheel_t *wheel, uint32_t id);
+
+/**
+ * Function moves the time of the wheel forward and hands out the ids expiring before the new
+ * time. The wheel is never moved backwards, an earlier time only hands out the late ids.
+ *
+ * @param wheel The wheel to advance.
+ * @param now The new time.
+ * @param expire Function called for the expired ids, in no particular order.
+ * @param context Passed to the expire function.
+ * @return The amount of the expired ids.
+ */
+int G_DB_TimerWheel_Advance(db_timerwheel_t *wheel, uint32_t now, db_timerwheel_expire_f expire, void *context);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ *  Module contains the bounded top-K collection of the ranked searches of the database modules.
+ *
+ *  The heap keeps the worst kept entry at the top, a better entry replaces it once the collection
+ *  is full. The entries are sorted by taking the heap apart from the top, the worst ones go to the
+ *  end.
+ */
+
+#include "g_local.h"
+#include "g_db_topk.h"
+
+// true if the entry a ranks below the entry b
+static qboolean DB_TopK_Worse(const db_topk_entry_t *a, const db_topk_entry_t *b)
+{
+	if( a->score != b->score ) {
+		return a->score < b->score ? qtrue : qfalse;
+	}
+	return a->id > b->id ? qtrue : qfalse;
+}
+
+static void DB_TopK_SiftDown(db_topk_entry_t *entries, uint32_t count, uint32_t i)
+{
+	db_topk_entry_t entry = entries[i];
+	uint32_t child;
+
+	while( (child = i * 2 + 1) < count ) {
+		if( child + 1 < count && DB_TopK_Worse(&entries[child + 1], &entries[child]) ) {
+			child++;
+		}
+		if( !DB_TopK_Worse(&entries[child], &entry) ) {
+			break;
+		}
+		entries[i] = entries[child];
+		i = child;
+	}
+	entries[i] = entry;
+}
+
+void G_DB_TopK_Begin(db_topk_t *topk, uint32_t size)
+{
+	topk->count = 0;
+	topk->size = size < SIL_DB_MAXTOPK ? size : SIL_DB_MAXTOPK;
+}
+
+qboolean G_DB_TopK_Offer(db_topk_t *topk, uint32_t id, double score)
+{
+	db_topk_entry_t entry;
+	uint32_t i;
+
+	entry.score = score;
+	entry.id = id;
+
+	if( topk->count == topk->size ) {
+		if( !topk->size || !DB_TopK_Worse(&topk->entries[0], &entry) ) {
+			return qfalse;
+		}
+		topk->entries[0] = entry;
+		DB_TopK_SiftDown(topk->entries, topk->count, 0);
+		return qtrue;
+	}
+
+	// sift up
+	for( i = topk->count++; i > 0 && DB_TopK_Worse(&entry, &topk->entries[(i - 1) / 2]) ; i = (i - 1) / 2 ) {
+		topk->entries[i] = topk->entries[(i - 1) / 2];
+	}
+	topk->entries[i] = entry;
+
+	return qtrue;
+}
+
+qboolean G_DB_TopK_Lowest(const db_topk_t *topk, double *score)
+{
+	if( !topk->count || topk->count < topk->size ) {
+		return qfalse;
+	}
+
+	*score = topk->entries[0].score;
+
+	return qtrue;
+}
+
+uint32_t G_DB_TopK_End(db_topk_t *topk)
+{
+	db_topk_entry_t entry;
+	uint32_t i;
+
+	for( i = topk->count; i > 1 ; i-- ) {
+		entry = topk->entries[0];
+		topk->entries[0] = topk->entries[i - 1];
+		topk->entries[i - 1] = entry;
+		DB_TopK_SiftDown(topk->entries, i - 1, 0);
+	}
+
+	return topk->count;
+}
@@ -0,0 +1,68 @@
+/*
+ *  Module contains the bounded top-K collection of the ranked searches of the database modules.
+ *
+ *  The collection keeps the K ids with the highest scores of the offered ones, the equal scores in
+ *  the ascending order of the id like the leaderboards. The kept ids are in a heap with the lowest
+ *  of them at the top, so an offer is rejected or takes its place in logarithmic time and the memory
+ *  follows K and not the amount of the offered ids. Once the collection is full, the lowest kept
+ *  score tells the caller walking the ids in the score order when no further id can enter.
+ *
+ *  The ids are the user cache positions, the scores are the ranking keys of the searched users.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+*/
+
+#ifndef __G_DB_TOPK_H__
+#define __G_DB_TOPK_H__
+
+#define SIL_DB_MAXTOPK	64
+
+typedef struct db_topk_entry_s {
+	double		score;		// double holds all the 32 bit keys exactly
+	uint32_t	id;
+} db_topk_entry_t;
+
+typedef struct db_topk_s {
+	db_topk_entry_t	entries[SIL_DB_MAXTOPK];	// a heap while collecting, sorted after
+	uint32_t		count;
+	uint32_t		size;		// K, at most SIL_DB_MAXTOPK
+} db_topk_t;
+
+/**
+ * Function starts the collection.
+ *
+ * @param topk The collection to start.
+ * @param size The amount of the kept ids, limited to SIL_DB_MAXTOPK.
+ */
+void G_DB_TopK_Begin(db_topk_t *topk, uint32_t size);
+
+/**
+ * Function offers an id to the collection.
+ *
+ * @param topk The collection.
+ * @param id The id, offered only once.
+ * @param score The score of the id.
+ * @return qtrue if the id was kept, it may still be pushed out by the later offers.
+ */
+qboolean G_DB_TopK_Offer(db_topk_t *topk, uint32_t id, double score);
+
+/**
+ * Function gets the lowest kept score of the full collection. No id with a lower score can enter
+ * the collection anymore, an id with the equal score only if it is smaller than the kept one.
+ *
+ * @param topk The collection.
+ * @param score Set to the lowest kept score.
+ * @return qfalse if the collection is not full yet, every offer is kept then.
+ */
+qboolean G_DB_TopK_Lowest(const db_topk_t *topk, double *score);
+
+/**
+ * Function ends the collection, the entries are sorted the highest score first.
+ *
+ * @param topk The collection.
+ * @return The amount of the kept ids.
+ */
+uint32_t G_DB_TopK_End(db_topk_t *topk);
+
+#endif
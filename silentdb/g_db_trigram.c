@@ -0,0 +1,406 @@
+/*
+ *  Module contains a trigram index for the substring searches of the database modules.
+ *
+ *  The bucket lists created by the build are laid out to one memory block. A list is moved to its
+ *  own allocation only when an added text does not fit to it anymore. The candidates are produced by
+ *  walking the shortest list and seeking the others forward, all the lists are sorted so the seeks
+ *  never go backwards.
+ */
+
+#include "g_local.h"
+#include "g_db_trigram.h"
+#include "g_db_fuzzy.h"
+
+#define DB_TRIGRAM_BUCKETBITS	14
+#define DB_TRIGRAM_BUCKETS		(1 << DB_TRIGRAM_BUCKETBITS)
+#define DB_TRIGRAM_MAXKEYS		(SIL_DB_TRIGRAM_MAXTEXT - 2)
+#define DB_TRIGRAM_MINLIST		4
+
+// fibonacci hashing of the three characters
+#define DB_TRIGRAM_BUCKET(t) (((uint32_t)(uint8_t)(t)[0] | ((uint32_t)(uint8_t)(t)[1] << 8) | ((uint32_t)(uint8_t)(t)[2] << 16)) * 2654435769u >> (32 - DB_TRIGRAM_BUCKETBITS))
+
+// returns the sorted and unique buckets of the text, a text is stored once to a bucket. The
+// characters are folded with the homoglyph table, so the look-alike sequences share the buckets
+// and the fuzzy searches can use the index.
+static uint32_t DB_Trigram_Keys(const char *text, uint32_t *keys)
+{
+	char folded[SIL_DB_TRIGRAM_MAXTEXT];
+	uint32_t count = 0;
+	uint32_t length;
+	uint32_t key;
+	uint32_t i, j;
+
+	if( !text ) {
+		return 0;
+	}
+
+	for( length = 0; length < SIL_DB_TRIGRAM_MAXTEXT && text[length] ; length++ ) {
+		folded[length] = G_DB_Fuzzy_Fold(text[length]);
+	}
+
+	for( i = 0; i + 2 < length ; i++ ) {
+		key = DB_TRIGRAM_BUCKET(&folded[i]);
+		for( j = count; j > 0 && keys[j-1] > key ; j-- ) {
+		}
+		if( j > 0 && keys[j-1] == key ) {
+			continue;
+		}
+		memmove(&keys[j+1], &keys[j], sizeof(uint32_t) * (count - j));
+		keys[j] = key;
+		count++;
+	}
+
+	return count;
+}
+
+// returns the position of the first id not smaller than the searched one, starting from the given position
+static uint32_t DB_Trigram_Seek(const db_trigram_bucket_t *bucket, uint32_t from, uint32_t id)
+{
+	uint32_t low = from;
+	uint32_t high;
+	uint32_t mid;
+	uint32_t step = 1;
+
+	// gallop over the smaller ids, the seeks are mostly short
+	while( low + step < bucket->count && bucket->ids[low + step] < id ) {
+		low += step;
+		step <<= 1;
+	}
+	high = (low + step < bucket->count) ? low + step : bucket->count;
+
+	while( low < high ) {
+		mid = low + (high - low) / 2;
+		if( bucket->ids[mid] < id ) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static qboolean DB_Trigram_InBlock(const db_trigram_t *index, const uint32_t *ids)
+{
+	return (ids >= index->block && ids < index->block + index->blocksize) ? qtrue : qfalse;
+}
+
+int G_DB_Trigram_Build(db_trigram_t *index, uint32_t count, db_trigram_text_f text, void *context)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	uint32_t total = 0;
+	uint32_t i, k, n;
+
+	G_DB_Trigram_Free(index);
+
+	index->buckets = (db_trigram_bucket_t*)calloc(DB_TRIGRAM_BUCKETS, sizeof(db_trigram_bucket_t));
+	if( !index->buckets ) {
+		return -1;
+	}
+
+	// the first pass counts the list sizes
+	for( i = 0; i < count ; i++ ) {
+		n = DB_Trigram_Keys(text(i, context), keys);
+		for( k = 0; k < n ; k++ ) {
+			index->buckets[keys[k]].size++;
+		}
+		total += n;
+	}
+
+	index->block = (uint32_t*)malloc(sizeof(uint32_t) * (total ? total : 1));
+	if( !index->block ) {
+		free(index->buckets);
+		memset(index, 0, sizeof(db_trigram_t));
+		return -1;
+	}
+	index->blocksize = total;
+
+	total = 0;
+	for( i = 0; i < DB_TRIGRAM_BUCKETS ; i++ ) {
+		if( index->buckets[i].size ) {
+			index->buckets[i].ids = &index->block[total];
+			total += index->buckets[i].size;
+		}
+	}
+
+	// the second pass fills the lists, the ids come in ascending order so the lists are sorted
+	for( i = 0; i < count ; i++ ) {
+		n = DB_Trigram_Keys(text(i, context), keys);
+		for( k = 0; k < n ; k++ ) {
+			db_trigram_bucket_t *bucket = &index->buckets[keys[k]];
+			bucket->ids[bucket->count++] = i;
+		}
+	}
+
+	return 0;
+}
+
+void G_DB_Trigram_Free(db_trigram_t *index)
+{
+	uint32_t i;
+
+	if( index->buckets ) {
+		for( i = 0; i < DB_TRIGRAM_BUCKETS ; i++ ) {
+			if( index->buckets[i].ids && !DB_Trigram_InBlock(index, index->buckets[i].ids) ) {
+				free(index->buckets[i].ids);
+			}
+		}
+		free(index->buckets);
+	}
+	free(index->block);
+	memset(index, 0, sizeof(db_trigram_t));
+}
+
+int G_DB_Trigram_Add(db_trigram_t *index, uint32_t id, const char *text)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	db_trigram_bucket_t *bucket;
+	uint32_t *ids;
+	uint32_t pos;
+	uint32_t size;
+	uint32_t k, n;
+
+	if( !index->buckets ) {
+		return -1;
+	}
+
+	n = DB_Trigram_Keys(text, keys);
+	for( k = 0; k < n ; k++ ) {
+		bucket = &index->buckets[keys[k]];
+		pos = DB_Trigram_Seek(bucket, 0, id);
+		if( pos < bucket->count && bucket->ids[pos] == id ) {
+			continue;
+		}
+
+		if( bucket->count == bucket->size ) {
+			size = bucket->size ? bucket->size * 2 : DB_TRIGRAM_MINLIST;
+			ids = (uint32_t*)malloc(sizeof(uint32_t) * size);
+			if( !ids ) {
+				// don't leave the text partially indexed
+				G_DB_Trigram_Remove(index, id, text);
+				return -1;
+			}
+			if( bucket->count ) {
+				memcpy(ids, bucket->ids, sizeof(uint32_t) * bucket->count);
+			}
+			if( bucket->ids && !DB_Trigram_InBlock(index, bucket->ids) ) {
+				free(bucket->ids);
+			}
+			bucket->ids = ids;
+			bucket->size = size;
+		}
+
+		memmove(&bucket->ids[pos + 1], &bucket->ids[pos], sizeof(uint32_t) * (bucket->count - pos));
+		bucket->ids[pos] = id;
+		bucket->count++;
+	}
+
+	return 0;
+}
+
+void G_DB_Trigram_Remove(db_trigram_t *index, uint32_t id, const char *text)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	db_trigram_bucket_t *bucket;
+	uint32_t pos;
+	uint32_t k, n;
+
+	if( !index->buckets ) {
+		return;
+	}
+
+	n = DB_Trigram_Keys(text, keys);
+	for( k = 0; k < n ; k++ ) {
+		bucket = &index->buckets[keys[k]];
+		pos = DB_Trigram_Seek(bucket, 0, id);
+		if( pos < bucket->count && bucket->ids[pos] == id ) {
+			bucket->count--;
+			memmove(&bucket->ids[pos], &bucket->ids[pos + 1], sizeof(uint32_t) * (bucket->count - pos));
+		}
+	}
+}
+
+int G_DB_Trigram_Estimate(const db_trigram_t *index, const char *pattern)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	uint32_t shortest = 0xffffffff;
+	uint32_t k, n;
+
+	if( !index->buckets ) {
+		return -1;
+	}
+
+	n = DB_Trigram_Keys(pattern, keys);
+	if( !n ) {
+		return -1;
+	}
+
+	for( k = 0; k < n ; k++ ) {
+		if( index->buckets[keys[k]].count < shortest ) {
+			shortest = index->buckets[keys[k]].count;
+		}
+	}
+
+	return (int)shortest;
+}
+
+int G_DB_Trigram_Search(const db_trigram_t *index, const char *pattern, db_trigram_visit_f visit, void *context)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	const db_trigram_bucket_t *lists[DB_TRIGRAM_MAXKEYS];
+	const db_trigram_bucket_t *list;
+	uint32_t cursors[DB_TRIGRAM_MAXKEYS];
+	uint32_t id;
+	uint32_t i, j, k, n;
+	int visited = 0;
+
+	if( !index->buckets ) {
+		return -1;
+	}
+
+	n = DB_Trigram_Keys(pattern, keys);
+	if( !n ) {
+		return -1;
+	}
+
+	// the shortest list first, it drives the intersection
+	for( k = 0; k < n ; k++ ) {
+		list = &index->buckets[keys[k]];
+		if( !list->count ) {
+			return 0;
+		}
+		for( j = k; j > 0 && lists[j-1]->count > list->count ; j-- ) {
+			lists[j] = lists[j-1];
+		}
+		lists[j] = list;
+		cursors[k] = 0;
+	}
+
+	for( i = 0; i < lists[0]->count ; i++ ) {
+		id = lists[0]->ids[i];
+		for( k = 1; k < n ; k++ ) {
+			cursors[k] = DB_Trigram_Seek(lists[k], cursors[k], id);
+			if( cursors[k] == lists[k]->count ) {
+				// no more common ids
+				return visited;
+			}
+			if( lists[k]->ids[cursors[k]] != id ) {
+				break;
+			}
+		}
+		if( k < n ) {
+			continue;
+		}
+		visited++;
+		if( !visit(id, context) ) {
+			break;
+		}
+	}
+
+	return visited;
+}
+
+// sorts the lists of the keys, the shortest first
+static void DB_Trigram_SortLists(const db_trigram_t *index, const uint32_t *keys, uint32_t n, const db_trigram_bucket_t **lists)
+{
+	const db_trigram_bucket_t *list;
+	uint32_t j, k;
+
+	for( k = 0; k < n ; k++ ) {
+		list = &index->buckets[keys[k]];
+		for( j = k; j > 0 && lists[j-1]->count > list->count ; j-- ) {
+			lists[j] = lists[j-1];
+		}
+		lists[j] = list;
+	}
+}
+
+int G_DB_Trigram_EstimateApprox(const db_trigram_t *index, const char *pattern, uint32_t maxErrors)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	const db_trigram_bucket_t *lists[DB_TRIGRAM_MAXKEYS];
+	uint32_t estimate = 0;
+	uint32_t k, n;
+
+	if( !index->buckets ) {
+		return -1;
+	}
+
+	n = DB_Trigram_Keys(pattern, keys);
+	if( n <= maxErrors * 3 ) {
+		return -1;
+	}
+
+	// every candidate is on some of the lists that can be missing plus one
+	DB_Trigram_SortLists(index, keys, n, lists);
+	for( k = 0; k <= maxErrors * 3 ; k++ ) {
+		estimate += lists[k]->count;
+	}
+
+	return (int)estimate;
+}
+
+int G_DB_Trigram_SearchApprox(const db_trigram_t *index, const char *pattern, uint32_t maxErrors, db_trigram_visit_f visit, void *context)
+{
+	uint32_t keys[DB_TRIGRAM_MAXKEYS];
+	const db_trigram_bucket_t *lists[DB_TRIGRAM_MAXKEYS];
+	uint32_t cursors[DB_TRIGRAM_MAXKEYS];
+	uint32_t drivers;
+	uint32_t needed;
+	uint32_t found;
+	uint32_t id;
+	uint32_t k, n;
+	int visited = 0;
+
+	if( !index->buckets ) {
+		return -1;
+	}
+
+	n = DB_Trigram_Keys(pattern, keys);
+	if( n <= maxErrors * 3 ) {
+		return -1;
+	}
+
+	// an edit breaks at most three sequences of the pattern, so a matching text has at least the
+	// rest of them. Such a text is on at least one of the lists that can be missing plus one, the
+	// shortest of them drive the search and the others are sought for the count.
+	needed = n - maxErrors * 3;
+	drivers = n - needed + 1;
+	DB_Trigram_SortLists(index, keys, n, lists);
+	memset(cursors, 0, sizeof(uint32_t) * n);
+
+	for( ;; ) {
+		id = 0xffffffff;
+		for( k = 0; k < drivers ; k++ ) {
+			if( cursors[k] < lists[k]->count && lists[k]->ids[cursors[k]] < id ) {
+				id = lists[k]->ids[cursors[k]];
+			}
+		}
+		if( id == 0xffffffff ) {
+			break;
+		}
+
+		found = 0;
+		for( k = 0; k < drivers ; k++ ) {
+			if( cursors[k] < lists[k]->count && lists[k]->ids[cursors[k]] == id ) {
+				cursors[k]++;
+				found++;
+			}
+		}
+		for( k = drivers; k < n && found < needed && found + (n - k) >= needed ; k++ ) {
+			cursors[k] = DB_Trigram_Seek(lists[k], cursors[k], id);
+			if( cursors[k] < lists[k]->count && lists[k]->ids[cursors[k]] == id ) {
+				found++;
+			}
+		}
+		if( found < needed ) {
+			continue;
+		}
+		visited++;
+		if( !visit(id, context) ) {
+			break;
+		}
+	}
+
+	return visited;
+}
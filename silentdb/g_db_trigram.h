@@ -0,0 +1,131 @@
+/*
+ *  Module contains a trigram index for the substring searches of the database modules.
+ *
+ *  Every three character sequence of the indexed text is hashed to a bucket. The bucket holds a
+ *  sorted list of the ids of the texts having the sequence. A substring search intersects the lists
+ *  of the sequences of the pattern and hands out the candidates, so the cost follows the amount of
+ *  the candidates and not the amount of the indexed texts. The buckets are shared by the sequences
+ *  with the same hash and the look-alike characters are folded together before the hashing, so the
+ *  caller must always verify the candidates with the actual text.
+ *
+ *  The users are indexed by their user cache positions and the aliases by their entry indexes.
+ *
+ *  Changelog ( date, changes, author ):
+ *  2026-10-17, Initial version, agent
+ *  2026-10-17, Look-alike characters folded for the approximate searches, agent
+*/
+
+#ifndef __G_DB_TRIGRAM_H__
+#define __G_DB_TRIGRAM_H__
+
+// the longest indexed text, the characters after this are not indexed
+#define SIL_DB_TRIGRAM_MAXTEXT	MAX_NAME_LENGTH
+
+typedef struct db_trigram_bucket_s {
+	uint32_t	*ids;		// sorted ascending
+	uint32_t	count;
+	uint32_t	size;
+} db_trigram_bucket_t;
+
+typedef struct db_trigram_s {
+	db_trigram_bucket_t	*buckets;	// NULL if the index is not built
+	uint32_t			*block;		// the lists created by the build are in this single block
+	uint32_t			blocksize;
+} db_trigram_t;
+
+// returns the text of the id, NULL or empty text is not indexed
+typedef const char* (*db_trigram_text_f)(uint32_t id, void *context);
+// called for every candidate in ascending id order, return qfalse to stop the search
+typedef qboolean (*db_trigram_visit_f)(uint32_t id, void *context);
+
+/**
+ * Function builds the index for the ids from 0 to count - 1. The lists are laid out to a single
+ * memory block, so building large indexes does not fragment the server memory.
+ *
+ * @param index The index to build. Old content is freed.
+ * @param count The amount of the ids.
+ * @param text Function returning the text of an id.
+ * @param context Passed to the text function.
+ * @return 0 on success, -1 if out of memory. The index is left unbuilt on failure.
+ */
+int G_DB_Trigram_Build(db_trigram_t *index, uint32_t count, db_trigram_text_f text, void *context);
+
+/**
+ * Function releases all the memory of the index and leaves it unbuilt.
+ *
+ * @param index The index to free.
+ */
+void G_DB_Trigram_Free(db_trigram_t *index);
+
+/**
+ * Function adds the text with the id to the built index. The id must not be in the index with
+ * other text, remove the old text first.
+ *
+ * @param index The index to add to.
+ * @param id The id of the text.
+ * @param text The text to index.
+ * @return 0 on success, -1 if out of memory or the index is not built
+ */
+int G_DB_Trigram_Add(db_trigram_t *index, uint32_t id, const char *text);
+
+/**
+ * Function removes the text with the id from the built index.
+ *
+ * @param index The index to remove from.
+ * @param id The id of the text.
+ * @param text The exact text the id was indexed with.
+ */
+void G_DB_Trigram_Remove(db_trigram_t *index, uint32_t id, const char *text);
+
+/**
+ * Function estimates the amount of the candidates of the pattern without visiting them. The
+ * estimate is the length of the shortest list of the pattern, so it is never less than the
+ * amount of the candidates G_DB_Trigram_Search would hand out.
+ *
+ * @param index The index to search.
+ * @param pattern The searched substring.
+ * @return The estimate or -1 if the index can't be used for the pattern.
+ */
+int G_DB_Trigram_Estimate(const db_trigram_t *index, const char *pattern);
+
+/**
+ * Function hands out the ids of the texts that may contain the pattern. Every text containing
+ * the pattern is handed out, but also some others may be.
+ *
+ * @param index The index to search.
+ * @param pattern The searched substring.
+ * @param visit Function called for the candidates.
+ * @param context Passed to the visit function.
+ * @return The amount of the visited candidates or -1 if the index can't be used for the pattern,
+ *         the pattern is shorter than three characters or the index is not built. The caller must
+ *         scan the texts itself then.
+ */
+int G_DB_Trigram_Search(const db_trigram_t *index, const char *pattern, db_trigram_visit_f visit, void *context);
+
+/**
+ * Function estimates the amount of the candidates of the fuzzy pattern like G_DB_Trigram_Estimate.
+ *
+ * @param index The index to search.
+ * @param pattern The pattern without the ~ suffix.
+ * @param maxErrors The allowed edits.
+ * @return The estimate or -1 if the index can't be used for the pattern.
+ */
+int G_DB_Trigram_EstimateApprox(const db_trigram_t *index, const char *pattern, uint32_t maxErrors);
+
+/**
+ * Function hands out the ids of the texts that may have a substring within the allowed edits from
+ * the pattern, with the characters folded like in G_DB_Fuzzy_Fold. Every such text is handed out,
+ * but also some others may be.
+ *
+ * @param index The index to search.
+ * @param pattern The pattern without the ~ suffix.
+ * @param maxErrors The allowed edits.
+ * @param visit Function called for the candidates in ascending id order.
+ * @param context Passed to the visit function.
+ * @return The amount of the visited candidates or -1 if the index can't be used for the pattern,
+ *         the pattern has too few sequences for the edits or the index is not built. The caller
+ *         must scan the texts itself then.
+ */
+int G_DB_Trigram_SearchApprox(const db_trigram_t *index, const char *pattern, uint32_t maxErrors, db_trigram_visit_f visit, void *context);
+
+#endif
@@ -3,6 +3,20 @@
 #include "g_shrubbotdb.h"
 #include "g_db_filehandling.h"
 #include "g_db_aliases.h"
+#include "g_db_hashindex.h"
+#include "g_db_guid.h"
+#include "g_db_trigram.h"
+#include "g_db_iptrie.h"
+#include "g_db_namescan.h"
+#include "g_db_ident.h"
+#include "g_db_expiry.h"
+#include "g_db_timerwheel.h"
+#include "g_db_skiplist.h"
+#include "g_db_kll.h"
+#include "g_db_fenwick.h"
+#include "g_db_cursor.h"
+#include "g_db_topk.h"
+#include "g_db_fuzzy.h"
 #include "silent_acg.h"
 
 //
@@ -20,6 +34,7 @@
 #define DB_USERS_VERSION_01 "SLEnT UDB v0.1\0\0"
 #define DB_USERS_VERSION_02 "SLEnT UDB v0.2\0\0"
 #define DB_USERS_VERSION_03 "SLEnT UDB v0.3\0\0"
+#define DB_USERS_VERSION_04 "SLEnT UDB v0.4\0\0"
 
 #define DB_USERSEXTRA_VERSION_02 "SLEnT UXDB v0.2\0"
 #define DB_USERSEXTRA_VERSION_03 "SLEnT UXDB v0.3\0"
@@ -100,6 +115,32 @@ typedef struct g_shrubbot_user_f03_s {
 	uint32_t	last_xp_save;
 } g_shrubbot_user_f03_t;  // size: 300 bytes for 10 000 users ~ 2 MB
 
+typedef struct g_shrubbot_user_f04_s {
+	// for faster searching, both GUIDs are hashed
+	uint32_t	guidHash;							// silEnTGUID hash
+	uint32_t	pbgHash;							// pb guid hash
+	char		pb_guid[SIL_SHRUBBOT_DB_GUIDLEN];	// remember to always use Q_strncmp because there isn't terminating NUL
+	char		sil_guid[SIL_SHRUBBOT_DB_GUIDLEN];	// remember to always use Q_strncmp because there isn't terminating NUL
+	char		name[MAX_NAME_LENGTH];			// lowercase last used name of the player for name searches
+	char		sanitized_name[MAX_NAME_LENGTH];// we need this for searching
+	char		ip[SIL_SHRUBBOT_IPLEN];			// last IP of the user
+	int32_t		level;
+	char		flags[MAX_SHRUBBOT_FLAGS];
+	// xpsave
+	uint32_t	time;
+	float		skill[SK_NUM_SKILLS];
+	uint32_t	kills;
+	uint32_t	deaths;
+	float		kill_rating;
+    float		kill_variance;
+	float		rating;
+	float		rating_variance;
+	int32_t		mutetime;
+	uint8_t		ident[SIL_DB_IDENT_LENGTH];
+	uint32_t	ident_flags;
+	uint32_t	last_xp_save;
+} g_shrubbot_user_f04_t;  // size: 304 bytes for 10 000 users ~ 2,89 MB
+
 typedef struct g_shrubbot_userextra_f02_s {
 	char		pb_guid[SIL_SHRUBBOT_DB_GUIDLEN];
 	char		greeting[SIL_DB_GREETING_SIZE];
@@ -131,6 +172,8 @@ typedef struct g_shrubbot_userextra_f03_s {
 
 #define SIL_SHRUBBOT_DB_MAXSEARCHCACHE	256
 
+struct g_shrubbot_buffered_users_s;
+
 // so we dont have to go through the file to find the positions 2 times per map
 typedef struct {
 	g_shrubbot_user_f_t	user;
@@ -139,6 +182,13 @@ typedef struct {
 	uint32_t			filePosition;
 	uint32_t			buffered;
 	int32_t				action;
+	int32_t				indexedLevel;	// the level bucket the cache record is in
+	uint32_t			expires;	// the live entry of the record in the expiry queue, 0 if none
+	qboolean			sketched;	// the record has a value in the rating sketch
+	float				sketchedRating;	// the latest value of the record in the rating sketch
+	qboolean			listed;		// the record is counted in the listing index
+	// the buffer node of the user, NULL if not buffered. Index hits are resolved to the buffer with this.
+	struct g_shrubbot_buffered_users_s	*node;
 } g_shrubbot_usercache_t;
 
 typedef struct {
@@ -155,6 +205,8 @@ typedef struct g_shrubbot_userextras_appendbuffer_s {
 	struct g_shrubbot_userextras_appendbuffer_s	*next;
 } g_shrubbot_userextras_appendbuffer_t;
 
+// Only the data updated during the game is in here, the alias of the user is kept in the
+// buffer table separately (see DB_BUFFERALIAS), so the node fits in a single cache line.
 typedef struct g_shrubbot_buffered_users_s {
 	g_shrubbot_usercache_t				*user;
 	int32_t								flags;
@@ -167,23 +219,29 @@ typedef struct g_shrubbot_buffered_users_s {
 	float								total_percent_time;
 	float								diff_percent_time;
 	int32_t								panzerSelfKills;
-	db_alias_t							currentAlias;
 	// memory index seems redundant with fileposition, however,
 	// the fileposition cannot have negative values so they are not equivalent
 	int32_t								memoryIndex;
-	struct g_shrubbot_buffered_users_s	*next;
+	uint32_t							bufferIndex;	// position in the buffer table
+	uint32_t							partitionIndex;	// position in the partitioned nodes
 } g_shrubbot_buffered_users_t;
 
 //
 // Memory Pooling
 // This improves performance and reduces small memory fragmentation from the server process.
 
-#define SIL_DB_BUFFERPOOLSIZE MAX_CLIENTS*2
+// The buffer is a table made of blocks of this size. The first block is static memory and the
+// rest are allocated when needed. The blocks never move, so the node and the alias pointers
+// given out stay valid until the buffer is destroyed.
+#define SIL_DB_BUFFERPOOLSIZE (MAX_CLIENTS*2)
 typedef struct buffer_memory_s {
-	uint8_t		pool[sizeof(g_shrubbot_buffered_users_t)*SIL_DB_BUFFERPOOLSIZE];
-	size_t		index;
+	g_shrubbot_buffered_users_t	nodes[SIL_DB_BUFFERPOOLSIZE];
+	db_alias_t					aliases[SIL_DB_BUFFERPOOLSIZE];
 } buffer_memory_t;
 
+#define DB_BUFFERNODE(i) (&buffer_blocks[(i) / SIL_DB_BUFFERPOOLSIZE]->nodes[(i) % SIL_DB_BUFFERPOOLSIZE])
+#define DB_BUFFERALIAS(node) (&buffer_blocks[(node)->bufferIndex / SIL_DB_BUFFERPOOLSIZE]->aliases[(node)->bufferIndex % SIL_DB_BUFFERPOOLSIZE])
+
 // the cached users are huge and also in most times, players are already chached in the big cache
 #define SIL_DB_CACHEPOOLSIZE MAX_CLIENTS
 typedef struct usercache_memory_s {
@@ -197,18 +255,68 @@ typedef struct usercache_memory_s {
 // All cached data is stored in static data becasue this would surely fragment
 // the server memory and the server may need to run over a very long period
 // of time.
+
+// The parsed IP search. The searches that are not addresses, CIDR blocks, ranges or partial IPv4
+// addresses are matched as text prefixes like before.
+typedef struct db_ipsearch_s {
+	qboolean	range;
+	db_ip_t		low;
+	db_ip_t		high;
+} db_ipsearch_t;
+
 typedef struct g_shrubbot_searchcache_s {
 	uint32_t	search_type;					// level/name
 	uint32_t	search_level;					// the stored level
 	char		search_pattern[MAX_NAME_LENGTH];// the name pattern
 	char		search_ip[20];					// the actual length max is 16, keeping alignment with trailing 0
+	db_ipsearch_t search_iprange;				// search_ip parsed
 	uint32_t	used_cache;						// the amount of players in search cache
 	uint32_t	usable_results;
-	uint32_t	iterator;						// the iterator used with the result fetching
-	// value of -1 means the index has been removed
+	// value of -1 means the index has been removed, the discards pack the results before returning
 	int32_t		results[SIL_SHRUBBOT_DB_MAXSEARCHCACHE];  // the last results as indexes
 } g_shrubbot_searchcache_t;
 
+// The recent search results shared by the sessions. The results are valid while search_epoch has
+// not changed, the changes of the searched values of the cache records increase it.
+#define SIL_DB_SEARCHENTRIES	8
+
+typedef struct db_searchentry_s {
+	g_shrubbot_searchcache_t	cache;
+	uint32_t	epoch;		// search_epoch when the results were made
+	uint32_t	serial;		// new for every stored search, 0 if the entry is empty
+	uint32_t	used;		// the least recently used entry is reused first
+} db_searchentry_t;
+
+// the search of one client, the results are fetched from the entries or searched again
+typedef struct db_searchsession_s {
+	char		pattern[MAX_NAME_LENGTH];	// sanitized
+	int32_t		level;
+	char		IP[20];
+	qboolean	searched;		// the parameters are set
+	uint32_t	entry;			// the entry holding the results
+	uint32_t	serial;			// the serial of the entry holding the results
+	uint32_t	iterator;		// the iterator used with the result fetching
+	// the results of the earlier search of the session while a new search is made
+	db_searchentry_t	*previous;
+	uint32_t	previousSerial;
+} db_searchsession_t;
+
+// The cache positions of the users of one level, sorted. The levels are few, so the buckets are
+// kept in a small array and searched linearly.
+typedef struct db_levelbucket_s {
+	int32_t		level;
+	uint32_t	*ids;
+	uint32_t	count;
+	uint32_t	size;
+} db_levelbucket_t;
+
+// How long the users of a level are kept after they were last seen. The policies are read from
+// SIL_DB_RETENTION_FILENAME, the levels not listed use g_dbUserMaxAge.
+typedef struct db_retention_s {
+	int32_t		level;
+	int32_t		age;		// seconds, 0 if the users are never pruned
+} db_retention_t;
+
 //
 // Fileheader for user database file
 // Applicable to database versions:
@@ -242,11 +350,23 @@ static usercache_memory_t	cache_pool;
 // this handle is used to avoid heap memory allocations when delivering the
 // users to outside
 static g_shrubbot_user_handle_t handle_out;
-static g_shrubbot_buffered_users_t *user_buffer=NULL;
+static buffer_memory_t		**buffer_blocks=NULL;
+static uint32_t				buffer_blockcount;		// allocated blocks
+static uint32_t				buffer_blockslots;		// size of the block pointer array
+// client slot -> buffered user, set from connect to disconnect
+static g_shrubbot_buffered_users_t *client_nodes[MAX_CLIENTS];
+// the silEnT GUIDs of the clients normalized at connect
+static db_guid_t client_guids[MAX_CLIENTS];
+// all the buffered users, the connected ones are packed to the beginning and the disconnected ones
+// follow them, so both are iterated as dense arrays
+static g_shrubbot_buffered_users_t **partitioned_nodes=NULL;
+static uint32_t partitioned_slots;	// size of the partitioned node array
+static uint32_t connected_count;
 static g_shrubbot_userextras_appendbuffer_t *append_buffer=NULL;
-static g_shrubbot_buffered_users_t *user_buffer_last_node=NULL;
-static g_shrubbot_buffered_users_t *disconnected_iterator=NULL;
-static g_shrubbot_buffered_users_t *buffer_iterator=NULL;
+static g_shrubbot_userextras_appendbuffer_t *append_buffer_last=NULL;
+// the iterator of the G_DB_GetFirst(Disconnected/Connected) functions
+static g_shrubbot_user_iterator_t buffer_user_iterator;
+static uint32_t buffer_iterator;
 static g_shrubbot_usercache_t *user_cache=NULL;
 static g_shrubbot_userextras_cache_t *extras_cache=NULL;
 static db_users_info_t	db_users_info;
@@ -255,40 +375,160 @@ static uint32_t usercount_onmemory;		// users in cache
 static uint32_t extrascount_onmemory;	// user extras in cache
 static uint32_t usercount_buffer;		// users in buffer
 static uint32_t usercount_onlybuffer;	// users only in buffer, file writes don't reduce this
+// the working slot of the searches, the results are stored to the entries
 static g_shrubbot_searchcache_t search_cache;
+static db_searchentry_t search_entries[SIL_DB_SEARCHENTRIES];
+// the sessions by the client slot, the last one for the console
+static db_searchsession_t search_sessions[MAX_CLIENTS + 1];
+static uint32_t search_epoch;
+static uint32_t search_serial;
+// silEnT GUID hash -> g_shrubbot_usercache_t, holds the cache and the users that are only in buffer
+static db_hashindex_t guid_index;
+// PB GUID hash -> g_shrubbot_usercache_t, same records as above
+static db_hashindex_t pb_index;
+// case folded hash of the last 8 characters of the GUIDs, used with the admin commands
+static db_hashindex_t userid_index;
+static db_hashindex_t pbuserid_index;
+// case folded GUID hashes -> g_shrubbot_userextra_f_t, holds the extras cache and the append buffer
+static db_hashindex_t extras_guid_index;
+static db_hashindex_t extras_pb_index;
+// trigrams of the sanitized names -> index of the user_cache, used with the name searches
+static db_trigram_t name_index;
+// the sanitized names of the cache records packed for the scans of the short patterns
+static db_namecolumn_t name_column;
+// packed IPs -> index of the user_cache, not used for the searches if an insert has failed
+static db_iptrie_t ip_index;
+static qboolean ip_index_usable;
+// level -> sorted positions in user_cache, not used for the searches if an insert has failed
+static db_levelbucket_t *level_buckets;
+static uint32_t level_bucketcount;
+static qboolean level_index_usable;
+// ident hash -> g_shrubbot_usercache_t and packed IP hash -> g_shrubbot_usercache_t, used with the alt
+// account searches, the excluded idents and the records without IP are not indexed
+static db_hashindex_t ident_index;
+static db_hashindex_t ipaddr_index;
+// the results of the last alt account search
+static g_shrubbot_usercache_t *alt_results[SIL_DB_MAXALTACCOUNTS];
+static uint32_t alt_shared[SIL_DB_MAXALTACCOUNTS];
+static uint32_t alt_count;
+// cache positions by the time the users expire, used with the pruning. An entry is stale if it does
+// not match the expires of the record. The queue is built by the first pruning after the cache loads.
+static db_expiry_t expiry_queue;
+static qboolean expiry_usable;
+static int32_t expiry_maxage;		// g_dbUserMaxAge in seconds when the queue was built
+static db_retention_t retention_policies[SIL_DB_MAXRETENTIONPOLICIES];
+static uint32_t retention_count;
+// extras cache positions by the time the mute of their user ends, the permanent mutes are not in it
+static db_timerwheel_t mute_wheel;
+// the leaderboards by SIL_DB_BOARD_, built by the first leaderboard query after the cache loads. The
+// ids are the cache positions, the users only in buffer follow the cache by their buffer index.
+static db_skiplist_t boards[SIL_DB_BOARDS];
+static qboolean boards_usable;
+// the last fetched leaderboard page
+static g_shrubbot_usercache_t *board_results[SIL_DB_MAXBOARDPAGE];
+static float board_scores[SIL_DB_MAXBOARDPAGE];
+static uint32_t board_first;
+static uint32_t board_count;
+// the ratings of the rated users, built by the first query after the cache loads. A sketch can't
+// remove values, so the changed ratings are added again and the sketch is rebuilt when the stale
+// values grow to 1/32 of it. This keeps their share of the rank error close to the sketch's own.
+static db_kll_t rating_sketch;
+static qboolean rating_sketch_usable;
+static uint32_t rating_sketch_stale;
+// the ratings of the connected players, built by every query
+static db_kll_t connected_sketch;
+// the cache records listed after the buffer by the user listing, the ones not in the buffer and
+// not removed. Built by the first listing after the cache loads.
+static db_fenwick_t listing_index;
+static qboolean listing_index_usable;
+// the last fetched search cursor page
+static g_shrubbot_usercache_t *cursor_results[SIL_DB_MAXCURSORPAGE];
+static uint32_t cursor_count;
+// the results of the last ranked search
+static g_shrubbot_usercache_t *ranked_results[SIL_DB_MAXRANKED];
+static uint32_t ranked_scores[SIL_DB_MAXRANKED];
+static uint32_t ranked_count;
+// the results of the last joined query
+static g_shrubbot_usercache_t *join_results[SIL_DB_MAXJOINRESULTS];
+static uint32_t join_count;
+// the ranked search takes the candidates of the search over the leaderboard walk when there are
+// fewer of them than this part of the users
+#define DB_RANKED_MAXCANDIDATESHARE	16
 
 ////////////////////////////////////////////////////////////////////////////////
 // memory pooling
 
-// returns the address for a buffered user
-static void* DB_AllocBufferUser(void)
+// returns the next free node of the buffer table, the caller increases usercount_buffer
+static g_shrubbot_buffered_users_t* DB_AllocBufferUser(void)
 {
-	uint8_t *addr;
+	g_shrubbot_buffered_users_t *node;
+	uint32_t block = usercount_buffer / SIL_DB_BUFFERPOOLSIZE;
 
-	if(memory_pool.index < SIL_DB_BUFFERPOOLSIZE) {
-		// give address from static memory
-		addr=&memory_pool.pool[(memory_pool.index*sizeof(g_shrubbot_buffered_users_t))];
-		memory_pool.index++;
-	} else {
-		// fail back system malloc
-		addr=(uint8_t*)malloc(sizeof(g_shrubbot_buffered_users_t));
+	if( usercount_buffer >= partitioned_slots ) {
+		g_shrubbot_buffered_users_t **nodes;
+		uint32_t slots = partitioned_slots ? partitioned_slots * 2 : SIL_DB_BUFFERPOOLSIZE;
+
+		nodes = (g_shrubbot_buffered_users_t**)realloc(partitioned_nodes, sizeof(g_shrubbot_buffered_users_t*) * slots);
+		if( !nodes ) {
+			return NULL;
+		}
+		partitioned_nodes = nodes;
+		partitioned_slots = slots;
 	}
-	return addr;
+
+	if( block >= buffer_blockcount ) {
+		if( block >= buffer_blockslots ) {
+			buffer_memory_t **blocks;
+			uint32_t slots = buffer_blockslots ? buffer_blockslots * 2 : 8;
+
+			blocks = (buffer_memory_t**)realloc(buffer_blocks, sizeof(buffer_memory_t*) * slots);
+			if( !blocks ) {
+				return NULL;
+			}
+			buffer_blocks = blocks;
+			buffer_blockslots = slots;
+		}
+		if( block == 0 ) {
+			// give address from static memory
+			buffer_blocks[block] = &memory_pool;
+		} else {
+			// fail back system malloc
+			buffer_blocks[block] = (buffer_memory_t*)malloc(sizeof(buffer_memory_t));
+			if( !buffer_blocks[block] ) {
+				return NULL;
+			}
+		}
+		buffer_blockcount++;
+	}
+
+	node = DB_BUFFERNODE(usercount_buffer);
+	node->bufferIndex = usercount_buffer;
+	// a new node starts disconnected, at the end of the partitions
+	node->partitionIndex = usercount_buffer;
+	partitioned_nodes[usercount_buffer] = node;
+
+	return node;
 }
 
-static void DB_FreeBufferUser(void *address)
+// empties the buffer table, the blocks are released except the static one
+static void DB_FreeBufferUsers(void)
 {
-	if((uint8_t*)address == NULL) {
-		return;
-	}
-	if((uint8_t*)address >= memory_pool.pool &&
-		(uint8_t*)address < &memory_pool.pool[sizeof(g_shrubbot_buffered_users_t)*SIL_DB_BUFFERPOOLSIZE]) {
-		// static buffer leave it alone
-		return;
-	} else {
-		// release from heap
-		free((g_shrubbot_buffered_users_t*)address);
+	uint32_t i;
+
+	for( i = 1; i < buffer_blockcount ; i++ ) {
+		free(buffer_blocks[i]);
 	}
+	free(buffer_blocks);
+	buffer_blocks = NULL;
+	buffer_blockcount = 0;
+	buffer_blockslots = 0;
+	usercount_buffer = 0;
+	free(partitioned_nodes);
+	partitioned_nodes = NULL;
+	partitioned_slots = 0;
+
+	memset(client_nodes, 0, sizeof(client_nodes));
+	connected_count = 0;
 }
 
 static void* DB_AllocCacheUser(void)
@@ -321,209 +561,1109 @@ static void DB_FreeCacheUser(void *address)
 	}
 }
 
+// swaps the nodes in the partitioned nodes
+static void DB_SwapPartitionedNodes(uint32_t a, uint32_t b)
+{
+	g_shrubbot_buffered_users_t *node = partitioned_nodes[a];
+
+	partitioned_nodes[a] = partitioned_nodes[b];
+	partitioned_nodes[b] = node;
+	partitioned_nodes[a]->partitionIndex = a;
+	partitioned_nodes[b]->partitionIndex = b;
+}
+
+//
+// Keeps the partitions in sync with SIL_DBUSERFLAG_CONNECTED. The node is swapped with the first
+// disconnected or the last connected node and the border is moved over it.
+static void DB_SetNodeConnected(g_shrubbot_buffered_users_t *node, qboolean connected)
+{
+	if( connected ) {
+		node->flags |= SIL_DBUSERFLAG_CONNECTED;
+		if( node->partitionIndex >= connected_count ) {
+			DB_SwapPartitionedNodes(node->partitionIndex, connected_count);
+			connected_count++;
+		}
+	} else {
+		node->flags &= ~SIL_DBUSERFLAG_CONNECTED;
+		if( node->partitionIndex < connected_count ) {
+			connected_count--;
+			DB_SwapPartitionedNodes(node->partitionIndex, connected_count);
+		}
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
-// db file handling
+// user indexes
+//
+// The indexes hold pointers to the cache records and to the records that exist only in the buffer.
+// Anything that changes the indexed data of a record must unindex the record before the change and
+// index it again after it.
 
-// ensures all database files are closed
-static void DB_Files_Close(void)
+// the record data is the first member of the cache struct, the pointers given to the game can be turned back
+#define DB_USERCACHE(userdata) ((g_shrubbot_usercache_t*)(userdata))
+
+// flags for the short id searches
+#define SIL_DB_SHORTID_PB			1	// search with the end of the PB GUID
+#define SIL_DB_SHORTID_EXACTCASE	2	// compare the case too
+#define SIL_DB_SHORTID_SKIPREMOVED	4	// skip the removed records that are not buffered
+
+//
+// Calculates the key of the short id index, the case is folded so that the admins can type the id either way.
+// Returns qfalse if the id is shorter than SIL_SHRUBBOT_USERID_SIZE.
+static qboolean DB_ShortIDHash(const char *shortid, uint32_t *hash)
 {
-	if( db_users_info.db_file ) {
-		G_DB_File_Close(&db_users_info.db_file);
+	uint32_t words[SIL_SHRUBBOT_USERID_SIZE/4];
+	char *folded = (char*)words;
+	int i;
+
+	for( i = 0; i < SIL_SHRUBBOT_USERID_SIZE && shortid[i] ; i++ ) {
+		folded[i] = toupper(shortid[i]);
 	}
-	if( db_users_info.extras_file ) {
-		G_DB_File_Close(&db_users_info.extras_file);
+	if( i != SIL_SHRUBBOT_USERID_SIZE ) {
+		return qfalse;
 	}
+
+	*hash = BG_hashword(words, SIL_SHRUBBOT_USERID_SIZE/4, 0);
+
+	return qtrue;
 }
 
-static int DB_Write_UserDBheader(FILE *handle)
+//
+// Calculates the key of the ident index. Returns qfalse if the user has no usable ident.
+static qboolean DB_UserIdentHash(const g_shrubbot_usercache_t *user, uint32_t *hash)
 {
-	db_users_fileheader_t header;
+	uint32_t length = (user->user.ident_flags & SIL_DBIDENTFLAG_SHORT) ? SIL_DB_IDENT_MACLENGTH : SIL_DB_IDENT_LENGTH;
 
-	if( handle == NULL ) {
-		return -1;
+	if( !(user->user.ident_flags & SIL_DBIDENTFLAG_VALID) || G_DB_Ident_IsExcluded(user->user.ident, length) ) {
+		return qfalse;
 	}
 
-	memcpy(header.db_version, DB_USERS_VERSION, DB_USERS_VERSIONSIZE);
-	header.records_count=db_users_info.records_count;
+	*hash = G_DB_Ident_Hash(user->user.ident, length);
 
-	return G_DB_WriteBlockToFile(handle, &header, sizeof(header), 0);
+	return qtrue;
 }
 
-static int DB_Write_UserExtrasDBheader(FILE *handle)
+//
+// Calculates the key of the IP index. Returns qfalse if the user has no IP.
+static qboolean DB_UserIPHash(const g_shrubbot_usercache_t *user, uint32_t *hash)
 {
-	db_users_fileheader_t header;
+	uint32_t words[SIL_DB_IP_SIZE/4];
 
-	if( handle == NULL ) {
-		return -1;
+	if( !G_DB_IP_IsSet(&user->user.ip_addr) ) {
+		return qfalse;
 	}
 
-	memcpy(header.db_version, DB_USERSEXTRA_VERSION, DB_USERS_VERSIONSIZE);
-	header.records_count=db_users_info.extra_count;
+	memcpy(words, user->user.ip_addr.addr, sizeof(words));
+	*hash = BG_hashword(words, SIL_DB_IP_SIZE/4, 0);
 
-	return G_DB_WriteBlockToFile(handle, &header, sizeof(header), 0);
+	return qtrue;
 }
 
+static void DB_IndexUser(g_shrubbot_usercache_t *user)
+{
+	uint32_t shortHash;
 
-static void DB_ReadUsersFromDB(void)
+	// records without silEnT GUID can be found only with the PB GUID and vice versa
+	if( user->user.sil_guid[0] ) {
+		G_DB_HashIndex_Insert(&guid_index, user->user.guidHash, user);
+		if( DB_ShortIDHash(user->userid, &shortHash) ) {
+			G_DB_HashIndex_Insert(&userid_index, shortHash, user);
+		}
+	}
+	if( user->user.pb_guid[0] ) {
+		G_DB_HashIndex_Insert(&pb_index, user->user.pbgHash, user);
+		if( DB_ShortIDHash(user->shortPBGUID, &shortHash) ) {
+			G_DB_HashIndex_Insert(&pbuserid_index, shortHash, user);
+		}
+	}
+	if( DB_UserIdentHash(user, &shortHash) ) {
+		G_DB_HashIndex_Insert(&ident_index, shortHash, user);
+	}
+	if( DB_UserIPHash(user, &shortHash) ) {
+		G_DB_HashIndex_Insert(&ipaddr_index, shortHash, user);
+	}
+}
+
+static void DB_UnindexUser(g_shrubbot_usercache_t *user)
 {
-	int users = db_users_info.records_count;
-	int i, pos;
+	uint32_t shortHash;
 
-	if(users == 0) {
-		G_LogPrintf("  No players in the user database.\n");
-		return;
+	if( user->user.sil_guid[0] ) {
+		G_DB_HashIndex_Remove(&guid_index, user->user.guidHash, user);
+		if( DB_ShortIDHash(user->userid, &shortHash) ) {
+			G_DB_HashIndex_Remove(&userid_index, shortHash, user);
+		}
 	}
+	if( user->user.pb_guid[0] ) {
+		G_DB_HashIndex_Remove(&pb_index, user->user.pbgHash, user);
+		if( DB_ShortIDHash(user->shortPBGUID, &shortHash) ) {
+			G_DB_HashIndex_Remove(&pbuserid_index, shortHash, user);
+		}
+	}
+	if( DB_UserIdentHash(user, &shortHash) ) {
+		G_DB_HashIndex_Remove(&ident_index, shortHash, user);
+	}
+	if( DB_UserIPHash(user, &shortHash) ) {
+		G_DB_HashIndex_Remove(&ipaddr_index, shortHash, user);
+	}
+}
 
-	usercount_onmemory = 0;
+static void DB_SetUserGUIDHash(g_shrubbot_usercache_t *user, uint32_t guidHash)
+{
+	if( user->user.guidHash == guidHash ) {
+		return;
+	}
+	DB_UnindexUser(user);
+	user->user.guidHash = guidHash;
+	DB_IndexUser(user);
+}
 
-	user_cache=(g_shrubbot_usercache_t*)malloc(sizeof(g_shrubbot_usercache_t)*users);
-	memset(user_cache,0,sizeof(g_shrubbot_usercache_t)*users);
+//
+// The extras are compared case insensitively, so the GUID is upper cased to the 32 characters of
+// the words, a shorter GUID is padded with NULs. Returns qfalse for an empty GUID.
+static qboolean DB_ExtrasGUIDFold(const char *guid, uint32_t *words)
+{
+	char *folded = (char*)words;
+	int i;
 
-	// set the file pointer over the header
-	G_DB_SetFilePosition(db_users_info.db_file, sizeof(db_users_fileheader_t));
+	if( !guid[0] ) {
+		return qfalse;
+	}
 
-	for(i=0 ; i < users ; i++) {
-		pos = G_DB_ReadBlockFromDBFile(db_users_info.db_file, (void*)&user_cache[i].user, sizeof(g_shrubbot_user_f_t), -1);
-		if( pos == -1) {
-			G_LogPrintf("  Error condition in reading the user database file.\n");
-			// error situation, do something here
-			break;
-		}
-		user_cache[i].filePosition = pos;
-		user_cache[i].userid = &user_cache[i].user.sil_guid[24];
-		user_cache[i].shortPBGUID = &user_cache[i].user.pb_guid[24];
-		usercount_onmemory++;
+	memset(words, 0, SIL_SHRUBBOT_DB_GUIDLEN);
+	for( i = 0; i < SIL_SHRUBBOT_DB_GUIDLEN && guid[i] ; i++ ) {
+		folded[i] = toupper(guid[i]);
 	}
-	G_LogPrintf("  %d players cached from the user database.\n", usercount_onmemory);
+
+	return qtrue;
 }
 
-#ifdef DEBUG_USERSDB
-static void DB_DebugReadUsersFromDB(void)
+// the key is calculated from the upper case GUID
+static qboolean DB_ExtrasGUIDHash(const char *guid, uint32_t *hash)
 {
-	int users = db_users_info.records_count;
-	int i, pos;
+	uint32_t words[SIL_SHRUBBOT_DB_GUIDLEN/4];
 
-	if(users == 0) {
-		G_LogPrintf("  No players in the user database.\n");
-		return;
+	if( !DB_ExtrasGUIDFold(guid, words) ) {
+		return qfalse;
 	}
 
-	usercount_onmemory = 0;
+	*hash = BG_hashword(words, SIL_SHRUBBOT_DB_GUIDLEN/4, 0);
 
-	user_cache=(g_shrubbot_usercache_t*)malloc(sizeof(g_shrubbot_usercache_t)*users);
-	memset(user_cache,0,sizeof(g_shrubbot_usercache_t)*users);
+	return qtrue;
+}
 
-	// set the file pointer over the header
-	G_DB_SetFilePosition(db_users_info.db_file, sizeof(db_users_fileheader_t));
+static void DB_IndexExtras(g_shrubbot_userextra_f_t *extras)
+{
+	uint32_t hash;
 
-	for(i=0 ; i < users ; i++) {
-		pos = G_DB_ReadBlockFromDBFile(db_users_info.db_file, (void*)&user_cache[i].user, sizeof(g_shrubbot_user_f_t), -1);
-		if( pos == -1) {
-			G_LogPrintf("  Error condition in reading the user database file.\n");
-			// error situation, do something here
-			break;
-		}
-		user_cache[i].filePosition = pos;
-		user_cache[i].userid = &user_cache[i].user.sil_guid[24];
-		user_cache[i].shortPBGUID = &user_cache[i].user.pb_guid[24];
-		G_LogPrintf("  (%d) Read player '%s' SGUID(%.32s) PBGUID(%.32s).\n", (i+1), user_cache[i].user.name, user_cache[i].user.sil_guid, user_cache[i].user.pb_guid);
-		usercount_onmemory++;
+	if( DB_ExtrasGUIDHash(extras->sil_guid, &hash) ) {
+		G_DB_HashIndex_Insert(&extras_guid_index, hash, extras);
 	}
-	if( G_DB_GetRemainingByteCount(db_users_info.db_file) > 0 ) {
-		G_LogPrintf("  File has unexpected additional data (%d bytes).\n", G_DB_GetRemainingByteCount(db_users_info.db_file));
+	if( DB_ExtrasGUIDHash(extras->pb_guid, &hash) ) {
+		G_DB_HashIndex_Insert(&extras_pb_index, hash, extras);
 	}
-	G_LogPrintf("  %d players cached from the user database.\n", usercount_onmemory);
 }
-#endif
 
-static void DB_ReadExtrasFromDB(void)
+static void DB_UnindexExtras(g_shrubbot_userextra_f_t *extras)
 {
-	int users = db_users_info.extra_count;
-	int i, pos;
+	uint32_t hash;
 
-	if( users == 0 ) {
-		G_LogPrintf("  No additional user records in the user database.\n");
-		return;
+	if( DB_ExtrasGUIDHash(extras->sil_guid, &hash) ) {
+		G_DB_HashIndex_Remove(&extras_guid_index, hash, extras);
+	}
+	if( DB_ExtrasGUIDHash(extras->pb_guid, &hash) ) {
+		G_DB_HashIndex_Remove(&extras_pb_index, hash, extras);
 	}
+}
 
-	extrascount_onmemory = 0;
+static void DB_SetUserPBGUIDHash(g_shrubbot_usercache_t *user, uint32_t pbgHash)
+{
+	if( user->user.pbgHash == pbgHash ) {
+		return;
+	}
+	DB_UnindexUser(user);
+	user->user.pbgHash = pbgHash;
+	DB_IndexUser(user);
+}
 
-	extras_cache=(g_shrubbot_userextras_cache_t*)malloc(sizeof(g_shrubbot_userextras_cache_t)*users);
-	memset(extras_cache,0,sizeof(g_shrubbot_userextras_cache_t)*users);
+static void DB_SetUserPBGUID(g_shrubbot_usercache_t *user, const char *pb_guid, uint32_t pbgHash)
+{
+	DB_UnindexUser(user);
+	memcpy(user->user.pb_guid, pb_guid, SIL_SHRUBBOT_DB_GUIDLEN);
+	user->user.pbgHash = pbgHash;
+	DB_IndexUser(user);
+}
 
-	// set the file pointer over the header
-	G_DB_SetFilePosition(db_users_info.extras_file, sizeof(db_users_fileheader_t));
+static db_levelbucket_t* DB_FindLevelBucket(int32_t level)
+{
+	uint32_t i;
 
-	for(i=0 ; i < users ; i++) {
-		pos = G_DB_ReadBlockFromDBFile(db_users_info.extras_file, (void*)&extras_cache[i].extras, sizeof(g_shrubbot_userextra_f_t), -1);
-		if( pos == -1 ) {
-			G_LogPrintf("  Error condition in reading the user database file.\n");
-			// error situation, do something here
-			break;
+	for( i = 0; i < level_bucketcount ; i++ ) {
+		if( level_buckets[i].level == level ) {
+			return &level_buckets[i];
 		}
-		extras_cache[i].filePosition = pos;
-		extrascount_onmemory++;
 	}
-	G_LogPrintf("  %d records cached from the additional user info files.\n", extrascount_onmemory);
+	return NULL;
 }
 
-static void DB_ReadUserFromFile(g_shrubbot_usercache_t *user)
+// returns the position of the first id not less than the id
+static uint32_t DB_LevelBucketLowerBound(const db_levelbucket_t *bucket, uint32_t id)
 {
-	g_shrubbot_user_f_t *usr=&user->user;
-
-	G_DB_ReadBlockFromDBFile(db_users_info.db_file, (void*)usr, sizeof(g_shrubbot_user_f_t), user->filePosition);
+	uint32_t low = 0;
+	uint32_t high = bucket->count;
+	uint32_t mid;
+
+	while( low < high ) {
+		mid = low + (high - low) / 2;
+		if( bucket->ids[mid] < id ) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
 }
 
-static void DB_WriteUserToDB(g_shrubbot_usercache_t *user, int *newUsers)
+static void DB_LevelBucketRemove(uint32_t id, int32_t level)
 {
-	// writing single user into db
-	if(user->filePosition) {
-		// loaded from db , can't be zero because of the header
-		G_DB_WriteBlockToFile(db_users_info.db_file, (void*)&user->user, sizeof(g_shrubbot_user_f_t), user->filePosition);
-	} else {
-		// new record at the end of the file
-		G_DB_SetFilePosition(db_users_info.db_file, -1);
-		// filePosition gets updated but not the memoryindex because it's not in memory cache
-		user->filePosition = G_DB_WriteBlockToFile(db_users_info.db_file, (void*)&user->user, sizeof(g_shrubbot_user_f_t), -1);
-		db_users_info.records_count++;
-		*newUsers+=1;
+	db_levelbucket_t *bucket = DB_FindLevelBucket(level);
+	uint32_t low;
+
+	if( !bucket ) {
+		return;
+	}
+
+	low = DB_LevelBucketLowerBound(bucket, id);
+	if( low < bucket->count && bucket->ids[low] == id ) {
+		bucket->count--;
+		memmove(&bucket->ids[low], &bucket->ids[low + 1], sizeof(uint32_t) * (bucket->count - low));
 	}
 }
 
-static void DB_WriteUsersToDB(qboolean free_memory)
+static void DB_LevelBucketInsert(uint32_t id, int32_t level)
 {
-	g_shrubbot_buffered_users_t *users=user_buffer;
-	g_shrubbot_buffered_users_t *temp=NULL;
-	int newUsers=0;
-
-	G_DB_File_Open(&db_users_info.db_file, DB_USERS_FILENAME, DB_FILEMODE_UPDATE);
+	db_levelbucket_t *bucket = DB_FindLevelBucket(level);
+	uint32_t low = 0;
+	uint32_t high;
+	uint32_t mid;
+	void *memory;
 
-	if( !db_users_info.db_file ) {
-		G_LogPrintf("  Error: Failed to open userdb.db. File will not be updated.\n");
+	if( !level_index_usable ) {
 		return;
 	}
 
-	while( users ) {
-		temp = users;
-		// append some final data to old values, client needs to have had full init for this
+	if( !bucket ) {
+		memory = realloc(level_buckets, sizeof(db_levelbucket_t) * (level_bucketcount + 1));
+		if( !memory ) {
+			level_index_usable = qfalse;
+			return;
+		}
+		level_buckets = (db_levelbucket_t*)memory;
+		bucket = &level_buckets[level_bucketcount++];
+		memset(bucket, 0, sizeof(db_levelbucket_t));
+		bucket->level = level;
+	}
+
+	if( bucket->count == bucket->size ) {
+		memory = realloc(bucket->ids, sizeof(uint32_t) * (bucket->size ? bucket->size * 2 : 64));
+		if( !memory ) {
+			level_index_usable = qfalse;
+			return;
+		}
+		bucket->ids = (uint32_t*)memory;
+		bucket->size = bucket->size ? bucket->size * 2 : 64;
+	}
+
+	// the build inserts in the cache order, so this is normally an append
+	low = (bucket->count && bucket->ids[bucket->count - 1] < id) ? bucket->count : 0;
+	high = bucket->count;
+	while( low < high ) {
+		mid = low + (high - low) / 2;
+		if( bucket->ids[mid] < id ) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	memmove(&bucket->ids[low + 1], &bucket->ids[low], sizeof(uint32_t) * (bucket->count - low));
+	bucket->ids[low] = id;
+	bucket->count++;
+}
+
+//
+// Parses the age with the unit suffix, the plain number is in seconds.
+// This algorithm must match with the XP save algorithms
+static int32_t DB_ParseAge(const char *string)
+{
+	int32_t result = atoi(string);
+
+	if (*string) {
+		switch(string[strlen(string) - 1]) {
+			case 'O':
+			case 'o':
+				result *= 4;
+
+			case 'W':
+			case 'w':
+				result *= 7;
+
+			case 'D':
+			case 'd':
+				result *= 24;
+
+			case 'H':
+			case 'h':
+				result *= 60;
+
+			case 'M':
+			case 'm':
+				result *= 60;
+
+				break;
+		}
+	}
+
+	return result;
+}
+
+static int32_t DB_Get_UserMaxAge(void)
+{
+	if( !g_dbUserMaxAge.string[0] || !g_dbUserMaxAge.integer ) {
+		return 0;
+	}
+	return DB_ParseAge(g_dbUserMaxAge.string);
+}
+
+static void DB_AddRetentionPolicy(const char *line)
+{
+	const char *age = line;
+	uint32_t i;
+
+	if( *age == '-' ) {
+		age++;
+	}
+	if( !isdigit((unsigned char)*age) ) {
+		G_LogPrintf("  Ignoring invalid retention policy \"%s\" in %s.\n", line, SIL_DB_RETENTION_FILENAME);
+		return;
+	}
+	while( isdigit((unsigned char)*age) ) {
+		age++;
+	}
+	while( isspace((unsigned char)*age) ) {
+		age++;
+	}
+	if( !*age ) {
+		G_LogPrintf("  Ignoring invalid retention policy \"%s\" in %s.\n", line, SIL_DB_RETENTION_FILENAME);
+		return;
+	}
+
+	// the later line of the same level wins
+	for( i = 0; i < retention_count && retention_policies[i].level != atoi(line) ; i++ ) {
+	}
+	if( i == SIL_DB_MAXRETENTIONPOLICIES ) {
+		G_LogPrintf("  Too many retention policies in %s, ignoring \"%s\".\n", SIL_DB_RETENTION_FILENAME, line);
+		return;
+	}
+	retention_policies[i].level = atoi(line);
+	retention_policies[i].age = Q_stricmp(age, "never") ? DB_ParseAge(age) : 0;
+	if( retention_policies[i].age < 0 ) {
+		retention_policies[i].age = 0;
+	}
+	if( i == retention_count ) {
+		retention_count++;
+	}
+}
+
+//
+// Reads the retention policies, the file is optional.
+static void DB_LoadRetentionPolicies(void)
+{
+	FILE *handle = NULL;
+	char line[64];
+
+	retention_count = 0;
+	expiry_usable = qfalse;
+
+	if( !G_DB_File_Open(&handle, SIL_DB_RETENTION_FILENAME, DB_FILEMODE_READTEXT) ) {
+		return;
+	}
+
+	while( G_DB_ReadConfigLine(handle, line, sizeof(line)) != -1 ) {
+		DB_AddRetentionPolicy(line);
+	}
+	G_DB_File_Close(&handle);
+
+	G_LogPrintf("  Read %d retention policies from %s.\n", retention_count, SIL_DB_RETENTION_FILENAME);
+}
+
+// returns qfalse if the user is never pruned
+static qboolean DB_UserExpiry(const g_shrubbot_usercache_t *user, uint32_t *expires)
+{
+	int32_t age = expiry_maxage;
+	uint32_t i;
+
+	// users who have not appeared on the server are kept, this can happen when admin reads the admin.cfg
+	if( !user->user.time || user->action == SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+		return qfalse;
+	}
+
+	for( i = 0; i < retention_count ; i++ ) {
+		if( retention_policies[i].level == user->user.level ) {
+			age = retention_policies[i].age;
+			break;
+		}
+	}
+	if( age <= 0 ) {
+		return qfalse;
+	}
+
+	*expires = user->user.time + (uint32_t)age;
+	if( *expires < user->user.time ) {
+		*expires = 0xffffffff;
+	}
+	return qtrue;
+}
+
+static qboolean DB_CachedUserExpiry(uint32_t id, uint32_t *expires, void *context)
+{
+	if( !DB_UserExpiry(&user_cache[id], expires) ) {
+		user_cache[id].expires = 0;
+		return qfalse;
+	}
+	user_cache[id].expires = *expires;
+	return qtrue;
+}
+
+//
+// Queues the cache record again if it now expires earlier than its entry in the queue. The later
+// expiries are found when the entry is popped, so playing on the server needs no queue updates.
+static void DB_ScheduleExpiry(g_shrubbot_usercache_t *user)
+{
+	uint32_t expires;
+
+	if( !expiry_usable || !user_cache || user < user_cache || user >= &user_cache[usercount_onmemory] ) {
+		return;
+	}
+	if( !DB_UserExpiry(user, &expires) || (user->expires && user->expires <= expires) ) {
+		return;
+	}
+
+	if( G_DB_Expiry_Push(&expiry_queue, user - user_cache, expires) == -1 ) {
+		// rebuilt by the next pruning
+		expiry_usable = qfalse;
+		return;
+	}
+	user->expires = expires;
+}
+
+// moves the cache record to the bucket of its current level. The level is changed directly
+// through the user handles, so this is called when the records are saved and before the searches.
+static void DB_SyncUserLevel(g_shrubbot_usercache_t *user)
+{
+	if( user->user.level == user->indexedLevel || !user_cache
+		|| user < user_cache || user >= &user_cache[usercount_onmemory] ) {
+		return;
+	}
+
+	DB_LevelBucketRemove(user - user_cache, user->indexedLevel);
+	DB_LevelBucketInsert(user - user_cache, user->user.level);
+	user->indexedLevel = user->user.level;
+	search_epoch++;
+	DB_ScheduleExpiry(user);
+}
+
+// the levels of the connected players may have changed since they were saved
+static void DB_SyncBufferedLevels(void)
+{
+	uint32_t i;
+
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		DB_SyncUserLevel(DB_BUFFERNODE(i)->user);
+	}
+}
+
+static void DB_FreeLevelBuckets(void)
+{
+	uint32_t i;
+
+	for( i = 0; i < level_bucketcount ; i++ ) {
+		free(level_buckets[i].ids);
+	}
+	free(level_buckets);
+	level_buckets = NULL;
+	level_bucketcount = 0;
+	level_index_usable = qfalse;
+}
+
+static float DB_BoardScore(const g_shrubbot_user_f_t *user, int board)
+{
+	float score = 0.0f;
+	int i;
+
+	switch( board ) {
+		case SIL_DB_BOARD_RATING:
+			return user->rating;
+		case SIL_DB_BOARD_KILLRATING:
+			return user->kill_rating;
+		case SIL_DB_BOARD_KILLS:
+			return (float)user->kills;
+		case SIL_DB_BOARD_XP:
+			for( i = 0; i < SK_NUM_SKILLS ; i++ ) {
+				score += user->skill[i];
+			}
+			return score;
+		case SIL_DB_BOARD_LASTSEEN:
+			return (float)user->time;
+		case SIL_DB_BOARD_LASTXPSAVE:
+			return (float)user->last_xp_save;
+		default:
+			return user->skill[board - SIL_DB_BOARD_SKILL(0)];
+	}
+}
+
+// returns qfalse if the record can't be on the leaderboards
+static qboolean DB_BoardId(const g_shrubbot_usercache_t *user, uint32_t *id)
+{
+	if( user_cache && user >= user_cache && user < &user_cache[usercount_onmemory] ) {
+		*id = (uint32_t)(user - user_cache);
+		return qtrue;
+	}
+	if( user->node ) {
+		*id = usercount_onmemory + user->node->bufferIndex;
+		return qtrue;
+	}
+	return qfalse;
+}
+
+static g_shrubbot_usercache_t* DB_BoardUser(uint32_t id)
+{
+	if( id < usercount_onmemory ) {
+		return &user_cache[id];
+	}
+	return DB_BUFFERNODE(id - usercount_onmemory)->user;
+}
+
+//
+// Moves the user on the leaderboards by the current values of the record. The zero scores and the
+// removed users are not ranked.
+static void DB_SyncUserBoards(g_shrubbot_usercache_t *user)
+{
+	uint32_t id;
+	float score;
+	int i;
+
+	if( !boards_usable || !DB_BoardId(user, &id) ) {
+		return;
+	}
+
+	for( i = 0; i < SIL_DB_BOARDS ; i++ ) {
+		score = (user->action == SIL_SHRUBBOT_DB_ACTION_REMOVE) ? 0.0f : DB_BoardScore(&user->user, i);
+		if( score == 0.0f ) {
+			G_DB_SkipList_Remove(&boards[i], id);
+		} else if( G_DB_SkipList_Set(&boards[i], id, score) == -1 ) {
+			// rebuilt by the next query
+			boards_usable = qfalse;
+			return;
+		}
+	}
+}
+
+// takes the user off the leaderboards before its buffer node is released
+static void DB_RemoveUserBoards(g_shrubbot_usercache_t *user)
+{
+	uint32_t id;
+	int i;
+
+	if( !boards_usable || !DB_BoardId(user, &id) ) {
+		return;
+	}
+
+	for( i = 0; i < SIL_DB_BOARDS ; i++ ) {
+		G_DB_SkipList_Remove(&boards[i], id);
+	}
+}
+
+static void DB_FreeBoards(void)
+{
+	int i;
+
+	for( i = 0; i < SIL_DB_BOARDS ; i++ ) {
+		G_DB_SkipList_Free(&boards[i]);
+	}
+	boards_usable = qfalse;
+	board_count = 0;
+}
+
+// the new players have no rating before their first rated round
+static qboolean DB_IsRated(const g_shrubbot_user_f_t *user)
+{
+	return (user->rating != 0.0f || user->rating_variance < SIGMA2_THETA) ? qtrue : qfalse;
+}
+
+//
+// Adds the changed rating of the user to the rating sketch. The old value of the user stays in the
+// sketch as a stale value until the next rebuild.
+static void DB_SyncUserSketch(g_shrubbot_usercache_t *user)
+{
+	qboolean rated = (user->action != SIL_SHRUBBOT_DB_ACTION_REMOVE && DB_IsRated(&user->user)) ? qtrue : qfalse;
+
+	if( !rating_sketch_usable ) {
+		return;
+	}
+	if( user->sketched ) {
+		if( rated && user->sketchedRating == user->user.rating ) {
+			return;
+		}
+		rating_sketch_stale++;
+		if( rating_sketch_stale > rating_sketch.n / 32 ) {
+			// rebuilt by the next query
+			rating_sketch_usable = qfalse;
+			return;
+		}
+	}
+
+	user->sketched = rated;
+	if( rated ) {
+		user->sketchedRating = user->user.rating;
+		G_DB_Kll_Add(&rating_sketch, user->sketchedRating);
+	}
+}
+
+static qboolean DB_IsInBuffer(uint32_t index)
+{
+	if(user_cache[index].buffered==SIL_SHRUBBOT_DB_BUFFERED) {
+		return qtrue;
+	}
+	return qfalse;
+}
+
+static qboolean DB_IsRemoved(uint32_t index)
+{
+	if(user_cache[index].action==SIL_SHRUBBOT_DB_ACTION_REMOVE) {
+		return qtrue;
+	}
+	return qfalse;
+}
+
+// the cache records listed after the buffer
+static qboolean DB_IsListed(uint32_t index, void *context)
+{
+	user_cache[index].listed = (!DB_IsInBuffer(index) && !DB_IsRemoved(index)) ? qtrue : qfalse;
+
+	return user_cache[index].listed;
+}
+
+// updates the listing index after the record was buffered or removed
+static void DB_SyncUserListed(g_shrubbot_usercache_t *user)
+{
+	qboolean listed;
+	uint32_t index;
+
+	if( !listing_index_usable || !user_cache || user < user_cache || user >= &user_cache[usercount_onmemory] ) {
+		return;
+	}
+
+	index = (uint32_t)(user - user_cache);
+	listed = user->listed;
+	if( DB_IsListed(index, NULL) != listed ) {
+		G_DB_Fenwick_Set(&listing_index, index, user->listed);
+	}
+}
+
+// the trigram index stores the positions of the cache records
+static const char* DB_CachedUserName(uint32_t id, void *context)
+{
+	return user_cache[id].user.sanitized_name;
+}
+
+static void DB_BuildIndexes(void)
+{
+	uint32_t i;
+
+	G_DB_HashIndex_Init(&guid_index, usercount_onmemory + SIL_DB_CACHEPOOLSIZE);
+	G_DB_HashIndex_Init(&pb_index, usercount_onmemory + SIL_DB_CACHEPOOLSIZE);
+	G_DB_HashIndex_Init(&userid_index, usercount_onmemory + SIL_DB_CACHEPOOLSIZE);
+	G_DB_HashIndex_Init(&pbuserid_index, usercount_onmemory + SIL_DB_CACHEPOOLSIZE);
+	G_DB_HashIndex_Init(&ident_index, usercount_onmemory + SIL_DB_CACHEPOOLSIZE);
+	G_DB_HashIndex_Init(&ipaddr_index, usercount_onmemory + SIL_DB_CACHEPOOLSIZE);
+	G_DB_IPTrie_Init(&ip_index, usercount_onmemory);
+	ip_index_usable = qtrue;
+	level_index_usable = qtrue;
+	expiry_usable = qfalse;
+
+	for( i = 0; i < usercount_onmemory ; i++ ) {
+		DB_IndexUser(&user_cache[i]);
+		if( G_DB_IPTrie_Insert(&ip_index, &user_cache[i].user.ip_addr, i) == -1 ) {
+			ip_index_usable = qfalse;
+		}
+		user_cache[i].indexedLevel = user_cache[i].user.level;
+		DB_LevelBucketInsert(i, user_cache[i].user.level);
+		if( user_cache[i].user.name[0] && !user_cache[i].user.sanitized_name[0] ) {
+			// the sanitized name
+			G_DB_NameScan_Sanitize(user_cache[i].user.name, user_cache[i].user.sanitized_name, MAX_NAME_LENGTH);
+			// mark the file dirty so the sanitized names will be saved in the future
+			db_users_info.truncate=qtrue;
+		}
+	}
+
+	if( G_DB_Trigram_Build(&name_index, usercount_onmemory, DB_CachedUserName, NULL) == -1 ) {
+		G_LogPrintf("  Name index could not be built, the name searches will scan the database.\n");
+	}
+	if( G_DB_NameColumn_Build(&name_column, usercount_onmemory, DB_CachedUserName, NULL) == -1 ) {
+		G_LogPrintf("  Name column could not be built, the name scans will use the records.\n");
+	}
+
+	G_DB_HashIndex_Init(&extras_guid_index, extrascount_onmemory + MAX_CLIENTS);
+	G_DB_HashIndex_Init(&extras_pb_index, extrascount_onmemory + MAX_CLIENTS);
+
+	for( i = 0; i < extrascount_onmemory ; i++ ) {
+		DB_IndexExtras(&extras_cache[i].extras);
+	}
+}
+
+static void DB_DestroyIndexes(void)
+{
+	G_DB_HashIndex_Free(&guid_index);
+	G_DB_HashIndex_Free(&pb_index);
+	G_DB_HashIndex_Free(&userid_index);
+	G_DB_HashIndex_Free(&pbuserid_index);
+	G_DB_HashIndex_Free(&extras_guid_index);
+	G_DB_HashIndex_Free(&extras_pb_index);
+	G_DB_HashIndex_Free(&ident_index);
+	G_DB_HashIndex_Free(&ipaddr_index);
+	alt_count = 0;
+	cursor_count = 0;
+	ranked_count = 0;
+	join_count = 0;
+	G_DB_Trigram_Free(&name_index);
+	G_DB_NameColumn_Free(&name_column);
+	G_DB_IPTrie_Free(&ip_index);
+	ip_index_usable = qfalse;
+	DB_FreeLevelBuckets();
+	G_DB_Expiry_Free(&expiry_queue);
+	expiry_usable = qfalse;
+	G_DB_TimerWheel_Free(&mute_wheel);
+	DB_FreeBoards();
+	rating_sketch_usable = qfalse;
+	G_DB_Fenwick_Free(&listing_index);
+	listing_index_usable = qfalse;
+}
+
+//
+// Finds the record using the silEnT GUID. The buffered record is preferred, then the first one in
+// the cache, this is the same order the buffer and the cache used to be searched.
+static g_shrubbot_usercache_t* DB_FindIndexedUser(const uint32_t guidHash, const char *guid)
+{
+	g_shrubbot_usercache_t *user;
+	g_shrubbot_usercache_t *found = NULL;
+	uint32_t iterator;
+
+	user = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(&guid_index, guidHash, &iterator);
+	while( user ) {
+		db_users_info.lastfetchN++;
+		if( (user->user.ident_flags & SIL_DBGUID_VALID) && G_DB_GUID_MatchesRaw(user->user.sil_guid, guid) ) {
+			if( user->node ) {
+				return user;
+			}
+			if( !found || user < found ) {
+				found = user;
+			}
+		}
+		user = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(&guid_index, guidHash, &iterator);
+	}
+
+	return found;
+}
+
+//
+// Finds the record using the PB GUID, the order of preference is the same as with the silEnT GUID.
+static g_shrubbot_usercache_t* DB_FindIndexedUserPB(const uint32_t guidHash, const char *guid)
+{
+	g_shrubbot_usercache_t *user;
+	g_shrubbot_usercache_t *found = NULL;
+	uint32_t iterator;
+
+	user = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(&pb_index, guidHash, &iterator);
+	while( user ) {
+		db_users_info.lastfetchN++;
+		if( G_DB_GUID_MatchesRaw(user->user.pb_guid, guid) ) {
+			if( user->node ) {
+				return user;
+			}
+			if( !found || user < found ) {
+				found = user;
+			}
+		}
+		user = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(&pb_index, guidHash, &iterator);
+	}
+
+	return found;
+}
+
+//
+// Finds the record using the 8 character end of either GUID. The order of preference is the same as
+// with the full GUIDs. The index holds only the hash of the id, so the id is still compared the same way
+// the admin commands always did. If matches is given, it is set to the amount of the matching records
+// that are not removed, more than one means that the short id is ambiguous.
+static g_shrubbot_usercache_t* DB_FindUserByShortID(const char *shortid, int flags, int *matches)
+{
+	db_hashindex_t *index = (flags & SIL_DB_SHORTID_PB) ? &pbuserid_index : &userid_index;
+	g_shrubbot_usercache_t *user;
+	g_shrubbot_usercache_t *found = NULL;
+	const char *id;
+	uint32_t shortHash;
+	uint32_t iterator;
+	int count = 0;
+
+	if( matches ) {
+		*matches = 0;
+	}
+	if( !shortid || !DB_ShortIDHash(shortid, &shortHash) ) {
+		return NULL;
+	}
+
+	user = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(index, shortHash, &iterator);
+	for( ; user ; user = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(index, shortHash, &iterator) ) {
+		id = (flags & SIL_DB_SHORTID_PB) ? user->shortPBGUID : user->userid;
+		if( flags & SIL_DB_SHORTID_EXACTCASE ) {
+			if( memcmp(id, shortid, SIL_SHRUBBOT_USERID_SIZE) ) {
+				continue;
+			}
+		} else if( Q_stricmpn(id, shortid, SIL_SHRUBBOT_USERID_SIZE) ) {
+			continue;
+		}
+		if( user->action != SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+			count++;
+		}
+		if( !user->node && (flags & SIL_DB_SHORTID_SKIPREMOVED) && user->action == SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+			continue;
+		}
+		if( found && found->node ) {
+			continue;
+		}
+		if( user->node || !found || user < found ) {
+			found = user;
+		}
+	}
+
+	if( matches ) {
+		*matches = count;
+	}
+
+	return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// db file handling
+
+// ensures all database files are closed
+static void DB_Files_Close(void)
+{
+	if( db_users_info.db_file ) {
+		G_DB_File_Close(&db_users_info.db_file);
+	}
+	if( db_users_info.extras_file ) {
+		G_DB_File_Close(&db_users_info.extras_file);
+	}
+}
+
+static int DB_Write_UserDBheader(FILE *handle)
+{
+	db_users_fileheader_t header;
+
+	if( handle == NULL ) {
+		return -1;
+	}
+
+	memcpy(header.db_version, DB_USERS_VERSION, DB_USERS_VERSIONSIZE);
+	header.records_count=db_users_info.records_count;
+
+	return G_DB_WriteBlockToFile(handle, &header, sizeof(header), 0);
+}
+
+static int DB_Write_UserExtrasDBheader(FILE *handle)
+{
+	db_users_fileheader_t header;
+
+	if( handle == NULL ) {
+		return -1;
+	}
+
+	memcpy(header.db_version, DB_USERSEXTRA_VERSION, DB_USERS_VERSIONSIZE);
+	header.records_count=db_users_info.extra_count;
+
+	return G_DB_WriteBlockToFile(handle, &header, sizeof(header), 0);
+}
+
+
+static void DB_ReadUsersFromDB(void)
+{
+	int users = db_users_info.records_count;
+	int i, pos;
+
+	if(users == 0) {
+		G_LogPrintf("  No players in the user database.\n");
+		return;
+	}
+
+	usercount_onmemory = 0;
+
+	user_cache=(g_shrubbot_usercache_t*)malloc(sizeof(g_shrubbot_usercache_t)*users);
+	memset(user_cache,0,sizeof(g_shrubbot_usercache_t)*users);
+
+	// set the file pointer over the header
+	G_DB_SetFilePosition(db_users_info.db_file, sizeof(db_users_fileheader_t));
+
+	for(i=0 ; i < users ; i++) {
+		pos = G_DB_ReadBlockFromDBFile(db_users_info.db_file, (void*)&user_cache[i].user, sizeof(g_shrubbot_user_f_t), -1);
+		if( pos == -1) {
+			G_LogPrintf("  Error condition in reading the user database file.\n");
+			// error situation, do something here
+			break;
+		}
+		user_cache[i].filePosition = pos;
+		user_cache[i].userid = &user_cache[i].user.sil_guid[24];
+		user_cache[i].shortPBGUID = &user_cache[i].user.pb_guid[24];
+		usercount_onmemory++;
+	}
+	G_LogPrintf("  %d players cached from the user database.\n", usercount_onmemory);
+}
+
+#ifdef DEBUG_USERSDB
+static void DB_DebugReadUsersFromDB(void)
+{
+	int users = db_users_info.records_count;
+	int i, pos;
+
+	if(users == 0) {
+		G_LogPrintf("  No players in the user database.\n");
+		return;
+	}
+
+	usercount_onmemory = 0;
+
+	user_cache=(g_shrubbot_usercache_t*)malloc(sizeof(g_shrubbot_usercache_t)*users);
+	memset(user_cache,0,sizeof(g_shrubbot_usercache_t)*users);
+
+	// set the file pointer over the header
+	G_DB_SetFilePosition(db_users_info.db_file, sizeof(db_users_fileheader_t));
+
+	for(i=0 ; i < users ; i++) {
+		pos = G_DB_ReadBlockFromDBFile(db_users_info.db_file, (void*)&user_cache[i].user, sizeof(g_shrubbot_user_f_t), -1);
+		if( pos == -1) {
+			G_LogPrintf("  Error condition in reading the user database file.\n");
+			// error situation, do something here
+			break;
+		}
+		user_cache[i].filePosition = pos;
+		user_cache[i].userid = &user_cache[i].user.sil_guid[24];
+		user_cache[i].shortPBGUID = &user_cache[i].user.pb_guid[24];
+		G_LogPrintf("  (%d) Read player '%s' SGUID(%.32s) PBGUID(%.32s).\n", (i+1), user_cache[i].user.name, user_cache[i].user.sil_guid, user_cache[i].user.pb_guid);
+		usercount_onmemory++;
+	}
+	if( G_DB_GetRemainingByteCount(db_users_info.db_file) > 0 ) {
+		G_LogPrintf("  File has unexpected additional data (%d bytes).\n", G_DB_GetRemainingByteCount(db_users_info.db_file));
+	}
+	G_LogPrintf("  %d players cached from the user database.\n", usercount_onmemory);
+}
+#endif
+
+static void DB_ReadExtrasFromDB(void)
+{
+	int users = db_users_info.extra_count;
+	int i, pos;
+
+	if( users == 0 ) {
+		G_LogPrintf("  No additional user records in the user database.\n");
+		return;
+	}
+
+	extrascount_onmemory = 0;
+
+	extras_cache=(g_shrubbot_userextras_cache_t*)malloc(sizeof(g_shrubbot_userextras_cache_t)*users);
+	memset(extras_cache,0,sizeof(g_shrubbot_userextras_cache_t)*users);
+
+	// set the file pointer over the header
+	G_DB_SetFilePosition(db_users_info.extras_file, sizeof(db_users_fileheader_t));
+
+	for(i=0 ; i < users ; i++) {
+		pos = G_DB_ReadBlockFromDBFile(db_users_info.extras_file, (void*)&extras_cache[i].extras, sizeof(g_shrubbot_userextra_f_t), -1);
+		if( pos == -1 ) {
+			G_LogPrintf("  Error condition in reading the user database file.\n");
+			// error situation, do something here
+			break;
+		}
+		extras_cache[i].filePosition = pos;
+		extrascount_onmemory++;
+	}
+	G_LogPrintf("  %d records cached from the additional user info files.\n", extrascount_onmemory);
+}
+
+static void DB_ReadUserFromFile(g_shrubbot_usercache_t *user)
+{
+	g_shrubbot_user_f_t *usr=&user->user;
+
+	G_DB_ReadBlockFromDBFile(db_users_info.db_file, (void*)usr, sizeof(g_shrubbot_user_f_t), user->filePosition);
+}
+
+static void DB_WriteUserToDB(g_shrubbot_usercache_t *user, int *newUsers)
+{
+	// writing single user into db
+	if(user->filePosition) {
+		// loaded from db , can't be zero because of the header
+		G_DB_WriteBlockToFile(db_users_info.db_file, (void*)&user->user, sizeof(g_shrubbot_user_f_t), user->filePosition);
+	} else {
+		// new record at the end of the file
+		G_DB_SetFilePosition(db_users_info.db_file, -1);
+		// filePosition gets updated but not the memoryindex because it's not in memory cache
+		user->filePosition = G_DB_WriteBlockToFile(db_users_info.db_file, (void*)&user->user, sizeof(g_shrubbot_user_f_t), -1);
+		db_users_info.records_count++;
+		*newUsers+=1;
+	}
+}
+
+static void DB_WriteUsersToDB(qboolean free_memory)
+{
+	g_shrubbot_buffered_users_t *temp=NULL;
+	uint32_t i;
+	int newUsers=0;
+
+	G_DB_File_Open(&db_users_info.db_file, DB_USERS_FILENAME, DB_FILEMODE_UPDATE);
+
+	if( !db_users_info.db_file ) {
+		G_LogPrintf("  Error: Failed to open userdb.db. File will not be updated.\n");
+		return;
+	}
+
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		temp = DB_BUFFERNODE(i);
+		// append some final data to old values, client needs to have had full init for this
 		if( temp->flags & SIL_DBUSERFLAG_FULLINIT ) {
 			temp->user->user.kills += temp->kills;
 			temp->user->user.deaths += temp->deaths;
 		}
 		DB_WriteUserToDB(temp->user, &newUsers);
-		users = users->next;
+		DB_SyncUserBoards(temp->user);
+		DB_SyncUserSketch(temp->user);
 		if( free_memory ) {
 			if( temp->memoryIndex == -1 ) {
 				// not freeing memory that was not explicitly made for the buffer
 				// this might look weird, so, freeing the memory made for the non cached user
 				// i.e. memoryIndex is the index in the cache but the function name here is little misleading
+				DB_RemoveUserBoards(temp->user);
+				DB_UnindexUser(temp->user);
 				DB_FreeCacheUser(temp->user);
+				// the alt account and the leaderboard results may point to it
+				alt_count = 0;
+				board_count = 0;
+			} else {
+				temp->user->node = NULL;
 			}
-			DB_FreeBufferUser(temp);
-			user_buffer = users;
-			usercount_buffer--;
 		}
 	}
+	if( free_memory ) {
+		DB_FreeBufferUsers();
+	}
 	// updating the records amount in header
 	DB_Write_UserDBheader(db_users_info.db_file);
 	G_DB_File_Close(&db_users_info.db_file);
@@ -583,10 +1723,15 @@ static void DB_WriteExtrasToDB(qboolean free_memory)
 		}
 		users = users->next;
 		if(free_memory) {
+			DB_UnindexExtras(temp->user);
 			free(temp->user);
 			free(temp);
 		}
 	}
+	if(free_memory) {
+		append_buffer = NULL;
+		append_buffer_last = NULL;
+	}
 
 	// updating the records amount in header
 	DB_Write_UserExtrasDBheader(db_users_info.extras_file);
@@ -599,7 +1744,7 @@ static void DB_WriteExtrasToDB(qboolean free_memory)
 // Some data would otherwise get distorted.
 static void DB_WriteUsersTruncFile(void)
 {
-	g_shrubbot_buffered_users_t *users_b=user_buffer;
+	g_shrubbot_buffered_users_t *users_b;
 	uint32_t					users_c;
 	uint32_t					i;
 	int newUsers=0;
@@ -621,7 +1766,8 @@ static void DB_WriteUsersTruncFile(void)
 	DB_Write_UserDBheader(db_users_info.db_file);
 
 	// write all the buffered users that are not cached
-	while(users_b) {
+	for(i=0; i<usercount_buffer ;i++) {
+		users_b=DB_BUFFERNODE(i);
 		// updating the required values for all buffered users
 		if( users_b->flags & SIL_DBUSERFLAG_FULLINIT ) {
 			users_b->user->user.kills+=users_b->kills;
@@ -634,7 +1780,6 @@ static void DB_WriteUsersTruncFile(void)
 			users_b->user->filePosition = 0;
 			DB_WriteUserToDB(users_b->user, &newUsers);
 		}
-		users_b=users_b->next;
 	}
 
 	// write the on memory cache
@@ -657,34 +1802,6 @@ static void DB_WriteUsersTruncFile(void)
 	G_DB_File_Close(&db_users_info.db_file);
 }
 
-static g_shrubbot_buffered_users_t* DB_BufferedUserNode(const uint32_t guidHash, const char *guid)
-{
-	g_shrubbot_buffered_users_t *users = user_buffer;
-	g_shrubbot_user_f_t *user;
-
-	while( users ) {
-		user = &users->user->user;
-		if( (user->ident_flags & SIL_DBGUID_VALID) && guidHash == user->guidHash && !Q_strncmp(user->sil_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-			return users;
-		}
-		users = users->next;
-	}
-	return NULL;
-}
-
-static g_shrubbot_buffered_users_t* DB_BufferedUserNodePB(const uint32_t guidHash, const char *guid)
-{
-	g_shrubbot_buffered_users_t *users = user_buffer;
-
-	while( users ) {
-		if( guidHash == users->user->user.pbgHash && !Q_strncmp(users->user->user.pb_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-			return users;
-		}
-		users = users->next;
-	}
-	return NULL;
-}
-
 //
 // Function adds a user to the buffer.
 // If the user exists in the on memory cache, the address to the memory cache
@@ -693,20 +1810,12 @@ static g_shrubbot_buffered_users_t* DB_BufferedUserNodePB(const uint32_t guidHas
 static g_shrubbot_buffered_users_t* DB_BufferUserNode(g_shrubbot_usercache_t *user, int32_t index)
 {
 	// function creates a new instance of the user type stack variables are safe when calling this function
-	g_shrubbot_buffered_users_t *users=user_buffer;
+	g_shrubbot_buffered_users_t *users;
 
+	users=DB_AllocBufferUser();
 	if(!users) {
-		users=(g_shrubbot_buffered_users_t*)DB_AllocBufferUser();
-		//users=(g_shrubbot_buffered_users_t*)malloc(sizeof(g_shrubbot_buffered_users_t));
-		user_buffer=users; // first node
-	} else {
-		users=user_buffer_last_node;
-		//users->next=(g_shrubbot_buffered_users_t*)malloc(sizeof(g_shrubbot_buffered_users_t));
-		users->next=(g_shrubbot_buffered_users_t*)DB_AllocBufferUser();
-		users=users->next;
+		return NULL;
 	}
-	users->next=NULL;
-	user_buffer_last_node=users;
 
 	if(index!=-1) {
 		// copy the address don't dublicate
@@ -715,14 +1824,21 @@ static g_shrubbot_buffered_users_t* DB_BufferUserNode(g_shrubbot_usercache_t *us
 		// whole new user, copy data and set pointers to new data
 		users->user=(g_shrubbot_usercache_t*)DB_AllocCacheUser();
 		//users->user=(g_shrubbot_usercache_t*)malloc(sizeof(g_shrubbot_usercache_t));
+		if(!users->user) {
+			return NULL;
+		}
 		memcpy(&users->user->user,&user->user,sizeof(g_shrubbot_user_f_t));
+		users->user->sketched = qfalse;
 		usercount_onlybuffer++;
 		users->user->userid = &users->user->user.sil_guid[24];
 		users->user->shortPBGUID = &users->user->user.pb_guid[24];
+		DB_IndexUser(users->user);
 	}
 	users->user->filePosition=user->filePosition;
 	users->user->action=user->action;
 	users->user->buffered=SIL_SHRUBBOT_DB_BUFFERED;
+	users->user->node=users;
+	DB_SyncUserListed(users->user);
 	users->memoryIndex=index;
 	// data that is in the stored data but that needs special buffering
 	users->kills=0;
@@ -736,99 +1852,54 @@ static g_shrubbot_buffered_users_t* DB_BufferUserNode(g_shrubbot_usercache_t *us
 	users->total_percent_time=0;
 	users->panzerSelfKills = 0;
 	users->flags=0;
+	memset(DB_BUFFERALIAS(users), 0, sizeof(db_alias_t));
 
 	usercount_buffer++;
 
 	return users;
 }
 
-static g_shrubbot_buffered_users_t* DB_UnbufferedUserNodePB(const uint32_t guidHash, const char *guid)
-{
-	int32_t users = usercount_onmemory;
-	int32_t i;
-
-	for(i=0; i < users ;i++) {
-		if( guidHash == user_cache[i].user.pbgHash && !Q_strncmp(user_cache[i].user.pb_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-			// put the user into buffer
-			db_users_info.lastfetchN += (i+1);
-			return DB_BufferUserNode(&user_cache[i], i);
-		}
-	}
-	db_users_info.lastfetchN += (i+1);
-
-	return NULL;
-}
-
-static g_shrubbot_buffered_users_t* DB_UnbufferedUserNodePBNoHash(const char *guid)
-{
-	int32_t users = usercount_onmemory;
-	int32_t i;
-
-	for(i=0; i < users ;i++) {
-		if( !Q_strncmp(user_cache[i].user.pb_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-			// put the user into buffer
-			return DB_BufferUserNode(&user_cache[i], i);
-		}
-	}
-
-	return NULL;
-}
-
-static g_shrubbot_buffered_users_t* DB_UnbufferedUserNode(const uint32_t guidHash, const char *guid)
-{
-	int32_t users = usercount_onmemory;
-	g_shrubbot_user_f_t *user;
-	int32_t i;
-
-	for(i=0; i < users ;i++) {
-		user = &user_cache[i].user;
-		if( (user->ident_flags & SIL_DBGUID_VALID) && guidHash == user->guidHash && !Q_strncmp(user->sil_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-			// put the user into buffer
-			db_users_info.lastfetchN += (i+1);
-			return DB_BufferUserNode(&user_cache[i], i);
-		}
-	}
-	db_users_info.lastfetchN += (i+1);
-
-	return NULL;
-}
-
 static void DB_DestroyBuffers(void)
 {
-	g_shrubbot_buffered_users_t *users = user_buffer;
 	g_shrubbot_buffered_users_t *temp;
 	g_shrubbot_userextras_appendbuffer_t *appends = append_buffer;
 	g_shrubbot_userextras_appendbuffer_t *temp_extra;
+	uint32_t i;
 
-	while(users) {
-		temp=users;
-		users=users->next;
+	for(i=0; i<usercount_buffer ;i++) {
+		temp=DB_BUFFERNODE(i);
 		if(temp->memoryIndex==-1) {
 			// only free users that aren't in the big memory cache
+			DB_RemoveUserBoards(temp->user);
+			DB_UnindexUser(temp->user);
 			DB_FreeCacheUser(temp->user);
+			alt_count = 0;
+			board_count = 0;
+		} else {
+			temp->user->node=NULL;
 		}
-		DB_FreeBufferUser(temp);
-		user_buffer=users;
 	}
 
-	user_buffer=NULL;
-	user_buffer_last_node=NULL;
-	usercount_buffer=0;
+	DB_FreeBufferUsers();
 
 	// extra user extra
 	while(appends) {
 		temp_extra = appends;
 		appends = appends->next;
 		if(temp_extra->user) {
+			DB_UnindexExtras(temp_extra->user);
 			free(temp_extra->user);
 		}
 		free(temp_extra);
 	}
 	append_buffer = NULL;
+	append_buffer_last = NULL;
 }
 
 static void DB_DestroyCaches(void)
 {
+	DB_DestroyIndexes();
+
 	if(user_cache) {
 		free(user_cache);
 		user_cache=NULL;
@@ -861,96 +1932,74 @@ static g_shrubbot_buffered_users_t* DB_NewUserNode(const uint32_t guidHash, cons
 
 static g_shrubbot_buffered_users_t* DB_GetUserNode(const uint32_t guidHash, const char* guid)
 {
-	g_shrubbot_buffered_users_t *node=NULL;
+	g_shrubbot_usercache_t *user;
 
-	node = DB_BufferedUserNode(guidHash, guid);
+	user = DB_FindIndexedUser(guidHash, guid);
 
-	if( node == NULL ) {
-		// searching the on memory cache and adding the user to buffer if found
-		node = DB_UnbufferedUserNode(guidHash, guid);
+	if( !user ) {
+		return NULL;
 	}
-
-	return node;
+	if( user->node ) {
+		return user->node;
+	}
+	// found from the on memory cache, adding the user to buffer
+	return DB_BufferUserNode(user, (int32_t)(user - user_cache));
 }
 
 static g_shrubbot_user_f_t* DB_GetUserNodeWithoutBuffering(const uint32_t guidHash, const char* guid)
 {
-	g_shrubbot_user_f_t *user = NULL;
-	g_shrubbot_buffered_users_t *node = NULL;
-
-	node = DB_BufferedUserNode(guidHash, guid);
-
-	if( node == NULL ) {
-		// searching the on memory cache and adding the user to buffer if found
-		int32_t users = usercount_onmemory;
-		int32_t i;
+	g_shrubbot_usercache_t *user;
 
-		for(i=0; i < users ;i++) {
-			user = &user_cache[i].user;
-			if( (user->ident_flags & SIL_DBGUID_VALID) && guidHash == user->guidHash && !Q_strncmp(user->sil_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-				break;
-			}
-		}
+	user = DB_FindIndexedUser(guidHash, guid);
 
-		if( i == users ) {
-			return NULL;
-		}
-	} else {
-		user = &node->user->user;
+	if( !user ) {
+		return NULL;
 	}
 
-	return user;
+	return &user->user;
 }
 
 static g_shrubbot_buffered_users_t* DB_GetUserNodePB(const uint32_t guidHash, const char* guid)
 {
-	g_shrubbot_buffered_users_t *node = NULL;
+	g_shrubbot_usercache_t *user;
 
-	node = DB_BufferedUserNodePB(guidHash, guid);
+	user = DB_FindIndexedUserPB(guidHash, guid);
 
-	if( node == NULL ) {
-		// searching the on memory cache and adding the user to buffer if found
-		node = DB_UnbufferedUserNodePB(guidHash, guid);
+	if( !user ) {
+		return NULL;
 	}
-
-	return node;
+	if( user->node ) {
+		return user->node;
+	}
+	// found from the on memory cache, adding the user to buffer
+	return DB_BufferUserNode(user, (int32_t)(user - user_cache));
 }
 
 static g_shrubbot_buffered_users_t* DB_GetUserNodePBNoHash(const char* guid)
 {
-	g_shrubbot_buffered_users_t *node = NULL;
-
-	if( node == NULL ) {
-		// searching the on memory cache and adding the user to buffer if found
-		node = DB_UnbufferedUserNodePBNoHash(guid);
-	}
-
-	return node;
+	// the index is keyed with the hash, so it is calculated here
+	return DB_GetUserNodePB(BG_hashword((const uint32_t*)guid, 8, 0), guid);
 }
 
 /**
 	Function checks that the extras in the DB have a purpose and sets them to be removed if not.
-	Only cache needs to be checked.
+	Only cache needs to be checked. This is done once after the cache is read, the timed mutes
+	are scheduled to the mute wheel so the expired ones are found without going through the cache.
 */
-static void DB_ExtrasCleanup(void)
+static void DB_ScheduleMutes(void)
 {
 	g_shrubbot_user_f_t	*user;
 	uint32_t guidHash;
 	uint32_t i;
 
+	G_DB_TimerWheel_Init(&mute_wheel, (uint32_t)level.realtime);
+
 	for(i=0; i < extrascount_onmemory ; i++) {
 		if(extras_cache[i].action & SIL_SHRUBBOT_DB_ACTION_REMOVE) {
 			continue;
 		}
 		// check if the player is found from userdb
-		/*
-		trusting that the userxdb.db is well written, i.e. the guid is uppercase already
-		if it wasn't, the record would be unusable anyway
-		for(j=0; j < 32 && extras_cache[i].extras.sil_guid[j] ;j++) {
-			guid[j]=toupper(extras_cache[i].extras.sil_guid[j]);
-		}
-		if(i!=32) { return; }
-		*/
+		// trusting that the userxdb.db is well written, i.e. the guid is uppercase already
 		guidHash = BG_hashword((const uint32_t*)extras_cache[i].extras.sil_guid, 8, 0);
 
 		user = DB_GetUserNodeWithoutBuffering(guidHash, extras_cache[i].extras.sil_guid);
@@ -963,15 +2012,48 @@ static void DB_ExtrasCleanup(void)
 		if( user->mutetime == 0 ) {
 			extras_cache[i].extras.muted_by[0] = '\0';
 			extras_cache[i].extras.mute_reason[0] = '\0';
-		} else if( user->mutetime > 0 && user->mutetime < level.realtime ) {
-			// clean up expired mutes
-			user->mutetime = 0;
-			extras_cache[i].extras.muted_by[0] = '\0';
-			extras_cache[i].extras.mute_reason[0] = '\0';
+		} else if( user->mutetime > 0 ) {
+			G_DB_TimerWheel_Set(&mute_wheel, i, (uint32_t)user->mutetime);
 		}
 	}
 }
 
+static void DB_ExpireMute(uint32_t id, void *context)
+{
+	g_shrubbot_userextras_cache_t *extras = &extras_cache[id];
+	g_shrubbot_user_f_t	*user;
+
+	if(extras->action & SIL_SHRUBBOT_DB_ACTION_REMOVE) {
+		return;
+	}
+
+	user = DB_GetUserNodeWithoutBuffering(BG_hashword((const uint32_t*)extras->extras.sil_guid, 8, 0), extras->extras.sil_guid);
+
+	if( !user ) {
+		extras->action |= SIL_SHRUBBOT_DB_ACTION_REMOVE;
+		return;
+	}
+	if( user->mutetime > 0 && user->mutetime >= level.realtime ) {
+		// the mute was extended without G_DB_SetMuteData
+		G_DB_TimerWheel_Set(&mute_wheel, id, (uint32_t)user->mutetime);
+		return;
+	}
+	if( user->mutetime >= 0 ) {
+		// clean up expired mutes
+		user->mutetime = 0;
+		extras->extras.muted_by[0] = '\0';
+		extras->extras.mute_reason[0] = '\0';
+	}
+}
+
+/**
+	Function cleans up the mutes that have expired since the cache was read.
+*/
+static void DB_ExtrasCleanup(void)
+{
+	G_DB_TimerWheel_Advance(&mute_wheel, (uint32_t)level.realtime, DB_ExpireMute, NULL);
+}
+
 static void DB_FillHandle(g_shrubbot_buffered_users_t *node, g_shrubbot_user_handle_t *handle)
 {
 	memset(handle, 0, sizeof(g_shrubbot_user_handle_t));
@@ -1000,22 +2082,87 @@ static void DB_FillHandleFromFileRecord(g_shrubbot_user_f_t *node, g_shrubbot_us
 	handle->node=(void*)node;
 }
 
-static qboolean DB_IsInBuffer(uint32_t index)
+// the buffered users get the buffer handle, so the changes go to the buffer like with the lookups
+static void DB_FillUserHandle(g_shrubbot_usercache_t *user, g_shrubbot_user_handle_t *handle)
 {
-	if(user_cache[index].buffered==SIL_SHRUBBOT_DB_BUFFERED) {
-		return qtrue;
+	if( user->node ) {
+		DB_FillHandle(user->node, handle);
+		return;
 	}
-	return qfalse;
+	memset(handle, 0, sizeof(g_shrubbot_user_handle_t));
+	handle->flags = SIL_DBUSERFLAG_CACHED;
+	handle->node = (void*)user;
+	handle->user = &user->user;
+	handle->userid = &user->user.sil_guid[24];
+	handle->shortPBGUID = &user->user.pb_guid[24];
 }
 
-static qboolean DB_IsRemoved(uint32_t index)
+static qboolean DB_IsCacheRecord(const g_shrubbot_usercache_t *user)
 {
-	if(user_cache[index].action==SIL_SHRUBBOT_DB_ACTION_REMOVE) {
+	if( user_cache && user >= user_cache && user < &user_cache[usercount_onmemory] ) {
 		return qtrue;
 	}
 	return qfalse;
 }
 
+// sets the sanitized name of the user and keeps the name index up to date
+static void DB_SetSanitizedName(g_shrubbot_usercache_t *user, const char *name)
+{
+	qboolean cached = DB_IsCacheRecord(user);
+
+	if( cached ) {
+		G_DB_Trigram_Remove(&name_index, user - user_cache, user->user.sanitized_name);
+	}
+	G_DB_NameScan_Sanitize(name, user->user.sanitized_name, MAX_NAME_LENGTH);
+	if( cached ) {
+		G_DB_Trigram_Add(&name_index, user - user_cache, user->user.sanitized_name);
+		G_DB_NameColumn_Set(&name_column, user - user_cache, user->user.sanitized_name);
+		search_epoch++;
+	}
+}
+
+// sets the IP of the user from the client IP including the port and keeps the IP index up to date
+static void DB_SetUserIP(g_shrubbot_usercache_t *user, const char *ip)
+{
+	qboolean cached = DB_IsCacheRecord(user);
+	const char *end;
+	size_t length;
+
+	DB_UnindexUser(user);
+	if( cached ) {
+		G_DB_IPTrie_Remove(&ip_index, &user->user.ip_addr, user - user_cache);
+	}
+
+	// the binary form is parsed from the whole client IP, so it keeps the IPv6 addresses too
+	G_DB_IP_Parse(ip, &user->user.ip_addr);
+
+	// the text form drops the port and the brackets of "[v6]:port", the long IPv6 addresses are
+	// cut to the field. An unknown format is kept as it is.
+	if( ip[0] == '[' && strchr(ip, ']') ) {
+		ip++;
+		end = strchr(ip, ']');
+	} else {
+		end = strchr(ip, ':');
+		if( end && strchr(end + 1, ':') ) {
+			// a plain IPv6 address, there is no port
+			end = NULL;
+		}
+	}
+	length = end ? (size_t)(end - ip) : strlen(ip);
+	if( length > SIL_SHRUBBOT_IPLEN - 1 ) {
+		length = SIL_SHRUBBOT_IPLEN - 1;
+	}
+	memset(user->user.ip, 0, sizeof(user->user.ip));
+	memcpy(user->user.ip, ip, length);
+
+	DB_IndexUser(user);
+	if( cached && G_DB_IPTrie_Insert(&ip_index, &user->user.ip_addr, user - user_cache) == -1 ) {
+		ip_index_usable = qfalse;
+	}
+	if( cached ) {
+		search_epoch++;
+	}
+}
 
 ////////////////////////////////////////////////////////////////////////
 // DB_UserDB_Close
@@ -1036,127 +2183,125 @@ static void DB_UserDB_Close(void)
 	db_users_info.usable=qfalse;
 }
 
-//
-// This algorithm must match with the XP save algorithms
-static int32_t DB_Get_UserMaxAge(void) {
-	int32_t result = g_dbUserMaxAge.integer;
+char* G_DB_SanitizeName(const char* name)
+{
+	static char name_buf[MAX_NAME_LENGTH];
 
-	if (*g_dbUserMaxAge.string) {
-		switch(g_dbUserMaxAge.string[strlen(g_dbUserMaxAge.string) - 1]) {
-			case 'O':
-			case 'o':
-				result *= 4;
+	G_DB_NameScan_Sanitize(name, name_buf, sizeof(name_buf));
+	return &name_buf[0];
+}
 
-			case 'W':
-			case 'w':
-				result *= 7;
+////////////////////////////////////////////////////////////////////////////////
+// User Extra data handling
 
-			case 'D':
-			case 'd':
-				result *= 24;
+static qboolean DB_IsExtrasCacheRecord(const g_shrubbot_userextra_f_t *extras)
+{
+	if( extras_cache && (const g_shrubbot_userextras_cache_t*)extras >= extras_cache
+		&& (const g_shrubbot_userextras_cache_t*)extras < &extras_cache[extrascount_onmemory] ) {
+		return qtrue;
+	}
+	return qfalse;
+}
 
-			case 'H':
-			case 'h':
-				result *= 60;
+//
+// Keeps the mute expiry of the extras cache record in the mute wheel. The appended extras are
+// written only when they have data, so they need no clean up.
+static void DB_ScheduleMute(const g_shrubbot_userextra_f_t *extras, int32_t mutetime)
+{
+	uint32_t id;
 
-			case 'M':
-			case 'm':
-				result *= 60;
+	if( !DB_IsExtrasCacheRecord(extras) ) {
+		return;
+	}
 
-				break;
+	id = (uint32_t)((const g_shrubbot_userextras_cache_t*)extras - extras_cache);
+	if( mutetime > 0 ) {
+		if( G_DB_TimerWheel_Set(&mute_wheel, id, (uint32_t)mutetime) == -1 ) {
+			G_LogPrintf("Mute expiry could not be scheduled, the mute data is kept until unmuted.\n");
 		}
+	} else {
+		G_DB_TimerWheel_Remove(&mute_wheel, id);
 	}
-
-	return result;
 }
 
-char* G_DB_SanitizeName(const char* name)
+//
+// Finds the extras with the GUID from the index. The append buffer is preferred over the cache and
+// the first one in the cache over the later ones, this is the order the data used to be searched.
+static g_shrubbot_userextra_f_t* DB_FindIndexedExtras(db_hashindex_t *index, const char *guid, qboolean pb, qboolean cacheOnly)
 {
-	static char name_buf[MAX_NAME_LENGTH];
-	char	*point=&name_buf[0];
-	int		i;
-
-	for(i=0; *name && i < (MAX_NAME_LENGTH - 1); i++) {
-		if(*name=='^') {
-			name++;
-			if(*(name)!='^') {
-				name++;
+	g_shrubbot_userextra_f_t *extras;
+	g_shrubbot_userextra_f_t *found = NULL;
+	uint32_t folded[SIL_SHRUBBOT_DB_GUIDLEN/4];
+	uint32_t hash;
+	uint32_t iterator;
+
+	if( !DB_ExtrasGUIDFold(guid, folded) ) {
+		return NULL;
+	}
+	hash = BG_hashword(folded, SIL_SHRUBBOT_DB_GUIDLEN/4, 0);
+
+	extras = (g_shrubbot_userextra_f_t*)G_DB_HashIndex_First(index, hash, &iterator);
+	for( ; extras ; extras = (g_shrubbot_userextra_f_t*)G_DB_HashIndex_Next(index, hash, &iterator) ) {
+		if( !G_DB_GUID_MatchesNoCase(pb ? extras->pb_guid : extras->sil_guid, (const char*)folded) ) {
+			continue;
+		}
+		if( !DB_IsExtrasCacheRecord(extras) ) {
+			if( cacheOnly ) {
 				continue;
 			}
-			continue;
+			return extras;
+		}
+		if( !found || extras < found ) {
+			found = extras;
 		}
-		*point++=tolower(*name++);
 	}
-	*point='\0';
-	return &name_buf[0];
-}
 
-////////////////////////////////////////////////////////////////////////////////
-// User Extra data handling
+	return found;
+}
 
 static g_shrubbot_userextra_f_t* DB_FindUserExtras(const g_shrubbot_user_f_t *user)
 {
-	// First look from append buffer
-	g_shrubbot_userextras_appendbuffer_t *appends=append_buffer;
-	uint32_t count = extrascount_onmemory;
-	uint32_t i;
-	const char *sil_guid = user->sil_guid;
-	const char *pb_guid = user->pb_guid;
+	g_shrubbot_userextra_f_t *sil_extras = NULL;
+	g_shrubbot_userextra_f_t *pb_extras = NULL;
 
-	while(appends) {
-		if( sil_guid[0] ) {
-			if(!Q_stricmpn(appends->user->sil_guid, sil_guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
-				return appends->user;
-			}
-		}
-		if( pb_guid[0] ) {
-			if(!Q_stricmpn(appends->user->pb_guid, pb_guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
-				return appends->user;
-			}
+	if( user->sil_guid[0] ) {
+		sil_extras = DB_FindIndexedExtras(&extras_guid_index, user->sil_guid, qfalse, qfalse);
+		if( sil_extras && !DB_IsExtrasCacheRecord(sil_extras) ) {
+			return sil_extras;
 		}
-		appends=appends->next;
 	}
-	// Loop the cache
-	for(i=0; i < count ; i++) {
-		if( sil_guid[0] ) {
-			if( !Q_stricmpn(extras_cache[i].extras.sil_guid, sil_guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-				return &extras_cache[i].extras;
-			}
-		}
-		if( pb_guid[0] ) {
-			if( !Q_stricmpn(extras_cache[i].extras.pb_guid, pb_guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-				return &extras_cache[i].extras;
-			}
-		}
+	if( user->pb_guid[0] ) {
+		pb_extras = DB_FindIndexedExtras(&extras_pb_index, user->pb_guid, qtrue, qfalse);
 	}
 
-	return NULL;
+	// append buffer first, then the one earlier in the cache
+	if( !sil_extras ) {
+		return pb_extras;
+	}
+	if( pb_extras && (!DB_IsExtrasCacheRecord(pb_extras) || pb_extras < sil_extras) ) {
+		return pb_extras;
+	}
+	return sil_extras;
 }
 
 static g_shrubbot_userextras_cache_t* DB_FindExtrasCacheData(const char* guid)
 {
-	uint32_t count=db_users_info.extra_count;
-	uint32_t i;
-
-	for(i=0; i < count ; i++) {
-		if(!Q_stricmpn(extras_cache[i].extras.sil_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
-			return &extras_cache[i];
-		}
-	}
-	return NULL;
+	// the extras are the first member of the cache record
+	return (g_shrubbot_userextras_cache_t*)DB_FindIndexedExtras(&extras_guid_index, guid, qfalse, qtrue);
 }
 
 static g_shrubbot_userextras_cache_t* DB_FindExtrasCacheDataPB(const char* guid)
 {
-	uint32_t count=db_users_info.extra_count;
-	uint32_t i;
+	return (g_shrubbot_userextras_cache_t*)DB_FindIndexedExtras(&extras_pb_index, guid, qtrue, qtrue);
+}
 
-	for(i=0; i < count ; i++) {
-		if(!Q_stricmpn(extras_cache[i].extras.pb_guid, guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
-			return &extras_cache[i];
-		}
-	}
-	return NULL;
+//
+// Changes the silEnT GUID of the extras and keeps the indexes in sync.
+static void DB_SetExtrasGUID(g_shrubbot_userextra_f_t *extras, const char *sil_guid)
+{
+	DB_UnindexExtras(extras);
+	memcpy(extras->sil_guid, sil_guid, SIL_SHRUBBOT_DB_GUIDLEN);
+	DB_IndexExtras(extras);
 }
 
 static int DB_AppendNewExtras(g_shrubbot_userextra_f_t *extras)
@@ -1167,23 +2312,24 @@ static int DB_AppendNewExtras(g_shrubbot_userextra_f_t *extras)
 		return -1;
 	}
 
-	if(append_buffer == NULL) {
-		append_buffer = (g_shrubbot_userextras_appendbuffer_t*)malloc(sizeof(g_shrubbot_userextras_appendbuffer_t));
-		appends = append_buffer;
-	} else {
-		appends = append_buffer;
-		while(appends) {
-			appends = appends->next;
-		}
-		appends = (g_shrubbot_userextras_appendbuffer_t*)malloc(sizeof(g_shrubbot_userextras_appendbuffer_t));
-	}
+	appends = (g_shrubbot_userextras_appendbuffer_t*)malloc(sizeof(g_shrubbot_userextras_appendbuffer_t));
 
 	if(appends == NULL) {
 		return -1;
 	}
 	appends->user=extras;
+	appends->action=SIL_SHRUBBOT_DB_ACTION_NONE;
 	appends->next=NULL;
 
+	if(append_buffer == NULL) {
+		append_buffer = appends;
+	} else {
+		append_buffer_last->next = appends;
+	}
+	append_buffer_last = appends;
+
+	DB_IndexExtras(extras);
+
 	return 0;
 }
 
@@ -1216,10 +2362,12 @@ static void DB_DatabaseCleanUp(void)
 	uint32_t pb_guidHash;
 	uint32_t identFlags;
 	int32_t users = usercount_onmemory;
-	int32_t i, j, badHashes = 0, duplicates = 0, unlinkables = 0;
+	int32_t j, badHashes = 0, duplicates = 0, unlinkables = 0;
+	uint32_t iterator;
 	qboolean linkable = qfalse;
 	g_shrubbot_usercache_t *user;
 	g_shrubbot_usercache_t *oldUser;
+	g_shrubbot_usercache_t *other;
 
 	G_LogPrintf("*=====PERFORMING USER DATABASE CLEAN UP\n");
 
@@ -1237,24 +2385,24 @@ static void DB_DatabaseCleanUp(void)
 		if( G_CheckGUID(user->user.sil_guid, qfalse) ) {
 			guidHash = BG_hashword((const uint32_t*)user->user.sil_guid, 8, 0);
 			if( user->user.guidHash != guidHash ) {
-				user->user.guidHash = guidHash;
+				DB_SetUserGUIDHash(user, guidHash);
 				badHashes++;
 			}
 			linkable = qtrue;
 		} else {
-			user->user.guidHash = 0;
+			DB_SetUserGUIDHash(user, 0);
 			user->user.ident_flags &= ~SIL_DBGUID_VALID;
 		}
 
 		if( G_CheckGUID(user->user.pb_guid, qfalse) ) {
 			pb_guidHash = BG_hashword((const uint32_t*)user->user.pb_guid, 8, 0);
 			if( user->user.pbgHash != pb_guidHash ) {
-				user->user.pbgHash = pb_guidHash;
+				DB_SetUserPBGUIDHash(user, pb_guidHash);
 				badHashes++;
 			}
 			linkable = qtrue;
 		} else {
-			user->user.pbgHash = 0;
+			DB_SetUserPBGUIDHash(user, 0);
 		}
 
 		if( linkable == qfalse ) {
@@ -1263,37 +2411,50 @@ static void DB_DatabaseCleanUp(void)
 			continue;
 		}
 
-		// check for dublicated, doing full loop here, so that the latest one can be used as the valid one
+		// check for dublicated, only the records with the same hashes can be dublicates so the indexes are used,
+		// all of them are checked, so that the latest one can be used as the valid one
 		// SIL_DBGUID_VALID is not set with older silent GUIDs
 		identFlags = (user->user.ident_flags & SIL_DBGUID_VALID);
 		oldUser = user;
-		for(i=0; i < users ;i++) {
-			if( &user_cache[i] == oldUser ) {
-				continue;
-			}
-			if( user_cache[i].action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
-				continue;
+		// !readadmins can import admins without either GUID
+		if( guidHash ) {
+			other = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(&guid_index, guidHash, &iterator);
+			for( ; other ; other = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(&guid_index, guidHash, &iterator) ) {
+				if( other == oldUser || !DB_IsCacheRecord(other) ) {
+					continue;
+				}
+				if( other->action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+					continue;
+				}
+				if( ((other->user.ident_flags & SIL_DBGUID_VALID) == identFlags) && G_DB_GUID_MatchesRaw(other->user.sil_guid, user->user.sil_guid) ) {
+					// older gets removed
+					if( other->user.time < user->user.time ) {
+						other->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+					} else {
+						oldUser->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+						oldUser = other;
+					}
+					duplicates++;
+				}
 			}
-			// !readadmins can import admins without either GUID
-			if( guidHash && guidHash == user_cache[i].user.guidHash && ((user_cache[i].user.ident_flags & SIL_DBGUID_VALID) == identFlags)
-				&& !Q_strncmp(user_cache[i].user.sil_guid, user->user.sil_guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-				// older gets removed
-				if( user_cache[i].user.time < user->user.time ) {
-					user_cache[i].action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
-				} else {
-					oldUser->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
-					oldUser = &user_cache[i];
+		}
+		if( pb_guidHash ) {
+			other = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(&pb_index, pb_guidHash, &iterator);
+			for( ; other ; other = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(&pb_index, pb_guidHash, &iterator) ) {
+				if( other == oldUser || !DB_IsCacheRecord(other) ) {
+					continue;
+				}
+				if( other->action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+					continue;
 				}
-				duplicates++;
-			} else if( pb_guidHash && user_cache[i].user.guidHash == 0 ) {
 				// concerned about punkbuster guid hash only if the record is not linkable through silent guid
-				if( user_cache[i].user.pbgHash == pb_guidHash && !Q_strncmp(user_cache[i].user.pb_guid, user->user.pb_guid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
+				if( other->user.guidHash == 0 && G_DB_GUID_MatchesRaw(other->user.pb_guid, user->user.pb_guid) ) {
 					// older gets removed
-					if( user_cache[i].user.time < user->user.time ) {
-						user_cache[i].action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+					if( other->user.time < user->user.time ) {
+						other->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
 					} else {
 						oldUser->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
-						oldUser = &user_cache[i];
+						oldUser = other;
 					}
 					duplicates++;
 				}
@@ -1318,13 +2479,19 @@ static void DB_DatabaseCleanUp(void)
 	}
 
 	G_DB_CleanUpAliases();
+	// the removed duplicates are taken off the leaderboards, the rating sketch and the listing by the
+	// rebuilds
+	DB_FreeBoards();
+	rating_sketch_usable = qfalse;
+	listing_index_usable = qfalse;
+	search_epoch++;
 
 	G_LogPrintf("*=====USER DATABASE CLEAN UP DONE\n");
 }
 
 static void DB_WriteUsersOptimizeFile(void)
 {
-	g_shrubbot_buffered_users_t *users_b=user_buffer;
+	g_shrubbot_buffered_users_t *users_b;
 	g_shrubbot_userextras_cache_t *extras;
 	g_shrubbot_usercache_t		*user = NULL;
 	uint32_t					users_c;
@@ -1343,7 +2510,8 @@ static void DB_WriteUsersOptimizeFile(void)
 	DB_Write_UserDBheader(db_users_info.db_file);
 
 	// write all the buffered users that are not cached
-	while( users_b ) {
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		users_b = DB_BUFFERNODE(i);
 		// updating the required values for all buffered users
 		if(users_b->flags & SIL_DBUSERFLAG_FULLINIT) {
 			users_b->user->user.kills+=users_b->kills;
@@ -1356,7 +2524,6 @@ static void DB_WriteUsersOptimizeFile(void)
 			users_b->user->filePosition = 0;
 			DB_WriteUserToDB(users_b->user, &newUsers);
 		}
-		users_b=users_b->next;
 	}
 
 	// write the on memory cache
@@ -1716,6 +2883,76 @@ int DB_ConvertExtrasFrom_02(void)
 	return 0;
 }
 
+// return -1 on failures and 0 for success
+int DB_ConvertFrom_04(void)
+{
+	g_shrubbot_user_f04_t	user_read;
+	g_shrubbot_user_f_t		user_write;
+	db_users_fileheader_t	header;
+	db_users_info_t			*info=&db_users_info;
+	FILE *old_db;
+	int i, users, bytes;
+
+	// close file if open
+	G_DB_File_Close(&info->db_file);
+
+	G_LogPrintf("  User database file identified to be an old version. (Used before the binary IP addresses)\n");
+	G_LogPrintf("  Converting file to the current version.\n");
+
+	// rename old file and keep it as backup
+	G_DB_RenameFile(DB_USERS_FILENAME, "userdb_v04.db");
+
+	// create new database
+	if( DB_CreateUserDBMainFile() == -1 ) {
+		return -1;
+	}
+	if( G_DB_File_Open(&old_db, "userdb_v04.db", DB_FILEMODE_READ) == NULL ) {
+		G_LogPrintf("  Failed to open the old version of the file.\n");
+		return -1;
+	}
+
+	// copy one by one to a new file
+	G_DB_ReadBlockFromDBFile(old_db, &header, sizeof(db_users_fileheader_t), 0);
+	G_DB_SetFilePosition(info->db_file, sizeof(db_users_fileheader_t));
+
+	users = header.records_count;
+	for(i=0 ; i < users ; i++) {
+		bytes = G_DB_ReadBlockFromDBFile( old_db, (void*)&user_read, sizeof(user_read), -1);
+		if( bytes < 0 ) {
+			G_LogPrintf("  Error condition in reading the user database file.\n");
+			break;
+		}
+
+		// the old record is the beginning of the new one, only the binary IP is added
+		memset(&user_write, 0 , sizeof(user_write));
+		memcpy(&user_write, &user_read, sizeof(user_read));
+		// only the IPv4 addresses were kept whole in the text
+		G_DB_IP_Parse(user_write.ip, &user_write.ip_addr);
+
+		bytes = G_DB_WriteBlockToFile(info->db_file, &user_write, sizeof(user_write), -1);
+		if( bytes < 0 ) {
+			G_LogPrintf("  Error condition in writing to the new user database file.\n");
+			break;
+		}
+
+		info->records_count++;
+	}
+	G_DB_File_Close(&old_db);
+	DB_Write_UserDBheader(info->db_file);
+	G_DB_File_Close(&info->db_file);
+
+	G_LogPrintf("  %d records converted from the old file.\n", db_users_info.records_count);
+
+	// The init will continue normally from here so reopening the new db for good format
+	if( G_DB_File_Open(&info->db_file, DB_USERS_FILENAME, DB_FILEMODE_READ) == NULL ) {
+		G_LogPrintf("  Unexpected database conversion error.\n");
+		G_LogPrintf("  Save all database files and consult silEnT developers for more info.\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 int DB_ConvertFrom_03(void)
 {
 	g_shrubbot_user_f03_t	user_read;
@@ -1768,6 +3005,8 @@ int DB_ConvertFrom_03(void)
 
 		// mutes must be cleared when converting from below 0.4
 		user_write.mutetime = 0;
+		// the binary IP is added in 0.5, only the IPv4 addresses were kept whole in the text
+		G_DB_IP_Parse(user_write.ip, &user_write.ip_addr);
 
 		bytes = G_DB_WriteBlockToFile(info->db_file, &user_write, sizeof(user_write), -1);
 		if( bytes < 0 ) {
@@ -1849,6 +3088,8 @@ int DB_ConvertFrom_02(void)
 
 		// mutes must be cleared when converting from below 0.4
 		user_write.mutetime = 0;
+		// the binary IP is added in 0.5, only the IPv4 addresses were kept whole in the text
+		G_DB_IP_Parse(user_write.ip, &user_write.ip_addr);
 
 		G_DB_WriteBlockToFile(info->db_file, (void*)&user_write, sizeof(user_write), -1);
 		if(bytes != 1) {
@@ -1925,6 +3166,8 @@ int DB_ConvertFrom_01(void)
 
 		// mutes must be cleared when converting from below 0.4
 		user_write.mutetime = 0;
+		// the binary IP is added in 0.5, only the IPv4 addresses were kept whole in the text
+		G_DB_IP_Parse(user_write.ip, &user_write.ip_addr);
 
 		bytes = G_DB_WriteBlockToFile(info->db_file, (void*)&user_write, sizeof(user_write), -1);
 		if( bytes < 0 ) {
@@ -2067,6 +3310,14 @@ static int32_t DB_OpenMainDBFile( void )
 				} else {
 					G_LogPrintf("  Old userdb.db converted to the version used from silEnT 0.6.0 onwards.\n");
 				}
+			} else if( !memcmp(header.db_version, DB_USERS_VERSION_04, DB_USERS_VERSIONSIZE) ) {
+				// old version of database (used before the binary IP addresses)
+				if( DB_ConvertFrom_04() == -1 ) {
+					G_LogPrintf("  Failed converting old userdb.db to the version used in this silEnT version.\n");
+					return -2;
+				} else {
+					G_LogPrintf("  Old userdb.db converted to the version with the binary IP addresses.\n");
+				}
 			} else {
 				// does not match even old databse versions
 				G_LogPrintf("  Existing database file is for wrong server version or corrupted.\n");
@@ -2090,21 +3341,24 @@ static void DB_CountAndStoreFetchAverage( qboolean reset )
 
 void G_DB_UpdateAliases( void )
 {
-	g_shrubbot_buffered_users_t *users=user_buffer;
+	g_shrubbot_buffered_users_t *users;
+	db_alias_t *alias;
+	uint32_t i;
 
 	// go through all buffered players and update data as needed
 
 	// update aliases data
-	while( users ) {
-		if( users->currentAlias.clean_name[0] ) {
-			users->currentAlias.last_seen = level.realtime;
-			users->currentAlias.time_played = level.realtime - users->currentAlias.first_seen;
-			G_DB_UpdateAlias(users->user->user.sil_guid, &users->currentAlias, users->user->user.guidHash);
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		users = DB_BUFFERNODE(i);
+		alias = DB_BUFFERALIAS(users);
+		if( alias->clean_name[0] ) {
+			alias->last_seen = level.realtime;
+			alias->time_played = level.realtime - alias->first_seen;
+			G_DB_UpdateAlias(users->user->user.sil_guid, alias, users->user->user.guidHash);
 			// reset for next time
-			users->currentAlias.first_seen = level.realtime;
-			users->currentAlias.time_played = 0;
+			alias->first_seen = level.realtime;
+			alias->time_played = 0;
 		}
-		users=users->next;
 	}
 }
 
@@ -2156,11 +3410,14 @@ int32_t	G_DB_InitDatabase(qboolean force)
 	}
 
 	runtimes++;
+	G_DB_NameScan_Init();
 	memset((void*)&db_users_info, 0, sizeof(*info));
 	// from this point onward, all failures mean the database is not usable
 	info->usable = qfalse;
 	// clearing search results
 	memset(&search_cache,0,sizeof(search_cache));
+	memset(search_entries,0,sizeof(search_entries));
+	memset(search_sessions,0,sizeof(search_sessions));
 
 	if(!g_dbDirectory.string[0]) {
 		G_LogPrintf("  Database directory is not set.\n");
@@ -2179,6 +3436,10 @@ int32_t	G_DB_InitDatabase(qboolean force)
 		return -1;
 	}
 
+	// needed by the indexes and the ident validation
+	G_DB_Ident_LoadExclusions();
+	DB_LoadRetentionPolicies();
+
 	// no truncating for freshly opened db
 	info->truncate = qfalse;
 
@@ -2209,6 +3470,10 @@ int32_t	G_DB_InitDatabase(qboolean force)
 		// all done
 	}
 
+	// the indexes are needed also for an empty database, new users are indexed when they are created
+	DB_BuildIndexes();
+	DB_ScheduleMutes();
+
 	// aliases database
 	G_DB_InitAliases();
 
@@ -2280,6 +3545,7 @@ void G_DB_CloseDatabase(void)
 		G_LogPrintf("  Big Memory Cache cleaned.\n");
 	}
 	DB_UserDB_Close();
+	G_DB_Ident_FreeExclusions();
 	G_LogPrintf("*=====DATABASE IS CLOSED\n");
 #ifdef DLOPEN_HACK
 	dlopen_hack--;
@@ -2296,19 +3562,9 @@ void G_DB_CloseDatabase(void)
 /*
 	A word about combining the 2 guid searches.
 
-	Doing 2 passes to find the record.
-	Average case when found using silent guid: N/2, worst case N
-	Average case when found using pb guid: N+(N/2), worst case 2N
-	Doing single pass comparing both
-	Average case when found using silent guid: N, worst case 2N
-	Average case when found using pb guid: N worst case 2N
-
-	Overall estimation 2 passes:
-	By far most times players are already known to server, this makes the overall average less then N and worst case 2N
-	Overall estimation 1 pass:
-	Average N, worst case 2N
-
-	When counting the time used to fetch the memory, this might be in favour of single pass, but it is impossible to estimate currently.
+	Both GUIDs have their own hash index, so the record is first looked up using the silent guid and then
+	using the pb guid. Both lookups are constant time, also a first time player costs only the two misses.
+	Earlier this was 2 passes over the whole cache, worst case 2N.
 */
 
 /**
@@ -2322,12 +3578,11 @@ void G_DB_CloseDatabase(void)
 void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 {
 	g_shrubbot_buffered_users_t* user=NULL;
+	db_alias_t *alias;
 	uint32_t guidHash = 0;
 	uint32_t sil_guidHash;
-	uint32_t i;
-	char *pointer;
-	char guid[32];
-	char sil_guid[32];
+	db_guid_t guid;
+	const char *sil_guid;
 	float faverage;
 	time_t t;
 
@@ -2335,17 +3590,16 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 	g_clientSInfos[ent-g_entities].userData = NULL;
 	g_clientSInfos[ent-g_entities].extraData = NULL;
 	g_clientSInfos[ent-g_entities].alias = NULL;
+	client_nodes[ent-g_entities] = NULL;
 
-	// we first attempt to find using the silent guid
-	for( i = 0; i < 32 && ent->client->sess.guid[i] ; i++) {
-		sil_guid[i] = toupper(ent->client->sess.guid[i]);
-	}
-	if( i != 32 ) {
+	// we first attempt to find using the silent guid, normalized once for the whole connection
+	if( !G_DB_GUID_Set(&client_guids[ent-g_entities], ent->client->sess.guid) ) {
 		// no silent GUID
 		return;
 	}
 
-	sil_guidHash = BG_hashword((const uint32_t*)sil_guid, 8, 0);
+	sil_guid = client_guids[ent-g_entities].guid;
+	sil_guidHash = client_guids[ent-g_entities].hash;
 
 	db_users_info.lastfetchN = 0;
 
@@ -2353,13 +3607,9 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 
 	// try to find using PB GUIDS
 	if( !user && pb_guid[0] ) {
-		for( i = 0; i < 32 && pb_guid[i] ; i++) {
-			guid[i] = toupper(pb_guid[i]);
-		}
-
-		if( i == 32 ) {
-			guidHash = BG_hashword((const uint32_t*)guid, 8, 0);
-			user = DB_GetUserNodePB(guidHash, guid);
+		if( G_DB_GUID_Set(&guid, pb_guid) ) {
+			guidHash = guid.hash;
+			user = DB_GetUserNodePB(guidHash, guid.guid);
 		}
 		// update values for the future use
 		if( user ) {
@@ -2370,12 +3620,14 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 #ifdef DYNAMIC_MODULES
 			StatsMod_GUIDChange(user->user->user.sil_guid, sil_guid);
 #endif
+			DB_UnindexUser(user->user);
 			user->user->user.guidHash = sil_guidHash;
 			memcpy(user->user->user.sil_guid, sil_guid, SIL_SHRUBBOT_DB_GUIDLEN);
+			DB_IndexUser(user->user);
 			// check if user extra needs update for silent guid
 			userExt = DB_FindUserExtras( &user->user->user ); // <-- the naming sucks here
 			if( userExt ) {
-				memcpy(userExt->sil_guid, sil_guid, SIL_SHRUBBOT_DB_GUIDLEN);
+				DB_SetExtrasGUID(userExt, sil_guid);
 			}
 		}
 	}
@@ -2391,8 +3643,7 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 		user = DB_NewUserNode(sil_guidHash, sil_guid);
 		// copy the PB GUID if any, guidHash was created when searching the db using pb guid
 		if( user && guidHash ) {
-			memcpy(user->user->user.pb_guid, guid, sizeof(user->user->user.pb_guid));
-			user->user->user.pbgHash = guidHash;
+			DB_SetUserPBGUID(user->user, guid.guid, guidHash);
 		}
 	}
 
@@ -2400,25 +3651,21 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 	if( user ) {
 		g_clientSInfos[ent-g_entities].userData = &user->user->user;
 		g_clientSInfos[ent-g_entities].extraData = DB_FindUserExtras(&user->user->user);
-		g_clientSInfos[ent-g_entities].alias = &user->currentAlias;
+		g_clientSInfos[ent-g_entities].alias = DB_BUFFERALIAS(user);
 		user->user->user.ident_flags |= SIL_DBGUID_VALID;
 	} else {
 		G_LogPrintf("G_DB_ClientConnect: Client buffering error, system memory is likely exhausting!");
 		return;
 	}
 
-	// copy the IP if any, cut the result from port
+	// copy the IP if any
 	if( ent->client->sess.ip[0] ) {
-		strncpy(user->user->user.ip,ent->client->sess.ip,SIL_SHRUBBOT_IPLEN);
-		user->user->user.ip[SIL_SHRUBBOT_IPLEN-1] = '\0';
-		pointer = strstr(user->user->user.ip,":");
-		if(pointer) {
-			*pointer = '\0';
-		}
+		DB_SetUserIP(user->user, ent->client->sess.ip);
 	}
 
 	// set up for alias tracking
-	memset(&user->currentAlias, 0, sizeof(user->currentAlias));
+	alias = DB_BUFFERALIAS(user);
+	memset(alias, 0, sizeof(db_alias_t));
 
 	// check if the player is muted and if the name must be forced from the database, this will prevent forcing names from
 	// the etmain profile (or whatever profile player has before connecting)
@@ -2440,16 +3687,17 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 		// since the name string always includes the NUL, we ensure it also in here
 		data->name[MAX_NAME_LENGTH-1] = '\0';
 		// the sanitized name
-		Q_strncpyz(data->sanitized_name, G_DB_SanitizeName(ent->client->pers.netname), MAX_NAME_LENGTH);
+		DB_SetSanitizedName(user->user, ent->client->pers.netname);
 		// the alias data
-		user->currentAlias.first_seen = level.realtime;
-		user->currentAlias.last_seen = level.realtime;
-		user->currentAlias.time_played = 0;
-		memcpy(user->currentAlias.name, data->name, sizeof(user->currentAlias.name));
-		Q_strncpyz(user->currentAlias.clean_name, data->sanitized_name, sizeof(user->currentAlias.clean_name));
+		alias->first_seen = level.realtime;
+		alias->last_seen = level.realtime;
+		alias->time_played = 0;
+		memcpy(alias->name, data->name, sizeof(alias->name));
+		Q_strncpyz(alias->clean_name, data->sanitized_name, sizeof(alias->clean_name));
 	}
 
-	user->flags |= SIL_DBUSERFLAG_CONNECTED; // connect user
+	DB_SetNodeConnected(user, qtrue); // connect user
+	client_nodes[ent-g_entities] = user;
 	user->flags |= SIL_DBUSERFLAG_FULLINIT; // note that the player stats can be updated
 
 	// admin protection
@@ -2478,6 +3726,7 @@ void G_DB_ClientConnect(gentity_t *ent, char* pb_guid)
 	}
 	// set the time, we don't want to lose users just yet (invoke truncates for users that have not played)
 	user->user->user.time = t;
+	DB_ScheduleExpiry(user->user);
 }
 
 /**
@@ -2491,39 +3740,35 @@ void G_DB_SetClientName(gentity_t *ent)
 	g_shrubbot_buffered_users_t* user = NULL;
 	g_shrubbot_user_f_t *data;
 	db_alias_t	*alias;
-	uint32_t guidHash;
-	uint32_t i;
-	char guid[32];
+	db_guid_t guid;
 
 	if( g_clientSInfos[ent-g_entities].userData ) {
 		data = (g_shrubbot_user_f_t*)g_clientSInfos[ent-g_entities].userData;
 		alias = (db_alias_t*)g_clientSInfos[ent-g_entities].alias;
 	} else {
-		for( i=0; i < 32 && ent->client->sess.guid[i] ; i++) {
-			guid[i] = toupper(ent->client->sess.guid[i]);
-		}
-
-		if( i != 32 ) {
-			return;
-		}
+		user = client_nodes[ent-g_entities];
 
-		guidHash = BG_hashword((const uint32_t*)guid, 8, 0);
+		if( !user ) {
+			if( !G_DB_GUID_Set(&guid, ent->client->sess.guid) ) {
+				return;
+			}
 
-		user = DB_GetUserNode(guidHash, guid);
+			user = DB_GetUserNode(guid.hash, guid.guid);
 
-		if( !user ) {
-			return;
+			if( !user ) {
+				return;
+			}
 		}
 
 		data = &user->user->user;
-		alias = &user->currentAlias;
+		alias = DB_BUFFERALIAS(user);
 	}
 
 	if( ent->client->pers.netname[0] ) {
 		if( alias && alias->clean_name[0] ) {
 			alias->last_seen = level.realtime;
 			alias->time_played = alias->last_seen - alias->first_seen;
-			G_DB_UpdateAlias(data->sil_guid, alias, data->guidHash);
+			G_DB_UpdateClientAlias(ent-g_entities, data->sil_guid, alias, data->guidHash);
 		}
 
 		// copy the name if any, we don't have names for clients before the userinfo has changed at least once
@@ -2533,7 +3778,7 @@ void G_DB_SetClientName(gentity_t *ent)
 		data->name[MAX_NAME_LENGTH-1] = '\0';
 
 		// the sanitized name
-		Q_strncpyz(data->sanitized_name, G_DB_SanitizeName(ent->client->pers.netname), MAX_NAME_LENGTH);
+		DB_SetSanitizedName(DB_USERCACHE(data), ent->client->pers.netname);
 
 		// alias handling
 		alias->first_seen = level.realtime;
@@ -2592,13 +3837,25 @@ void G_DB_StoreCurrentAlias(gentity_t *ent)
 	if( alias->clean_name[0] ) {
 		alias->last_seen = level.realtime;
 		alias->time_played = alias->last_seen - alias->first_seen;
-		G_DB_UpdateAlias( ent->client->sess.guid, alias, 0);
+		if( client_guids[ent-g_entities].guid[0] ) {
+			G_DB_UpdateClientAlias(ent-g_entities, client_guids[ent-g_entities].guid, alias, client_guids[ent-g_entities].hash);
+		} else {
+			G_DB_UpdateClientAlias(ent-g_entities, ent->client->sess.guid, alias, 0);
+		}
 		// reset values so next update wont distort values
 		alias->first_seen = level.realtime;
 		alias->time_played = 0;
 	}
 }
 
+const db_guid_t* G_DB_GetClientGUID(gentity_t *ent)
+{
+	if( !client_guids[ent-g_entities].guid[0] ) {
+		return NULL;
+	}
+	return &client_guids[ent-g_entities];
+}
+
 void G_DB_SetClientGUIDValid(g_shrubbot_user_handle_t *handle)
 {
 	handle->user->ident_flags |= SIL_DBGUID_VALID;
@@ -2616,21 +3873,16 @@ char *G_DB_GetClientGUIDStub( gentity_t *ent )
 {
 	g_shrubbot_buffered_users_t* user=NULL;
 	g_shrubbot_user_f_t *data;
-	uint32_t guidHash;
-	uint32_t i;
-	char guid[32];
+	db_guid_t guid;
 
 	if(g_clientSInfos[ent-g_entities].userData) {
 		data = (g_shrubbot_user_f_t*)g_clientSInfos[ent-g_entities].userData;
+	} else if(client_nodes[ent-g_entities]) {
+		data = &client_nodes[ent-g_entities]->user->user;
 	} else {
-		for(i=0; i < 32 && ent->client->sess.guid[i] ;i++) {
-			guid[i]=toupper(ent->client->sess.guid[i]);
-		}
-		if(i!=32) { return NULL; }
+		if(!G_DB_GUID_Set(&guid, ent->client->sess.guid)) { return NULL; }
 
-		guidHash=BG_hashword((const uint32_t*)guid, 8, 0);
-
-		user=DB_GetUserNode(guidHash, guid);
+		user=DB_GetUserNode(guid.hash, guid.guid);
 
 		if(!user) { return NULL; }
 
@@ -2648,29 +3900,32 @@ char *G_DB_GetClientGUIDStub( gentity_t *ent )
 void G_DB_ClientDisconnect(gentity_t *ent)
 {
 	g_shrubbot_buffered_users_t* user=NULL;
-	uint32_t guidHash;
-	uint32_t i;
-	char guid[32];
+	db_alias_t *alias;
+	db_guid_t guid;
 	time_t t;
 
 	Sil_ClearAdminProtect( ent );
 
-	for(i=0; i < 32 && ent->client->sess.guid[i] ;i++) {
-		guid[i]=toupper(ent->client->sess.guid[i]);
-	}
-	if(i!=32) { return; }
+	// the slot is known for the clients that connected normally
+	user = client_nodes[ent-g_entities];
+	client_nodes[ent-g_entities] = NULL;
 
-	guidHash=BG_hashword((const uint32_t*)guid, 8, 0);
+	if( !user ) {
+		if( !G_DB_GUID_Set(&guid, ent->client->sess.guid) ) { return; }
 
-	user=DB_GetUserNode(guidHash, guid);
+		user=DB_GetUserNode(guid.hash, guid.guid);
+	}
+	memset(&client_guids[ent-g_entities], 0, sizeof(db_guid_t));
+	memset(&search_sessions[ent-g_entities], 0, sizeof(db_searchsession_t));
 
 	if( !user ) {
+		G_DB_ClearClientAlias(ent-g_entities);
 		// it is not certain that disconnecting client is found from the database.
 		// Their guids get confirmed only after they begin, and if dropped before, they are not usable
 		return;
 	}
 
-	user->flags&=(~SIL_DBUSERFLAG_CONNECTED); // disconnect user
+	DB_SetNodeConnected(user, qfalse); // disconnect user
 
 	// store for keeping in case of reconnect
 	user->panzerSelfKills = ent->client->pers.panzerSelfKills;
@@ -2683,11 +3938,13 @@ void G_DB_ClientDisconnect(gentity_t *ent)
 	user->deaths = 0;
 
 	// aliases
-	if( user->currentAlias.clean_name[0] ) {
-		user->currentAlias.last_seen = level.realtime;
-		user->currentAlias.time_played = user->currentAlias.last_seen - user->currentAlias.first_seen;
-		G_DB_UpdateAlias(user->user->user.sil_guid, &user->currentAlias, user->user->user.guidHash);
+	alias = DB_BUFFERALIAS(user);
+	if( alias->clean_name[0] ) {
+		alias->last_seen = level.realtime;
+		alias->time_played = alias->last_seen - alias->first_seen;
+		G_DB_UpdateClientAlias(ent-g_entities, user->user->user.sil_guid, alias, user->user->user.guidHash);
 	}
+	G_DB_ClearClientAlias(ent-g_entities);
 
 	if(!time(&t)) {
 		return;
@@ -2706,6 +3963,10 @@ int G_DB_SetClientIdent(gentity_t *ent, uint8_t *ident, uint8_t identLength)
 	}
 	// casting the const away
 	data = (g_shrubbot_user_f_t*)g_clientSInfos[ent-g_entities].userData;
+	if( identLength > SIL_DB_IDENT_LENGTH ) {
+		identLength = SIL_DB_IDENT_LENGTH;
+	}
+	DB_UnindexUser(DB_USERCACHE(data));
 	memcpy(data->ident, ident, identLength);
 	if( identLength < SIL_DB_IDENT_LENGTH ) {
 		data->ident_flags |= SIL_DBIDENTFLAG_SHORT;
@@ -2714,6 +3975,7 @@ int G_DB_SetClientIdent(gentity_t *ent, uint8_t *ident, uint8_t identLength)
 	}
 	// only valid idents are stored but this is the easiest way to know it
 	data->ident_flags |= SIL_DBIDENTFLAG_VALID;
+	DB_IndexUser(DB_USERCACHE(data));
 	return 0;
 }
 
@@ -2724,23 +3986,20 @@ int G_DB_SetClientIdent(gentity_t *ent, uint8_t *ident, uint8_t identLength)
 */
 void G_DB_ValidateClientIdentStringForUse( char *identStr )
 {
-	qboolean exclude = qfalse;
+	uint8_t ident[SIL_DB_IDENT_LENGTH];
+	uint32_t length;
 
-	if( strlen( identStr ) == SIL_DB_IDENTSTRING_LENGTH ) {
-		// bad ident from 0.6.0, this can come from valid data also, but i suppose it is rare enough
-		if( !Q_stricmpn(identStr, "0000000023C34600", SIL_DB_IDENTSTRING_LENGTH) ) {
-			exclude = qtrue;
-		}
-	} else {
-		// urgh, hard coding, actually I would like to make a config file where one could put all the MAC addresses that are unusable
-		if( !Q_stricmpn(identStr, "000C29", 6) ) {
-			exclude = qtrue;
-		} else if( !Q_stricmpn(identStr, "005056", 6) ) {
-			exclude = qtrue;
+	length = G_DB_Ident_FromString(identStr, ident, sizeof(ident));
+	// only the full length string is a full ident, the rest are handled as MAC addresses
+	if( strlen(identStr) == SIL_DB_IDENTSTRING_LENGTH ) {
+		if( length != SIL_DB_IDENT_LENGTH ) {
+			return;
 		}
+	} else if( length > SIL_DB_IDENT_MACLENGTH ) {
+		length = SIL_DB_IDENT_MACLENGTH;
 	}
 
-	if( exclude == qtrue ) {
+	if( G_DB_Ident_IsExcluded(ident, length) ) {
 		identStr[0] = '\0';
 	}
 }
@@ -2781,6 +4040,235 @@ void G_DB_GetClientIdentString(g_shrubbot_user_handle_t *handle, char *dest, uin
 	G_DB_ValidateClientIdentStringForUse(dest);
 }
 
+// adds the users sharing the key with the searched user to the alt account results
+static void DB_CollectAltAccounts(const db_hashindex_t *index, uint32_t hash, const g_shrubbot_usercache_t *searched, uint32_t shared)
+{
+	g_shrubbot_usercache_t *user;
+	uint32_t iterator;
+	uint32_t length;
+	uint32_t i;
+
+	for( user = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(index, hash, &iterator) ; user ;
+		user = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(index, hash, &iterator) ) {
+		if( user == searched || (!user->node && user->action == SIL_SHRUBBOT_DB_ACTION_REMOVE) ) {
+			continue;
+		}
+		if( searched->user.sil_guid[0] && G_DB_GUID_MatchesRaw(user->user.sil_guid, searched->user.sil_guid) ) {
+			// the same player
+			continue;
+		}
+		if( shared == SIL_DB_ALT_IDENT ) {
+			if( (user->user.ident_flags & SIL_DBIDENTFLAG_SHORT) != (searched->user.ident_flags & SIL_DBIDENTFLAG_SHORT) ) {
+				continue;
+			}
+			length = (user->user.ident_flags & SIL_DBIDENTFLAG_SHORT) ? SIL_DB_IDENT_MACLENGTH : SIL_DB_IDENT_LENGTH;
+			if( memcmp(user->user.ident, searched->user.ident, length) ) {
+				continue;
+			}
+		} else if( memcmp(&user->user.ip_addr, &searched->user.ip_addr, sizeof(db_ip_t)) ) {
+			continue;
+		}
+
+		for( i = 0; i < alt_count && alt_results[i] != user ; i++ ) {
+		}
+		if( i < alt_count ) {
+			alt_shared[i] |= shared;
+		} else if( alt_count < SIL_DB_MAXALTACCOUNTS ) {
+			alt_results[alt_count] = user;
+			alt_shared[alt_count] = shared;
+			alt_count++;
+		}
+	}
+}
+
+int G_DB_FindAltAccounts(const db_guid_t *guid, uint32_t match)
+{
+	g_shrubbot_usercache_t *user;
+	uint32_t hash;
+
+	alt_count = 0;
+
+	if( !db_users_info.usable ) {
+		return -1;
+	}
+
+	user = DB_FindIndexedUser(guid->hash, guid->guid);
+	if( !user ) {
+		return -1;
+	}
+
+	if( (match & SIL_DB_ALT_IDENT) && DB_UserIdentHash(user, &hash) ) {
+		DB_CollectAltAccounts(&ident_index, hash, user, SIL_DB_ALT_IDENT);
+	}
+	if( (match & SIL_DB_ALT_IP) && DB_UserIPHash(user, &hash) ) {
+		DB_CollectAltAccounts(&ipaddr_index, hash, user, SIL_DB_ALT_IP);
+	}
+
+	return alt_count;
+}
+
+qboolean G_DB_GetAltAccount(uint32_t position, g_shrubbot_user_handle_t *handle, uint32_t *shared)
+{
+	if( position >= alt_count || !handle ) {
+		return qfalse;
+	}
+
+	DB_FillUserHandle(alt_results[position], handle);
+	if( shared ) {
+		*shared = alt_shared[position];
+	}
+
+	return qtrue;
+}
+
+//
+// Builds the leaderboards if needed and moves the buffered users by their current values, the game
+// changes the values of the connected players directly.
+static qboolean DB_PrepareBoards(void)
+{
+	uint32_t i;
+
+	if( !boards_usable ) {
+		DB_FreeBoards();
+		boards_usable = qtrue;
+		for( i = 0; i < usercount_onmemory && boards_usable ; i++ ) {
+			DB_SyncUserBoards(&user_cache[i]);
+		}
+		if( !boards_usable ) {
+			G_LogPrintf("Leaderboards could not be built, out of memory.\n");
+			DB_FreeBoards();
+			return qfalse;
+		}
+	}
+
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		DB_SyncUserBoards(DB_BUFFERNODE(i)->user);
+	}
+
+	return boards_usable;
+}
+
+int G_DB_GetLeaderboard(int board, uint32_t rank, uint32_t count)
+{
+	uint32_t ids[SIL_DB_MAXBOARDPAGE];
+	uint32_t i;
+
+	board_count = 0;
+
+	if( !db_users_info.usable || board < 0 || board >= SIL_DB_BOARDS || !DB_PrepareBoards() ) {
+		return -1;
+	}
+
+	if( count > SIL_DB_MAXBOARDPAGE ) {
+		count = SIL_DB_MAXBOARDPAGE;
+	}
+	board_first = rank ? rank : 1;
+	board_count = G_DB_SkipList_Range(&boards[board], board_first, ids, board_scores, count);
+	for( i = 0; i < board_count ; i++ ) {
+		board_results[i] = DB_BoardUser(ids[i]);
+	}
+
+	return (int)board_count;
+}
+
+qboolean G_DB_GetLeaderboardUser(uint32_t position, g_shrubbot_user_handle_t *handle, uint32_t *rank, float *score)
+{
+	if( position >= board_count || !handle ) {
+		return qfalse;
+	}
+
+	DB_FillUserHandle(board_results[position], handle);
+	if( rank ) {
+		*rank = board_first + position;
+	}
+	if( score ) {
+		*score = board_scores[position];
+	}
+
+	return qtrue;
+}
+
+int G_DB_GetLeaderboardRank(int board, const db_guid_t *guid, uint32_t *ranked)
+{
+	g_shrubbot_usercache_t *user;
+	uint32_t id;
+
+	if( !db_users_info.usable || board < 0 || board >= SIL_DB_BOARDS || !DB_PrepareBoards() ) {
+		return -1;
+	}
+
+	user = DB_FindIndexedUser(guid->hash, guid->guid);
+	if( !user || !DB_BoardId(user, &id) ) {
+		return -1;
+	}
+
+	if( ranked ) {
+		*ranked = boards[board].count;
+	}
+	return (int)G_DB_SkipList_Rank(&boards[board], id);
+}
+
+//
+// Adds the changed ratings of the buffered users to the rating sketch and rebuilds the sketch if
+// needed, the game changes the ratings of the connected players directly.
+static void DB_PrepareRatingSketch(void)
+{
+	uint32_t i;
+
+	for( i = 0; i < usercount_buffer && rating_sketch_usable ; i++ ) {
+		DB_SyncUserSketch(DB_BUFFERNODE(i)->user);
+	}
+	if( rating_sketch_usable ) {
+		return;
+	}
+
+	G_DB_Kll_Clear(&rating_sketch);
+	rating_sketch_stale = 0;
+	for( i = 0; i < usercount_onmemory ; i++ ) {
+		user_cache[i].sketched = qfalse;
+	}
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		DB_BUFFERNODE(i)->user->sketched = qfalse;
+	}
+
+	rating_sketch_usable = qtrue;
+	for( i = 0; i < usercount_onmemory ; i++ ) {
+		DB_SyncUserSketch(&user_cache[i]);
+	}
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		DB_SyncUserSketch(DB_BUFFERNODE(i)->user);
+	}
+}
+
+const db_kll_t* G_DB_GetRatingSketch(void)
+{
+	if( !db_users_info.usable ) {
+		return NULL;
+	}
+
+	DB_PrepareRatingSketch();
+
+	return &rating_sketch;
+}
+
+const db_kll_t* G_DB_GetConnectedRatingSketch(void)
+{
+	uint32_t i;
+
+	if( !db_users_info.usable ) {
+		return NULL;
+	}
+
+	G_DB_Kll_Clear(&connected_sketch);
+	for( i = 0; i < connected_count ; i++ ) {
+		if( DB_IsRated(&partitioned_nodes[i]->user->user) ) {
+			G_DB_Kll_Add(&connected_sketch, partitioned_nodes[i]->user->user.rating);
+		}
+	}
+
+	return &connected_sketch;
+}
+
 void G_DB_SetMuteData(gentity_t *ent, const char *reason, const char * mutedby)
 {
 	g_shrubbot_userextra_f_t *userExt;
@@ -2816,6 +4304,7 @@ void G_DB_SetMuteData(gentity_t *ent, const char *reason, const char * mutedby)
 
 	// don't lose this stuff during intermission/warmup
 	user->mutetime = ent->client->sess.auto_unmute_time;
+	DB_ScheduleMute(userExt, user->mutetime);
 }
 
 g_shrubbot_mutedata_t* G_DB_GetMuteData(gentity_t *ent)
@@ -2878,37 +4367,23 @@ void G_DB_RemoveMuteData(gentity_t *ent)
 		// don't lose this stuff during intermission/warmup
 		((g_shrubbot_user_f_t*) g_clientSInfos[ent-g_entities].userData)->mutetime = 0;
 	}
+	DB_ScheduleMute(userExt, 0);
 }
 
 static qboolean G_DB_UserWithPBGUIDExists(uint32_t guidHash, const char* pbguid)
 {
-	g_shrubbot_buffered_users_t *node;
+	g_shrubbot_usercache_t *user;
 
-	node = DB_BufferedUserNodePB(guidHash, pbguid);
-	if( node ) {
-		if( !(node->user->action & SIL_SHRUBBOT_DB_ACTION_REMOVE) ) {
-			return qtrue;
-		} else {
-			// record is set to be removed so treated as non existent, only cold crash can prevent the delete
-			return qfalse;
-		}
-	} else {
-		int32_t users = usercount_onmemory;
-		int32_t i;
-
-		for(i=0; i < users ;i++) {
-			if( guidHash == user_cache[i].user.pbgHash && !Q_strncmp(user_cache[i].user.pb_guid, pbguid, SIL_SHRUBBOT_DB_GUIDLEN) ) {
-				if( user_cache[i].action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
-					// treat to be deleted record as nonexistent
-					return qfalse;
-				} else {
-					return qtrue;
-				}
-			}
-		}
+	user = DB_FindIndexedUserPB(guidHash, pbguid);
+	if( !user ) {
+		return qfalse;
+	}
+	if( user->action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+		// record is set to be removed so treated as non existent, only cold crash can prevent the delete
+		return qfalse;
 	}
 
-	return qfalse;
+	return qtrue;
 }
 
 int G_DB_UpdatePunkBusterGUID(gentity_t *ent)
@@ -2946,8 +4421,7 @@ int G_DB_UpdatePunkBusterGUID(gentity_t *ent)
 		return -2;
 	}
 
-	memcpy(data->pb_guid, guid, SIL_DB_KEYSIZE);
-	data->pbgHash = guidHash;
+	DB_SetUserPBGUID(DB_USERCACHE(data), guid, guidHash);
 
 	return 0;
 }
@@ -3043,48 +4517,33 @@ void G_DB_RefreshEntityPointers(void)
 }
 
 
-g_shrubbot_user_handle_t* G_DB_GetUserHandle(const char* guid)
+g_shrubbot_user_handle_t* G_DB_GetUserHandleGUID(const db_guid_t* guid)
 {
 	g_shrubbot_buffered_users_t *node=NULL;
-	uint32_t					guidHash;
-	uint32_t					i;
-	char guid_l[32];
 
-	for(i=0; i < 32 && guid[i] ;i++) {
-		guid_l[i]=toupper(guid[i]);
-	}
-	if(i!=32) { return NULL; }
-
-	guidHash=BG_hashword((const uint32_t*)guid_l, 8, 0);
-
-	node=DB_GetUserNode(guidHash, guid_l);
+	node=DB_GetUserNode(guid->hash, guid->guid);
 
 	if(!node) { return NULL; }
 
-	//handle=(g_shrubbot_user_handle_t*)malloc(sizeof(g_shrubbot_user_handle_t));
-
-	//if(!handle) { return NULL; }
-
 	DB_FillHandle(node, &handle_out);
 
 	return &handle_out;
 }
 
-g_shrubbot_user_handle_t* G_DB_GetUserHandlePB(const char* guid)
+g_shrubbot_user_handle_t* G_DB_GetUserHandle(const char* guid)
 {
-	g_shrubbot_buffered_users_t *node=NULL;
-	uint32_t					i;
-	uint32_t					guidHash;
-	char guid_l[32];
+	db_guid_t guid_l;
 
-	for(i=0; i < 32 && guid[i] ;i++) {
-		guid_l[i]=toupper(guid[i]);
-	}
-	if(i!=32) { return NULL; }
+	if(!G_DB_GUID_Set(&guid_l, guid)) { return NULL; }
 
-	guidHash = BG_hashword((const uint32_t*)guid_l, 8, 0);
+	return G_DB_GetUserHandleGUID(&guid_l);
+}
 
-	node=DB_GetUserNodePB(guidHash, guid_l);
+g_shrubbot_user_handle_t* G_DB_GetUserHandlePBGUID(const db_guid_t* guid)
+{
+	g_shrubbot_buffered_users_t *node=NULL;
+
+	node=DB_GetUserNodePB(guid->hash, guid->guid);
 
 	if(!node) { return NULL; }
 
@@ -3093,6 +4552,15 @@ g_shrubbot_user_handle_t* G_DB_GetUserHandlePB(const char* guid)
 	return &handle_out;
 }
 
+g_shrubbot_user_handle_t* G_DB_GetUserHandlePB(const char* guid)
+{
+	db_guid_t guid_l;
+
+	if(!G_DB_GUID_Set(&guid_l, guid)) { return NULL; }
+
+	return G_DB_GetUserHandlePBGUID(&guid_l);
+}
+
 g_shrubbot_user_handle_t* G_DB_GetUserHandleWithoutBuffering(const char* guid)
 {
 	g_shrubbot_user_f_t			*node = NULL;
@@ -3177,22 +4645,13 @@ g_shrubbot_user_handle_t* G_DB_CreateUserRecord(const char* sil_guid, const char
 	return &handle_out;
 }
 
-qboolean G_DB_GetUserHandleLocal(const char* guid, g_shrubbot_user_handle_t* handle)
+qboolean G_DB_GetUserHandleLocalGUID(const db_guid_t* guid, g_shrubbot_user_handle_t* handle)
 {
 	g_shrubbot_buffered_users_t *node=NULL;
-	uint32_t					guidHash;
-	uint32_t					i;
-	char guid_l[32];
 
-	for(i=0; i < 32 && guid[i] ;i++) {
-		guid_l[i]=toupper(guid[i]);
-	}
-	if(i!=32) { return qfalse; }
 	if(!handle) { return qfalse; }
 
-	guidHash=BG_hashword((const uint32_t*)guid_l, 8, 0);
-
-	node=DB_GetUserNode(guidHash, guid_l);
+	node=DB_GetUserNode(guid->hash, guid->guid);
 
 	if(!node) { return qfalse; }
 
@@ -3201,80 +4660,65 @@ qboolean G_DB_GetUserHandleLocal(const char* guid, g_shrubbot_user_handle_t* han
 	return qtrue;
 }
 
-// We're not too concerned of the performance of this command.
-// It's only available to high admins and they use it for maintenance only
+qboolean G_DB_GetUserHandleLocal(const char* guid, g_shrubbot_user_handle_t* handle)
+{
+	db_guid_t guid_l;
+
+	if(!G_DB_GUID_Set(&guid_l, guid)) { return qfalse; }
+
+	return G_DB_GetUserHandleLocalGUID(&guid_l, handle);
+}
+
 g_shrubbot_user_handle_t* G_DB_GetUserHandleUserID(const char* userid)
 {
-	g_shrubbot_buffered_users_t *node=user_buffer;
-	uint32_t					users=0, i=0;
-	// loop through buffered
-	while(node) {
-		if(!Q_stricmpn(userid, node->user->userid, SIL_SHRUBBOT_USERID_SIZE)) {
-			break;
-		}
-		node=node->next;
-	}
-	if(node) {
-		//handle=(g_shrubbot_user_handle_t*)malloc(sizeof(g_shrubbot_user_handle_t));
-		//if(!handle) { return NULL; }
-		DB_FillHandle(node, &handle_out);
-		return &handle_out;
+	g_shrubbot_usercache_t *user;
+
+	user = DB_FindUserByShortID(userid, SIL_DB_SHORTID_SKIPREMOVED, NULL);
+	if( !user ) {
+		return NULL;
 	}
-	// loop through memorycache
-	users=usercount_onmemory;
-	for(i=0; i<users ;i++) {
-		if(DB_IsRemoved(i)) {
-			continue;
-		}
-		if(!Q_stricmpn(user_cache[i].userid, userid, SIL_SHRUBBOT_USERID_SIZE)) {
-			//handle=(g_shrubbot_user_handle_t*)malloc(sizeof(g_shrubbot_user_handle_t));
-			handle_out.flags = SIL_DBUSERFLAG_CACHED;
-			handle_out.node = (void*)&user_cache[i];
-			handle_out.user = &user_cache[i].user;
-			handle_out.userid = &user_cache[i].user.sil_guid[24];
-			handle_out.shortPBGUID = &user_cache[i].user.pb_guid[24];
-			return &handle_out;
-		}
+	if( user->node ) {
+		DB_FillHandle(user->node, &handle_out);
+	} else {
+		DB_FillHandleFromFileRecord(&user->user, &handle_out);
 	}
 
-	return NULL;
+	return &handle_out;
+}
+
+int G_DB_GetUserIDMatches(const char* userid)
+{
+	int matches;
+
+	DB_FindUserByShortID(userid, SIL_DB_SHORTID_SKIPREMOVED, &matches);
+
+	return matches;
+}
+
+int G_DB_GetUserIDMatchesPB(const char* userid)
+{
+	int matches;
+
+	DB_FindUserByShortID(userid, SIL_DB_SHORTID_PB | SIL_DB_SHORTID_SKIPREMOVED, &matches);
+
+	return matches;
 }
 
 g_shrubbot_user_handle_t* G_DB_GetUserHandleUserIDPB(const char* userid)
 {
-	g_shrubbot_buffered_users_t *node=user_buffer;
-	uint32_t					users=0, i=0;
-	// loop through buffered
-	while(node) {
-		if( !Q_stricmpn(userid, node->user->shortPBGUID, SIL_SHRUBBOT_USERID_SIZE) ) {
-			break;
-		}
-		node=node->next;
-	}
-	if(node) {
-		//handle=(g_shrubbot_user_handle_t*)malloc(sizeof(g_shrubbot_user_handle_t));
-		//if(!handle) { return NULL; }
-		DB_FillHandle(node, &handle_out);
-		return &handle_out;
+	g_shrubbot_usercache_t *user;
+
+	user = DB_FindUserByShortID(userid, SIL_DB_SHORTID_PB | SIL_DB_SHORTID_SKIPREMOVED, NULL);
+	if( !user ) {
+		return NULL;
 	}
-	// loop through memorycache
-	users=usercount_onmemory;
-	for(i=0; i<users ;i++) {
-		if(DB_IsRemoved(i)) {
-			continue;
-		}
-		if( !Q_stricmpn(user_cache[i].shortPBGUID, userid, SIL_SHRUBBOT_USERID_SIZE) ) {
-			//handle=(g_shrubbot_user_handle_t*)malloc(sizeof(g_shrubbot_user_handle_t));
-			handle_out.flags = SIL_DBUSERFLAG_CACHED;
-			handle_out.node = (void*)&user_cache[i];
-			handle_out.user = &user_cache[i].user;
-			handle_out.userid = &user_cache[i].user.sil_guid[24];
-			handle_out.shortPBGUID = &user_cache[i].user.pb_guid[24];
-			return &handle_out;
-		}
+	if( user->node ) {
+		DB_FillHandle(user->node, &handle_out);
+	} else {
+		DB_FillHandleFromFileRecord(&user->user, &handle_out);
 	}
 
-	return NULL;
+	return &handle_out;
 }
 
 void G_DB_FreeUserHandle(g_shrubbot_user_handle_t *handle)
@@ -3319,74 +4763,55 @@ void G_DB_UpdateFromHandle(g_shrubbot_user_handle_t* handle, qboolean freehandle
 //  Buffer iteration for disconnected or connected clients
 //
 
-static qboolean DB_DisconnectedNext(g_shrubbot_buffered_users_t *users, g_shrubbot_user_handle_t* handle)
+void G_DB_IterateConnected(g_shrubbot_user_iterator_t *iterator)
 {
-	while(users) {
-		if(!(users->flags & SIL_DBUSERFLAG_CONNECTED)) {
-			break;
-		}
-		users=users->next;
-	}
-
-	if(users && handle) {
-		DB_FillHandle(users,handle);
-		return qtrue;
-	}
+	iterator->position = 0;
+	iterator->connected = qtrue;
+}
 
-	return qfalse;
+void G_DB_IterateDisconnected(g_shrubbot_user_iterator_t *iterator)
+{
+	iterator->position = 0;
+	iterator->connected = qfalse;
 }
 
-static qboolean DB_ConnectedNext(g_shrubbot_buffered_users_t *users, g_shrubbot_user_handle_t* handle)
+qboolean G_DB_IteratorNext(g_shrubbot_user_iterator_t *iterator, g_shrubbot_user_handle_t *handle)
 {
-	while(users) {
-		if(users->flags & SIL_DBUSERFLAG_CONNECTED) {
-			break;
-		}
-		users=users->next;
-	}
+	uint32_t first = iterator->connected ? 0 : connected_count;
+	uint32_t end = iterator->connected ? connected_count : usercount_buffer;
 
-	if(users && handle) {
-		DB_FillHandle(users,handle);
-		return qtrue;
+	if( !handle || first + iterator->position >= end ) {
+		return qfalse;
 	}
 
-	return qfalse;
+	DB_FillHandle(partitioned_nodes[first + iterator->position], handle);
+	iterator->position++;
+
+	return qtrue;
 }
 
 qboolean G_DB_GetFirstDisconnected(g_shrubbot_user_handle_t* handle)
 {
-	disconnected_iterator=user_buffer;
+	G_DB_IterateDisconnected(&buffer_user_iterator);
 
-	return DB_DisconnectedNext(disconnected_iterator,handle);
+	return G_DB_IteratorNext(&buffer_user_iterator, handle);
 }
 
 qboolean G_DB_GetNextDisconnected(g_shrubbot_user_handle_t* handle)
 {
-	if(disconnected_iterator!=NULL) {
-		disconnected_iterator=disconnected_iterator->next;
-	} else {
-		return qfalse;
-	}
-
-	return DB_DisconnectedNext(disconnected_iterator,handle);
+	return G_DB_IteratorNext(&buffer_user_iterator, handle);
 }
 
 qboolean G_DB_GetFirstConnected(g_shrubbot_user_handle_t* handle)
 {
-	disconnected_iterator=user_buffer;
+	G_DB_IterateConnected(&buffer_user_iterator);
 
-	return DB_ConnectedNext(disconnected_iterator,handle);
+	return G_DB_IteratorNext(&buffer_user_iterator, handle);
 }
 
 qboolean G_DB_GetNextConnected(g_shrubbot_user_handle_t* handle)
 {
-	if(disconnected_iterator!=NULL) {
-		disconnected_iterator=disconnected_iterator->next;
-	} else {
-		return qfalse;
-	}
-
-	return DB_ConnectedNext(disconnected_iterator,handle);
+	return G_DB_IteratorNext(&buffer_user_iterator, handle);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3415,6 +4840,10 @@ void G_DB_SaveShrubbotUser(g_shrubbot_user_handle_t* handle)
 		return;
 	}
 
+	DB_SyncUserLevel(user);
+	DB_SyncUserBoards(user);
+	DB_SyncUserSketch(user);
+
 	// to make sure we don't interfere with the XP save, we need to store the current XP and save
 	// the node with what it would be if the user would get XP reseted and then restore the XP
 	// data to user. I'm leaving this undone. Reason: I don't relly care much about XP
@@ -3430,43 +4859,31 @@ void G_DB_SaveShrubbotUser(g_shrubbot_user_handle_t* handle)
 
 qboolean G_DB_ResetPlayerStats(const char *guid_short)
 {
-	g_shrubbot_buffered_users_t *users_b=user_buffer;
-	uint32_t i,users;
+	g_shrubbot_usercache_t *user;
 
 	if(db_users_info.usable==qfalse) {
 		return qfalse;
 	}
 
-	// buffered
-	while(users_b) {
-		if(!memcmp(users_b->user->userid,guid_short,SIL_SHRUBBOT_USERID_SIZE)) {
-			users_b->user->user.rating_variance=SIGMA2_THETA;
-			users_b->user->user.rating=0.0f;
-			users_b->user->user.kill_variance=SIGMA2_DELTA;
-			users_b->user->user.kill_rating=0.0f;
-			users_b->user->user.deaths=0;
-			users_b->user->user.kills=0;
-			return qtrue;
-		}
-		users_b=users_b->next;
+	user = DB_FindUserByShortID(guid_short, SIL_DB_SHORTID_EXACTCASE, NULL);
+	if( !user ) {
+		return qfalse;
 	}
 
-	// loop through memorycache
-	users=usercount_onmemory;
-	for(i=0; i<users ;i++) {
-		if(!memcmp(user_cache[i].userid,guid_short,SIL_SHRUBBOT_USERID_SIZE)) {
-			user_cache[i].user.rating_variance=SIGMA2_THETA;
-			user_cache[i].user.rating=0.0f;
-			user_cache[i].user.kill_variance=SIGMA2_DELTA;
-			user_cache[i].user.kill_rating=0.0f;
-			user_cache[i].user.deaths=0;
-			user_cache[i].user.kills=0;
-			db_users_info.truncate=qtrue;
-			return qtrue;
-		}
+	user->user.rating_variance=SIGMA2_THETA;
+	user->user.rating=0.0f;
+	user->user.kill_variance=SIGMA2_DELTA;
+	user->user.kill_rating=0.0f;
+	user->user.deaths=0;
+	user->user.kills=0;
+	DB_SyncUserBoards(user);
+	DB_SyncUserSketch(user);
+	if( !user->node ) {
+		// buffered ones get saved anyway
+		db_users_info.truncate=qtrue;
 	}
 
-	return qfalse;
+	return qtrue;
 }
 
 //
@@ -3475,9 +4892,10 @@ qboolean G_DB_ResetPlayerStats(const char *guid_short)
 // Function is safe to be called even if there isn't usable DB
 void G_DB_ResetXPValuesBuffer(void)
 {
-	g_shrubbot_buffered_users_t *users=user_buffer;
+	g_shrubbot_buffered_users_t *users;
 	g_shrubbot_usercache_t usercache;
 	g_shrubbot_user_f_t *user; // just one more user named variable
+	uint32_t j;
 	int i;
 
 	if(!db_users_info.usable) {
@@ -3486,7 +4904,8 @@ void G_DB_ResetXPValuesBuffer(void)
 
 	G_DB_File_Open(&db_users_info.db_file, DB_USERS_FILENAME, DB_FILEMODE_READ);
 
-	while(users) {
+	for(j=0; j<usercount_buffer ;j++) {
+		users=DB_BUFFERNODE(j);
 		user=&users->user->user;
 		users->hits=0;
 		users->team_hits=0;
@@ -3520,7 +4939,6 @@ void G_DB_ResetXPValuesBuffer(void)
 				user->skill[i]=0;
 			}
 		}
-		users=users->next;
 	}
 
 	// again safe to be called anytime
@@ -3532,7 +4950,8 @@ void G_DB_ResetXPValuesBuffer(void)
 // Function is safe to be called even if there isn't usable DB
 void G_DB_ResetXPRatingAll(void)
 {
-	g_shrubbot_buffered_users_t *users=user_buffer;
+	g_shrubbot_buffered_users_t *users;
+	uint32_t j;
 	int cachesz,i;
 
 	// on memory cache
@@ -3545,16 +4964,19 @@ void G_DB_ResetXPRatingAll(void)
 	}
 
 	// buffer instances that are not in cache
-	while(users) {
+	for(j=0; j<usercount_buffer ;j++) {
+		users=DB_BUFFERNODE(j);
 		if(users->memoryIndex==-1) {
 			users->user->user.kill_rating=0.0f;
 			users->user->user.kill_variance=SIGMA2_DELTA;
 			users->user->user.rating=0.0f;
 			users->user->user.rating_variance=SIGMA2_THETA;
 		}
-		users=users->next;
 	}
 	// the file must be written for the updates to take effect on offline players
+	// every score changes, the leaderboards and the rating sketch are rebuilt by the next query
+	DB_FreeBoards();
+	rating_sketch_usable = qfalse;
 	db_users_info.truncate=qtrue;
 }
 
@@ -3563,8 +4985,9 @@ void G_DB_ResetXPRatingAll(void)
 // Function is safe to be called even if there isn't usable DB
 void G_DB_ResetXPAll(void)
 {
-	g_shrubbot_buffered_users_t *users=user_buffer;
-	int cachesz, i; //,j;
+	g_shrubbot_buffered_users_t *users;
+	uint32_t j;
+	int cachesz, i;
 
 	// on memory cache
 	cachesz=usercount_onmemory;
@@ -3576,7 +4999,8 @@ void G_DB_ResetXPAll(void)
 	}
 
 	// buffer instances that are not in cache
-	while(users) {
+	for(j=0; j<usercount_buffer ;j++) {
+		users=DB_BUFFERNODE(j);
 		users->hits=0;
 		users->team_hits=0;
 		users->allies_time=0;
@@ -3589,8 +5013,9 @@ void G_DB_ResetXPAll(void)
 			//	users->user->user.skill[j] = 0.0f;
 			//}
 		}
-		users=users->next;
 	}
+	// every score changes, the leaderboards are rebuilt by the next query
+	DB_FreeBoards();
 	db_users_info.truncate=qtrue;
 }
 
@@ -3598,7 +5023,7 @@ void G_DB_ResetXPAll(void)
 // Reset the stored total stats for all users. Not the session specifics.
 void G_DB_ResetStatsAll(void)
 {
-	g_shrubbot_buffered_users_t *users=user_buffer;
+	uint32_t j;
 	int cachesz,i;
 
 	// on memory cache
@@ -3609,11 +5034,12 @@ void G_DB_ResetStatsAll(void)
 	}
 
 	// buffer instances that are not in cache
-	while(users) {
-		users->user->user.kills=0;
-		users->user->user.deaths=0;
-		users=users->next;
+	for(j=0; j<usercount_buffer ;j++) {
+		DB_BUFFERNODE(j)->user->user.kills=0;
+		DB_BUFFERNODE(j)->user->user.deaths=0;
 	}
+	// every score changes, the leaderboards are rebuilt by the next query
+	DB_FreeBoards();
 	db_users_info.truncate=qtrue;
 }
 
@@ -3642,7 +5068,7 @@ qboolean G_DB_SetIterator(uint32_t start)
 {
 	uint32_t pos = 1;
 
-	buffer_iterator = user_buffer;
+	buffer_iterator = 0;
 	cache_iterator = 0;
 
 	if( start == 0 ) {
@@ -3651,9 +5077,18 @@ qboolean G_DB_SetIterator(uint32_t start)
 
 	// skip the buffer if we can
 	if( start > usercount_buffer ) {
+		if( !listing_index_usable ) {
+			listing_index_usable = (G_DB_Fenwick_Build(&listing_index, usercount_onmemory, DB_IsListed, NULL) == 0) ? qtrue : qfalse;
+		}
+		buffer_iterator = usercount_buffer;
+		if( listing_index_usable ) {
+			// the listed cache records are counted, the position is found directly
+			cache_iterator = G_DB_Fenwick_Find(&listing_index, start - usercount_buffer);
+			return (cache_iterator < usercount_onmemory) ? qtrue : qfalse;
+		}
+
 		// the cache needs to be iterated, there are so many skip possibilities
 		pos += usercount_buffer;
-		buffer_iterator = NULL;
 		if( (start - usercount_onlybuffer) > usercount_onmemory ) {
 			return qfalse; // out of bounds return, from now on we wont list empty pages
 		}
@@ -3673,12 +5108,9 @@ qboolean G_DB_SetIterator(uint32_t start)
 			return qtrue;
 		}
 	} else {
-		// it's in the buffer
-		while( (pos < start) && buffer_iterator ) {
-			buffer_iterator = buffer_iterator->next;
-			pos++;
-		}
-		if( buffer_iterator ) {
+		// it's in the buffer, the table is indexed directly
+		buffer_iterator = start - pos;
+		if( buffer_iterator < usercount_buffer ) {
 			return qtrue;
 		}
 	}
@@ -3688,9 +5120,9 @@ qboolean G_DB_SetIterator(uint32_t start)
 
 qboolean G_DB_GetIteratedUser(g_shrubbot_user_handle_t *handle)
 {
-	if(buffer_iterator) {
-		DB_FillHandle(buffer_iterator,handle);
-		buffer_iterator=buffer_iterator->next;
+	if(buffer_iterator < usercount_buffer) {
+		DB_FillHandle(DB_BUFFERNODE(buffer_iterator),handle);
+		buffer_iterator++;
 		return qtrue;
 	} else {
 		while(cache_iterator < usercount_onmemory && (DB_IsInBuffer(cache_iterator) || DB_IsRemoved(cache_iterator))) {
@@ -3712,103 +5144,93 @@ qboolean G_DB_GetIteratedUser(g_shrubbot_user_handle_t *handle)
 
 qboolean G_DB_DeleteUser(const char *guid_short)
 {
-	g_shrubbot_buffered_users_t *users_b=user_buffer;
 	g_shrubbot_userextras_appendbuffer_t *appends = append_buffer;
 	g_shrubbot_userextras_cache_t *extra=NULL;
-	uint32_t i,users;
+	g_shrubbot_usercache_t *user;
 
 	if(db_users_info.usable==qfalse) {
 		return qfalse;
 	}
 
-	// buffered
-	while(users_b) {
-		if(!memcmp(users_b->user->userid, guid_short, SIL_SHRUBBOT_USERID_SIZE)) {
-			users_b->user->action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			while(appends) {
-				if(!Q_stricmpn(appends->user->sil_guid, users_b->user->user.sil_guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
-					appends->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
-					break;
-				}
-				appends = appends->next;
-			}
-			db_users_info.truncate=qtrue;
-			// aliases
-			G_DB_RemoveAliases(users_b->user->user.sil_guid, users_b->user->user.guidHash);
-			return qtrue;
-		}
-		users_b=users_b->next;
+	user = DB_FindUserByShortID(guid_short, SIL_DB_SHORTID_EXACTCASE, NULL);
+	if( !user ) {
+		return qfalse;
 	}
 
-	// loop through memorycache
-	users=usercount_onmemory;
-	for(i=0; i<users ;i++) {
-		if(!memcmp(user_cache[i].userid,guid_short,SIL_SHRUBBOT_USERID_SIZE)) {
-			user_cache[i].action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			extra = DB_FindExtrasCacheData(user_cache[i].user.sil_guid);
-			if(extra) {
-				extra->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+	user->action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
+	if( user->node ) {
+		// buffered
+		while(appends) {
+			if(!Q_stricmpn(appends->user->sil_guid, user->user.sil_guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
+				appends->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+				break;
 			}
-			db_users_info.truncate=qtrue;
-			// aliases
-			G_DB_RemoveAliases(user_cache[i].user.sil_guid, user_cache[i].user.guidHash);
-			return qtrue;
+			appends = appends->next;
+		}
+	} else {
+		extra = DB_FindExtrasCacheData(user->user.sil_guid);
+		if(extra) {
+			extra->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
 		}
 	}
+	db_users_info.truncate=qtrue;
+	DB_SyncUserBoards(user);
+	DB_SyncUserSketch(user);
+	DB_SyncUserListed(user);
+	search_epoch++;
+	// aliases
+	G_DB_RemoveAliases(user->user.sil_guid, user->user.guidHash);
 
-	return qfalse;
+	return qtrue;
 }
 
 qboolean G_DB_DeleteUserPB(const char *guid_short)
 {
-	g_shrubbot_buffered_users_t *users_b=user_buffer;
 	g_shrubbot_userextras_appendbuffer_t *appends = append_buffer;
 	g_shrubbot_userextras_cache_t *extra=NULL;
-	uint32_t i,users;
+	g_shrubbot_usercache_t *user;
 
 	if(db_users_info.usable==qfalse) {
 		return qfalse;
 	}
 
-	// buffered
-	while(users_b) {
-		if( !memcmp(users_b->user->shortPBGUID, guid_short, SIL_SHRUBBOT_USERID_SIZE) ) {
-			users_b->user->action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			while(appends) {
-				if(!Q_stricmpn(appends->user->pb_guid, users_b->user->user.pb_guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
-					appends->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
-					break;
-				}
-				appends = appends->next;
-			}
-			db_users_info.truncate=qtrue;
-			return qtrue;
-		}
-		users_b=users_b->next;
+	user = DB_FindUserByShortID(guid_short, SIL_DB_SHORTID_PB | SIL_DB_SHORTID_EXACTCASE, NULL);
+	if( !user ) {
+		return qfalse;
 	}
 
-	// loop through memorycache
-	users=usercount_onmemory;
-	for(i=0; i<users ;i++) {
-		if(!memcmp(user_cache[i].shortPBGUID, guid_short, SIL_SHRUBBOT_USERID_SIZE) ) {
-			user_cache[i].action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			extra = DB_FindExtrasCacheDataPB(user_cache[i].user.pb_guid);
-			if(extra) {
-				extra->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+	user->action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
+	if( user->node ) {
+		// buffered
+		while(appends) {
+			if(!Q_stricmpn(appends->user->pb_guid, user->user.pb_guid, SIL_SHRUBBOT_DB_GUIDLEN)) {
+				appends->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
+				break;
 			}
-			db_users_info.truncate=qtrue;
-			return qtrue;
+			appends = appends->next;
+		}
+	} else {
+		extra = DB_FindExtrasCacheDataPB(user->user.pb_guid);
+		if(extra) {
+			extra->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
 		}
 	}
+	db_users_info.truncate=qtrue;
+	DB_SyncUserBoards(user);
+	DB_SyncUserSketch(user);
+	DB_SyncUserListed(user);
+	search_epoch++;
 
-	return qfalse;
+	return qtrue;
 }
 
 void G_DB_PruneUsers(void)
 {
+	g_shrubbot_usercache_t *user;
 	g_shrubbot_userextras_cache_t *extras;
+	uint32_t	id;
+	uint32_t	expires;
 	uint32_t	i;
-	uint32_t	users;
 	int32_t		age;
 	time_t		t;
 	qboolean	remove=qfalse;
@@ -3817,47 +5239,74 @@ void G_DB_PruneUsers(void)
 		return;
 	}
 
-	if(!g_dbUserMaxAge.string[0] || !g_dbUserMaxAge.integer) {
+	age=DB_Get_UserMaxAge();
+	if(!age && !retention_count) {
 		return;
 	}
 	if(!time(&t)) {
 		return;
 	}
-	// iterate all on memory users
 
-	age=DB_Get_UserMaxAge();
+	// the levels of the connected players may have changed since they were saved
+	for( i = 0; i < usercount_buffer ; i++ ) {
+		DB_SyncUserLevel(DB_BUFFERNODE(i)->user);
+	}
+
+	if( !expiry_usable || age != expiry_maxage ) {
+		expiry_maxage = age;
+		if( G_DB_Expiry_Build(&expiry_queue, usercount_onmemory, DB_CachedUserExpiry, NULL) == -1 ) {
+			G_LogPrintf("User pruning skipped, the expiry queue could not be built.\n");
+			return;
+		}
+		expiry_usable = qtrue;
+	}
 
-	users=usercount_onmemory;
-	for(i=0; i < users ;i++) {
-		// we skip users who have not appeared on the server
-		// this can happen when admin reads the admin.cfg
-		if(!user_cache[i].user.time) {
+	// only the expired entries are popped, the rest of the on memory users are not visited
+	while( G_DB_Expiry_Pop(&expiry_queue, (uint32_t)t, &id, &expires) ) {
+		user = &user_cache[id];
+		if( user->expires != expires ) {
+			// the record has been queued again or is not queued anymore
+			continue;
+		}
+		user->expires = 0;
+		if( !DB_UserExpiry(user, &expires) ) {
+			continue;
+		}
+		if( expires >= (uint32_t)t ) {
+			// seen after the entry was queued
+			if( G_DB_Expiry_Push(&expiry_queue, id, expires) == -1 ) {
+				expiry_usable = qfalse;
+			} else {
+				user->expires = expires;
+			}
 			continue;
 		}
+
 		/* Not deleting unlinkables here, those can be used to create bans and stuff still
-		if( !user_cache[i].user.pbgHash && !(user_cache[i].user.ident_flags & SIL_DBGUID_VALID) ) {
-			user_cache[i].action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			extras = DB_FindExtrasCacheData(user_cache[i].user.sil_guid);
+		if( !user->user.pbgHash && !(user->user.ident_flags & SIL_DBGUID_VALID) ) {
+			user->action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
+			extras = DB_FindExtrasCacheData(user->user.sil_guid);
 			if( extras ) {
 				extras->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
 			}
 			remove=qtrue;
 			continue;
 		}*/
-		if((t - user_cache[i].user.time) > age) {
-			user_cache[i].action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			extras = DB_FindExtrasCacheData(user_cache[i].user.sil_guid);
-			if(!extras && user_cache[i].user.pb_guid[0]) {
-				extras = DB_FindExtrasCacheDataPB(user_cache[i].user.pb_guid);
-			}
-			if( extras ) {
-				extras->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
-			}
-			G_DB_RemoveAliases(user_cache[i].user.sil_guid, user_cache[i].user.guidHash);
-			remove=qtrue;
+		user->action=SIL_SHRUBBOT_DB_ACTION_REMOVE;
+		extras = DB_FindExtrasCacheData(user->user.sil_guid);
+		if(!extras && user->user.pb_guid[0]) {
+			extras = DB_FindExtrasCacheDataPB(user->user.pb_guid);
+		}
+		if( extras ) {
+			extras->action = SIL_SHRUBBOT_DB_ACTION_REMOVE;
 		}
+		G_DB_RemoveAliases(user->user.sil_guid, user->user.guidHash);
+		DB_SyncUserBoards(user);
+		DB_SyncUserSketch(user);
+		DB_SyncUserListed(user);
+		search_epoch++;
+		remove=qtrue;
 	}
-	// mark the old ones for deletion
 	// mark the truncate if necessary
 	if(remove) {
 		db_users_info.truncate=qtrue;
@@ -3889,47 +5338,344 @@ static qboolean DB_IPFits(const char* compare_to, const char* IP)
 	return qtrue;
 }
 
-static qboolean NewSearchLoopOnMemory(const char* pattern, int32_t level, const char* IP)
+static void DB_IPSearch_Parse(const char *IP, db_ipsearch_t *search)
 {
-	uint32_t	users;
-	uint32_t	uindex=0;
+	memset(search, 0, sizeof(db_ipsearch_t));
+	if( IP[0] ) {
+		search->range = G_DB_IP_ParseRange(IP, &search->low, &search->high);
+	}
+}
 
-	memset(&search_cache, 0, sizeof(search_cache));
+static qboolean DB_IPSearch_Matches(const g_shrubbot_usercache_t *user, const char *IP, const db_ipsearch_t *search)
+{
+	if( search->range ) {
+		return G_DB_IP_InRange(&user->user.ip_addr, &search->low, &search->high);
+	}
+	return DB_IPFits(user->user.ip, IP);
+}
 
-	users=usercount_onmemory;
-	for(uindex=0; uindex < users ;uindex++) {
-		if(user_cache[uindex].user.name[0] && !user_cache[uindex].user.sanitized_name[0]) {
-			// the sanitized name
-			Q_strncpyz(user_cache[uindex].user.sanitized_name, G_DB_SanitizeName(user_cache[uindex].user.name), MAX_NAME_LENGTH);
-			// mark the file dirty so the sanitized names will be saved in the future
-			db_users_info.truncate=qtrue;
+// the results are handed out in the cache order regardless of the index used to find them
+static void DB_SortResults(void)
+{
+	int32_t result;
+	uint32_t i, j;
+
+	for( i = 1; i < search_cache.used_cache ; i++ ) {
+		result = search_cache.results[i];
+		for( j = i; j > 0 && search_cache.results[j-1] > result ; j-- ) {
+			search_cache.results[j] = search_cache.results[j-1];
 		}
-		// discard removed records to avoid confusion after !userdel
-		if( user_cache[uindex].action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
-			continue;
+		search_cache.results[j] = result;
+	}
+}
+
+// packs the results left by the discards to the beginning, so the n:th result is at n-1
+static void DB_PackResults(void)
+{
+	uint32_t	cindex;
+	uint32_t	used=0;
+
+	for(cindex=0; cindex < search_cache.used_cache ;cindex++) {
+		if(search_cache.results[cindex]!=-1) {
+			search_cache.results[used++]=search_cache.results[cindex];
 		}
-		// discard if level wont fit
-		if((level >= 0) && (level != user_cache[uindex].user.level)) {
-			continue;
+	}
+	search_cache.used_cache=used;
+	search_cache.usable_results=used;
+}
+
+typedef struct db_join_s {
+	int32_t			minLevel;
+	int32_t			maxLevel;
+	db_hashindex_t	table;		// the collected side by the GUID hash
+	qboolean		collect;	// the users are collected to the table instead of checked against it
+	qboolean		overflow;	// more users found than fit into the results
+	qboolean		failed;		// out of memory
+} db_join_t;
+
+typedef struct db_search_s {
+	const char	*pattern;
+	int32_t		level;
+	const char	*IP;
+	db_ipsearch_t ip;
+	qboolean	overflow;
+	db_cursorpage_t	*page;	// set when a cursor page is collected instead of the search cache
+	db_topk_t	*ranked;	// set when the best matches are collected instead of the search cache
+	int			key;		// SIL_DB_RANK_ of the ranked search
+	qboolean	fuzzed;		// the pattern ends with ~, the names are matched with fuzzy
+	db_fuzzy_t	fuzzy;
+	db_join_t	*join;		// set when the users are joined with the aliases instead of the search cache
+} db_search_t;
+
+static qboolean DB_SearchMatches(uint32_t uindex, const db_search_t *search)
+{
+	// discard removed records to avoid confusion after !userdel
+	if( user_cache[uindex].action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
+		return qfalse;
+	}
+	// discard if level wont fit
+	if((search->level >= 0) && (search->level != user_cache[uindex].user.level)) {
+		return qfalse;
+	}
+	// discard IP if it wont fit
+	if(search->IP[0] && !DB_IPSearch_Matches(&user_cache[uindex], search->IP, &search->ip)) {
+		return qfalse;
+	}
+	// discard if name wont fit
+	if(search->pattern[0] && user_cache[uindex].user.sanitized_name[0]) {
+		if(search->fuzzed) {
+			if(!G_DB_Fuzzy_Matches(&search->fuzzy, user_cache[uindex].user.sanitized_name)) {
+				return qfalse;
+			}
+		} else if(strstr(user_cache[uindex].user.sanitized_name, search->pattern) == NULL) {
+			return qfalse;
 		}
-		// discard IP if it wont fit
-		if(IP[0] && !DB_IPFits(user_cache[uindex].user.ip, IP)) {
-			continue;
+	} else if(search->pattern[0]){
+		// skip it anyway
+		return qfalse;
+	}
+	return qtrue;
+}
+
+static qboolean DB_JoinResult(db_join_t *join, g_shrubbot_usercache_t *user)
+{
+	if( join_count == SIL_DB_MAXJOINRESULTS ) {
+		join->overflow = qtrue;
+		return qfalse;
+	}
+	join_results[join_count++] = user;
+
+	return qtrue;
+}
+
+//
+// Collects the user fitting the search to the table of the join, or adds it to the results if a
+// player with the same GUID was collected from the aliases.
+static qboolean DB_JoinVisitUser(uint32_t uindex, const db_search_t *search)
+{
+	db_join_t *join = search->join;
+	g_shrubbot_usercache_t *user = &user_cache[uindex];
+	const char *guid;
+	uint32_t iterator;
+
+	if( !DB_SearchMatches(uindex, search) ) {
+		return qtrue;
+	}
+	if( (join->minLevel >= 0 && user->user.level < join->minLevel) || (join->maxLevel >= 0 && user->user.level > join->maxLevel) ) {
+		return qtrue;
+	}
+
+	if( join->collect ) {
+		if( G_DB_HashIndex_Insert(&join->table, user->user.guidHash, user) == -1 ) {
+			join->failed = qtrue;
+			return qfalse;
 		}
-		// discard if name wont fit
-		if(pattern[0] && user_cache[uindex].user.sanitized_name[0]) {
-			if(strstr(user_cache[uindex].user.sanitized_name, pattern) == NULL) {
-				continue;
-			}
-		} else if(pattern[0]){
-			// skip it anyway
-			continue;
+		return qtrue;
+	}
+
+	for( guid = (const char*)G_DB_HashIndex_First(&join->table, user->user.guidHash, &iterator) ; guid ;
+		guid = (const char*)G_DB_HashIndex_Next(&join->table, user->user.guidHash, &iterator) ) {
+		if( G_DB_GUID_MatchesRaw(guid, user->user.sil_guid) ) {
+			return DB_JoinResult(join, user);
+		}
+	}
+
+	return qtrue;
+}
+
+// the key the user is ranked by in the ranked searches
+static uint32_t DB_RankScore(const g_shrubbot_usercache_t *user, int key)
+{
+	int playTime;
+
+	switch( key ) {
+		case SIL_DB_RANK_LASTSEEN:
+			return user->user.time;
+		case SIL_DB_RANK_LASTXPSAVE:
+			return user->user.last_xp_save;
+		case SIL_DB_RANK_PLAYTIME:
+			playTime = G_DB_GetAliasesPlayTime(user->user.sil_guid, user->user.guidHash);
+			return playTime > 0 ? (uint32_t)playTime : 0;
+		default:
+			return user->user.kills;
+	}
+}
+
+// adds the cache record to the results if it fits the search, returns qfalse when the results are full
+static qboolean DB_SearchVisit(uint32_t uindex, void *context)
+{
+	db_search_t *search = (db_search_t*)context;
+
+	if( search->join ) {
+		return DB_JoinVisitUser(uindex, search);
+	}
+	if( search->ranked ) {
+		if( DB_SearchMatches(uindex, search) ) {
+			G_DB_TopK_Offer(search->ranked, uindex, (double)DB_RankScore(&user_cache[uindex], search->key));
+		}
+		return qtrue;
+	}
+	if( search->page ) {
+		if( uindex < search->page->from || !DB_SearchMatches(uindex, search) ) {
+			return qtrue;
+		}
+		return G_DB_CursorPage_Offer(search->page, uindex);
+	}
+
+	if( !DB_SearchMatches(uindex, search) ) {
+		return qtrue;
+	}
+	if(search_cache.used_cache==SIL_SHRUBBOT_DB_MAXSEARCHCACHE) {
+		search->overflow = qtrue;
+		return qfalse; // too many results
+	}
+	search_cache.results[search_cache.used_cache]=uindex;
+	search_cache.used_cache++;
+
+	return qtrue;
+}
+
+#define DB_SEARCHPLAN_SCAN	0
+#define DB_SEARCHPLAN_LEVEL	1
+#define DB_SEARCHPLAN_IP	2
+#define DB_SEARCHPLAN_NAME	3
+
+// Picks the candidate source of the search. All the estimates are upper limits of the candidates:
+// the level bucket and the IP range counts are exact, the name estimate is the shortest trigram
+// list of the pattern, or with a fuzzy pattern the sum of the lists every match is on at least one
+// of. The other predicates are checked from the records of the candidates.
+static int DB_PlanSearch(const db_search_t *search, uint32_t *candidates)
+{
+	db_levelbucket_t *bucket;
+	uint32_t best = usercount_onmemory;
+	uint32_t estimate;
+	int trigrams;
+	int plan = DB_SEARCHPLAN_SCAN;
+
+	if( search->level >= 0 && level_index_usable ) {
+		DB_SyncBufferedLevels();
+		bucket = DB_FindLevelBucket(search->level);
+		estimate = bucket ? bucket->count : 0;
+		if( level_index_usable && estimate < best ) {
+			best = estimate;
+			plan = DB_SEARCHPLAN_LEVEL;
+		}
+	}
+	if( search->ip.range && ip_index_usable ) {
+		estimate = G_DB_IPTrie_Count(&ip_index, &search->ip.low, &search->ip.high);
+		if( estimate < best ) {
+			best = estimate;
+			plan = DB_SEARCHPLAN_IP;
+		}
+	}
+	if( search->pattern[0] ) {
+		if( search->fuzzed ) {
+			trigrams = G_DB_Trigram_EstimateApprox(&name_index, search->fuzzy.pattern, search->fuzzy.maxErrors);
+		} else {
+			trigrams = G_DB_Trigram_Estimate(&name_index, search->pattern);
 		}
-		if(search_cache.used_cache==SIL_SHRUBBOT_DB_MAXSEARCHCACHE) {
-			return qfalse; // too many results
+		if( trigrams >= 0 && (uint32_t)trigrams < best ) {
+			best = trigrams;
+			plan = DB_SEARCHPLAN_NAME;
 		}
-		search_cache.results[search_cache.used_cache]=uindex;
-		search_cache.used_cache++;
+	}
+
+	if( candidates ) {
+		*candidates = best;
+	}
+	return plan;
+}
+
+static void DB_SetSearch(db_search_t *search, const char *pattern, int32_t level, const char *IP)
+{
+	search->pattern = pattern;
+	search->level = level;
+	search->IP = IP;
+	search->overflow = qfalse;
+	search->page = NULL;
+	search->ranked = NULL;
+	search->key = 0;
+	search->fuzzed = pattern[0] ? G_DB_Fuzzy_Compile(&search->fuzzy, pattern) : qfalse;
+	search->join = NULL;
+	DB_IPSearch_Parse(IP, &search->ip);
+}
+
+// visits the candidates of the name from the trigram index, -1 if the index can't be used
+static int DB_SearchNameIndex(db_search_t *search)
+{
+	if( search->fuzzed ) {
+		return G_DB_Trigram_SearchApprox(&name_index, search->fuzzy.pattern, search->fuzzy.maxErrors, DB_SearchVisit, search);
+	}
+	return G_DB_Trigram_Search(&name_index, search->pattern, DB_SearchVisit, search);
+}
+
+// visits the names of the name column matching the name, -1 if the column can't be used
+static int DB_ScanNameColumn(db_search_t *search)
+{
+	if( !search->pattern[0] ) {
+		return -1;
+	}
+	if( search->fuzzed ) {
+		return G_DB_NameColumn_ScanFuzzy(&name_column, &search->fuzzy, DB_SearchVisit, search);
+	}
+	return G_DB_NameColumn_Scan(&name_column, search->pattern, DB_SearchVisit, search);
+}
+
+// visits the candidates of the planned source with DB_SearchVisit, returns the plan used
+static int DB_VisitCandidates(db_search_t *search)
+{
+	db_levelbucket_t *bucket;
+	uint32_t	users;
+	uint32_t	uindex=0;
+	int			plan;
+
+	plan = DB_PlanSearch(search, NULL);
+	switch( plan ) {
+		case DB_SEARCHPLAN_LEVEL:
+			bucket = DB_FindLevelBucket(search->level);
+			users = bucket ? bucket->count : 0;
+			for(uindex=0; uindex < users ;uindex++) {
+				if( !DB_SearchVisit(bucket->ids[uindex], search) ) {
+					break;
+				}
+			}
+			break;
+		case DB_SEARCHPLAN_IP:
+			// the IP index gives the candidates in the address order
+			G_DB_IPTrie_Walk(&ip_index, &search->ip.low, &search->ip.high, DB_SearchVisit, search);
+			break;
+		case DB_SEARCHPLAN_NAME:
+			DB_SearchNameIndex(search);
+			break;
+		default:
+			// the name column is scanned instead of the records if there is a name to look for
+			if( DB_ScanNameColumn(search) != -1 ) {
+				break;
+			}
+			users=usercount_onmemory;
+			for(uindex=0; uindex < users ;uindex++) {
+				if( !DB_SearchVisit(uindex, search) ) {
+					break;
+				}
+			}
+			break;
+	}
+
+	return plan;
+}
+
+static qboolean NewSearchLoopOnMemory(const char* pattern, int32_t level, const char* IP)
+{
+	db_search_t	search;
+
+	memset(&search_cache, 0, sizeof(search_cache));
+
+	DB_SetSearch(&search, pattern, level, IP);
+	if( DB_VisitCandidates(&search) == DB_SEARCHPLAN_IP ) {
+		DB_SortResults();
+	}
+	if( search.overflow ) {
+		return qfalse;
 	}
 	search_cache.usable_results=search_cache.used_cache;
 	if(pattern[0]) {
@@ -3943,6 +5689,7 @@ static qboolean NewSearchLoopOnMemory(const char* pattern, int32_t level, const
 	if(IP[0]) {
 		search_cache.search_type|=SIL_SHRUBBOT_DB_SEARCHIP;
 		Q_strncpyz(search_cache.search_ip, IP, sizeof(search_cache.search_ip));
+		search_cache.search_iprange = search.ip;
 	}
 
 	return qtrue;
@@ -3950,21 +5697,25 @@ static qboolean NewSearchLoopOnMemory(const char* pattern, int32_t level, const
 
 static void DB_NameDiscardResults(const char* pattern)
 {
+	db_fuzzy_t	fuzzy;
+	qboolean	fuzzed;
 	uint32_t	users;
 	uint32_t	cindex=0;
 
+	fuzzed = G_DB_Fuzzy_Compile(&fuzzy, pattern);
 	users=search_cache.used_cache;
 	for(cindex=0; cindex < users ;cindex++) {
 		int rindex=search_cache.results[cindex];
 		if(rindex==-1) {
 			continue;
 		}
-		if(strstr(user_cache[rindex].user.sanitized_name, pattern) == NULL) {
+		if(fuzzed ? !G_DB_Fuzzy_Matches(&fuzzy, user_cache[rindex].user.sanitized_name) : strstr(user_cache[rindex].user.sanitized_name, pattern) == NULL) {
 			// remove from resultset
 			search_cache.results[cindex]=-1;
 			search_cache.usable_results--;
 		}
 	}
+	DB_PackResults();
 	search_cache.search_type|=SIL_SHRUBBOT_DB_SEARCHNAME;
 	Q_strncpyz(search_cache.search_pattern, pattern, sizeof(search_cache.search_pattern));
 }
@@ -3986,34 +5737,41 @@ static void DB_LevelDiscardResults(int32_t level)
 			search_cache.usable_results--;
 		}
 	}
+	DB_PackResults();
 	search_cache.search_type|=SIL_SHRUBBOT_DB_SEARCHLEVEL;
 	search_cache.search_level=(uint32_t)level;
 }
 
 static void DB_IPDiscardResults(const char* IP)
 {
+	db_ipsearch_t ip;
 	uint32_t	users;
 	uint32_t	cindex=0;
 
+	DB_IPSearch_Parse(IP, &ip);
+
 	users=search_cache.used_cache;
 	for(cindex=0; cindex < users ;cindex++) {
 		int rindex=search_cache.results[cindex];
 		if(rindex==-1) {
 			continue;
 		}
-		if(!DB_IPFits(user_cache[rindex].user.ip, IP)) {
+		if(!DB_IPSearch_Matches(&user_cache[rindex], IP, &ip)) {
 			// remove from resultset
 			search_cache.results[cindex]=-1;
 			search_cache.usable_results--;
 		}
 	}
+	DB_PackResults();
 	search_cache.search_type|=SIL_SHRUBBOT_DB_SEARCHIP;
 	Q_strncpyz(search_cache.search_ip, IP, sizeof(search_cache.search_ip));
+	search_cache.search_iprange = ip;
 }
 
 // return 2 if exact match, 1 if usable, 0 if not
 static uint32_t DB_PatternUsable(const char* new)
 {
+	db_fuzzy_t fuzzy;
 	uint32_t length1;
 	uint32_t length2;
 
@@ -4033,6 +5791,10 @@ static uint32_t DB_PatternUsable(const char* new)
 			return 2;
 		}
 	} else if(length1 < length2) {
+		// the fuzzy matches of a pattern are not among the matches of a part of it
+		if(G_DB_Fuzzy_Compile(&fuzzy, new) || G_DB_Fuzzy_Compile(&fuzzy, search_cache.search_pattern)) {
+			return 0;
+		}
 		if(strstr(new, search_cache.search_pattern)) {
 			return 1;
 		}
@@ -4062,6 +5824,8 @@ static uint32_t DB_LevelUsable(int32_t level)
 // return 2 if exact match, 1 if usable, 0 if not
 static uint32_t DB_IPUsable(const char *IP)
 {
+	db_ipsearch_t ip;
+
 	if(!(search_cache.search_type & SIL_SHRUBBOT_DB_SEARCHIP)) {
 		if(IP[0]) {
 			return 1;
@@ -4072,43 +5836,33 @@ static uint32_t DB_IPUsable(const char *IP)
 	if(!IP[0] && (search_cache.search_type & SIL_SHRUBBOT_DB_SEARCHIP)) {
 		return 0;
 	}
-	if(DB_IPFits(IP, search_cache.search_ip)) {
+	DB_IPSearch_Parse(IP, &ip);
+	if( ip.range && search_cache.search_iprange.range ) {
+		// usable if the new range is within the old one
+		if( memcmp(ip.low.addr, search_cache.search_iprange.low.addr, SIL_DB_IP_SIZE) < 0
+			|| memcmp(ip.high.addr, search_cache.search_iprange.high.addr, SIL_DB_IP_SIZE) > 0 ) {
+			return 0;
+		}
+		if( !memcmp(&ip, &search_cache.search_iprange, sizeof(ip)) ) {
+			return 2;
+		}
+		return 1;
+	}
+	if(!ip.range && !search_cache.search_iprange.range && DB_IPFits(IP, search_cache.search_ip)) {
 		return 1;
 	}
 	return 0;
 }
 
-// cleans removed records from old resultset
-static void DB_CleanOldResultSet(void)
-{
-	uint32_t	users;
-	uint32_t	cindex=0;
-
-	users=search_cache.used_cache;
-	for(cindex=0; cindex < users ;cindex++) {
-		int rindex=search_cache.results[cindex];
-		if(rindex==-1) {
-			continue;
-		}
-		if( user_cache[rindex].action & SIL_SHRUBBOT_DB_ACTION_REMOVE ) {
-			search_cache.results[cindex]=-1;
-			search_cache.usable_results--;
-		}
-	}
-}
-
-// function searches the db for given parameters
+// function searches the db for given parameters to the working search cache
 // it will internally decide whether to make clean search or use old
 // results for the search
-qboolean G_DB_SearchDatabase(const char* name_pattern, int32_t level, const char* IP)
+static qboolean DB_SearchDatabase(const char* sanitized_pattern, int32_t level, const char* IP)
 {
-	char		sanitized_pattern[MAX_NAME_LENGTH];
 	uint32_t	pattern_usable=0;
 	uint32_t	level_usable=0;
 	uint32_t	ip_usable=0;
 
-	Q_strncpyz(sanitized_pattern, G_DB_SanitizeName(name_pattern), sizeof(sanitized_pattern));
-
 	if(search_cache.search_type) {
 		// check do we use the old result set as basis for new search
 		level_usable=DB_LevelUsable(level);
@@ -4117,7 +5871,6 @@ qboolean G_DB_SearchDatabase(const char* name_pattern, int32_t level, const char
 
 		if(level_usable == 2 && pattern_usable == 2 && ip_usable==2) {
 			// exact match to old parameters
-			DB_CleanOldResultSet();
 			return qtrue;
 		}
 	}
@@ -4128,7 +5881,6 @@ qboolean G_DB_SearchDatabase(const char* name_pattern, int32_t level, const char
 			return qfalse;
 		}
 	} else {
-		DB_CleanOldResultSet();
 		// use the old results
 		if(level >= 0 && level_usable!=2) {
 			DB_LevelDiscardResults(level);
@@ -4143,87 +5895,552 @@ qboolean G_DB_SearchDatabase(const char* name_pattern, int32_t level, const char
 	return qtrue;
 }
 
-qboolean G_DB_GetResultCount(void)
+// the session of the client, the console and the invalid slots share the last one
+static db_searchsession_t* DB_GetSearchSession(int clientNum)
 {
-	if(search_cache.search_type == SIL_SHRUBBOT_DB_SEARCHNONE) {
-		return 0;
+	if( clientNum < 0 || clientNum >= MAX_CLIENTS ) {
+		return &search_sessions[MAX_CLIENTS];
 	}
-	return search_cache.usable_results;
+	return &search_sessions[clientNum];
 }
 
-// iterates the internal pointer to the first possible result
-// jumping over discarded results
-qboolean G_DB_SetResultStart(uint32_t index)
+// returns the entry made with the exact parameters after the last change of the records
+static db_searchentry_t* DB_FindSearchEntry(const char *pattern, int32_t level, const char *IP)
 {
+	const g_shrubbot_searchcache_t *cache;
+	uint32_t type = SIL_SHRUBBOT_DB_SEARCHNONE;
 	uint32_t i;
-	uint32_t *iter=&search_cache.iterator;
 
-	if(search_cache.search_type == SIL_SHRUBBOT_DB_SEARCHNONE) {
-		return qfalse;
+	if( pattern[0] ) {
+		type |= SIL_SHRUBBOT_DB_SEARCHNAME;
 	}
-	if(index < 1 || index > search_cache.usable_results) {
-		// note, usable_results is always less or equal to used_cache
-		return qfalse;
+	if( level >= 0 ) {
+		type |= SIL_SHRUBBOT_DB_SEARCHLEVEL;
 	}
-
-	*iter=0;
-	while(search_cache.results[(*iter)]==-1) {
-		(*iter)++;// iterate to the first readbale
+	if( IP[0] ) {
+		type |= SIL_SHRUBBOT_DB_SEARCHIP;
 	}
-	index--;
-	for(i=0; i < index ; (*iter)++) {
-		if(search_cache.results[(*iter)]==-1) {
+
+	for( i = 0; i < SIL_DB_SEARCHENTRIES ; i++ ) {
+		cache = &search_entries[i].cache;
+		if( !search_entries[i].serial || search_entries[i].epoch != search_epoch || cache->search_type != type ) {
+			continue;
+		}
+		if( (type & SIL_SHRUBBOT_DB_SEARCHNAME) && strcmp(cache->search_pattern, pattern) ) {
+			continue;
+		}
+		if( (type & SIL_SHRUBBOT_DB_SEARCHLEVEL) && cache->search_level != (uint32_t)level ) {
+			continue;
+		}
+		if( (type & SIL_SHRUBBOT_DB_SEARCHIP) && strcmp(cache->search_ip, IP) ) {
 			continue;
 		}
-		i++;
+		return &search_entries[i];
+	}
+
+	return NULL;
+}
+
+// returns the entry of the session if it has not been evicted and the records have not changed
+static db_searchentry_t* DB_GetSessionEntry(const db_searchsession_t *session)
+{
+	db_searchentry_t *entry = &search_entries[session->entry];
+
+	if( !session->searched || entry->serial != session->serial || entry->epoch != search_epoch ) {
+		return NULL;
+	}
+	return entry;
+}
+
+// stores the working search cache over the least recently used entry
+static db_searchentry_t* DB_StoreSearchEntry(void)
+{
+	db_searchentry_t *entry = &search_entries[0];
+	uint32_t i;
+
+	for( i = 1; i < SIL_DB_SEARCHENTRIES && entry->serial ; i++ ) {
+		if( !search_entries[i].serial || search_entries[i].used < entry->used ) {
+			entry = &search_entries[i];
+		}
+	}
+
+	memcpy(&entry->cache, &search_cache, sizeof(g_shrubbot_searchcache_t));
+	entry->epoch = search_epoch;
+	entry->serial = ++search_serial;
+
+	return entry;
+}
+
+//
+// Finds the results of the session from the entries, or refines them from the earlier results
+// of the session, or searches them again. The iterator of the session is left as it is.
+static db_searchentry_t* DB_RunSessionSearch(db_searchsession_t *session)
+{
+	db_searchentry_t *entry;
+
+	DB_SyncBufferedLevels();
+
+	entry = DB_GetSessionEntry(session);
+	if( !entry ) {
+		entry = DB_FindSearchEntry(session->pattern, session->level, session->IP);
+	}
+	if( !entry ) {
+		if( session->previous && session->previous->serial == session->previousSerial && session->previous->epoch == search_epoch ) {
+			memcpy(&search_cache, &session->previous->cache, sizeof(g_shrubbot_searchcache_t));
+		} else {
+			memset(&search_cache, 0, sizeof(search_cache));
+		}
+		if( !DB_SearchDatabase(session->pattern, session->level, session->IP) ) {
+			session->searched = qfalse;
+			return NULL;
+		}
+		entry = DB_StoreSearchEntry();
+	}
+
+	session->entry = (uint32_t)(entry - search_entries);
+	session->serial = entry->serial;
+	session->searched = qtrue;
+	entry->used = ++search_serial;
+
+	return entry;
+}
+
+qboolean G_DB_SearchDatabaseSession(int clientNum, const char* name_pattern, int32_t level, const char* IP)
+{
+	db_searchsession_t *session = DB_GetSearchSession(clientNum);
+	db_searchentry_t *entry;
+
+	// the earlier results of the session are the base for the narrower searches
+	entry = DB_GetSessionEntry(session);
+	session->previous = entry;
+	session->previousSerial = entry ? entry->serial : 0;
+
+	G_DB_NameScan_Sanitize(name_pattern, session->pattern, sizeof(session->pattern));
+	session->level = level;
+	Q_strncpyz(session->IP, IP, sizeof(session->IP));
+	session->iterator = 0;
+	session->searched = qfalse;
+
+	entry = DB_RunSessionSearch(session);
+	session->previous = NULL;
+
+	return entry ? qtrue : qfalse;
+}
+
+uint32_t G_DB_GetResultCountSession(int clientNum)
+{
+	db_searchsession_t *session = DB_GetSearchSession(clientNum);
+	db_searchentry_t *entry = session->searched ? DB_RunSessionSearch(session) : NULL;
+
+	if( !entry || entry->cache.search_type == SIL_SHRUBBOT_DB_SEARCHNONE ) {
+		return 0;
+	}
+	return entry->cache.usable_results;
+}
+
+qboolean G_DB_SetResultStartSession(int clientNum, uint32_t index)
+{
+	db_searchsession_t *session = DB_GetSearchSession(clientNum);
+	db_searchentry_t *entry = session->searched ? DB_RunSessionSearch(session) : NULL;
+
+	if( !entry || entry->cache.search_type == SIL_SHRUBBOT_DB_SEARCHNONE ) {
+		return qfalse;
+	}
+	if( index < 1 || index > entry->cache.usable_results ) {
+		return qfalse;
 	}
 
+	// the results are packed, no discarded ones to jump over
+	session->iterator = index - 1;
+
 	return qtrue;
 }
 
-qboolean G_DB_GetResultUser(g_shrubbot_user_handle_t *handle)
+qboolean G_DB_GetResultUserSession(int clientNum, g_shrubbot_user_handle_t *handle)
 {
+	db_searchsession_t *session = DB_GetSearchSession(clientNum);
+	db_searchentry_t *entry = DB_GetSessionEntry(session);
 	g_shrubbot_usercache_t *user;
-	uint32_t usedc=search_cache.used_cache;
-	uint32_t *iter=&search_cache.iterator;
 
-	if(search_cache.search_type == SIL_SHRUBBOT_DB_SEARCHNONE) {
+	if( !entry && session->searched ) {
+		// the records have changed after the results were made
+		entry = DB_RunSessionSearch(session);
+	}
+	if( !entry || entry->cache.search_type == SIL_SHRUBBOT_DB_SEARCHNONE ) {
 		return qfalse;
 	}
-	if(*iter == usedc) {
+	if( session->iterator >= entry->cache.used_cache ) {
 		return qfalse;
 	}
 
-	user = &user_cache[search_cache.results[(*iter)]];
+	user = &user_cache[entry->cache.results[session->iterator]];
 	handle->flags = SIL_DBUSERFLAG_CACHED;
 	handle->node = (void*)user;
 	handle->user = &user->user;
 	handle->userid = &user->user.sil_guid[24];
 	handle->shortPBGUID = &user->user.pb_guid[24];
 
-	(*iter)++;
-	while(*iter < usedc && search_cache.results[(*iter)]==-1) {
-		(*iter)++;
+	session->iterator++;
+
+	return qtrue;
+}
+
+qboolean G_DB_SearchDatabase(const char* name_pattern, int32_t level, const char* IP)
+{
+	return G_DB_SearchDatabaseSession(-1, name_pattern, level, IP);
+}
+
+qboolean G_DB_GetResultCount(void)
+{
+	return G_DB_GetResultCountSession(-1);
+}
+
+qboolean G_DB_SetResultStart(uint32_t index)
+{
+	return G_DB_SetResultStartSession(-1, index);
+}
+
+qboolean G_DB_GetResultUser(g_shrubbot_user_handle_t *handle)
+{
+	return G_DB_GetResultUserSession(-1, handle);
+}
+
+static void DB_SetCursorSearch(const g_shrubbot_searchcursor_t *cursor, db_search_t *search)
+{
+	DB_SetSearch(search, cursor->pattern, cursor->level, cursor->IP);
+}
+
+qboolean G_DB_OpenSearchCursor(g_shrubbot_searchcursor_t *cursor, const char *name_pattern, int32_t level, const char *IP)
+{
+	db_search_t search;
+
+	memset(cursor, 0, sizeof(g_shrubbot_searchcursor_t));
+	cursor_count = 0;
+
+	if( !db_users_info.usable ) {
+		cursor->finished = qtrue;
+		cursor->exact = qtrue;
+		return qfalse;
 	}
 
+	G_DB_NameScan_Sanitize(name_pattern ? name_pattern : "", cursor->pattern, sizeof(cursor->pattern));
+	cursor->level = level;
+	Q_strncpyz(cursor->IP, IP ? IP : "", sizeof(cursor->IP));
+
+	// the candidates of the index are an upper bound until the cursor reaches the end
+	DB_SetCursorSearch(cursor, &search);
+	DB_PlanSearch(&search, &cursor->total);
+
 	return qtrue;
 }
 
-qboolean G_DB_IsWhiteListed(const char *guid)
+int G_DB_FetchSearchCursor(g_shrubbot_searchcursor_t *cursor, uint32_t count)
 {
-	g_shrubbot_buffered_users_t* user=NULL;
-	uint32_t guidHash;
-	uint32_t i;
-	char guid_t[32];
+	db_cursorpage_t page;
+	db_search_t	search;
+	db_levelbucket_t *bucket;
+	uint32_t	i;
 
-	for(i=0; i < 32 && guid[i] ;i++) {
-		guid_t[i]=toupper(guid[i]);
+	cursor_count = 0;
+
+	// an empty page would never finish the cursor
+	if( !db_users_info.usable || count == 0 ) {
+		return -1;
+	}
+	if( cursor->finished ) {
+		return 0;
+	}
+
+	DB_SetCursorSearch(cursor, &search);
+	search.page = &page;
+
+	// the plan is made again, the indexes may have changed since the last page
+	switch( DB_PlanSearch(&search, NULL) ) {
+		case DB_SEARCHPLAN_LEVEL:
+			G_DB_CursorPage_Begin(&page, cursor->position, count, qtrue);
+			bucket = DB_FindLevelBucket(search.level);
+			if( !bucket ) {
+				break;
+			}
+			for( i = DB_LevelBucketLowerBound(bucket, cursor->position); i < bucket->count ; i++ ) {
+				if( !DB_SearchVisit(bucket->ids[i], &search) ) {
+					break;
+				}
+			}
+			break;
+		case DB_SEARCHPLAN_IP:
+			// the IP index gives the candidates in the address order
+			G_DB_CursorPage_Begin(&page, cursor->position, count, qfalse);
+			G_DB_IPTrie_Walk(&ip_index, &search.ip.low, &search.ip.high, DB_SearchVisit, &search);
+			break;
+		case DB_SEARCHPLAN_NAME:
+			G_DB_CursorPage_Begin(&page, cursor->position, count, qtrue);
+			DB_SearchNameIndex(&search);
+			break;
+		default:
+			G_DB_CursorPage_Begin(&page, cursor->position, count, qtrue);
+			if( DB_ScanNameColumn(&search) != -1 ) {
+				break;
+			}
+			for( i = cursor->position; i < usercount_onmemory ; i++ ) {
+				if( !DB_SearchVisit(i, &search) ) {
+					break;
+				}
+			}
+			break;
+	}
+
+	cursor_count = G_DB_CursorPage_End(&page);
+	for( i = 0; i < cursor_count ; i++ ) {
+		cursor_results[i] = &user_cache[page.ids[i]];
+	}
+	if( cursor_count ) {
+		cursor->position = page.ids[cursor_count - 1] + 1;
+	}
+	cursor->returned += cursor_count;
+
+	if( !page.more ) {
+		cursor->finished = qtrue;
+		cursor->exact = qtrue;
+		cursor->total = cursor->returned;
+	} else if( cursor->total <= cursor->returned ) {
+		cursor->total = cursor->returned + 1;
+	}
+
+	return (int)cursor_count;
+}
+
+qboolean G_DB_GetCursorUser(uint32_t position, g_shrubbot_user_handle_t *handle)
+{
+	if( position >= cursor_count || !handle ) {
+		return qfalse;
+	}
+
+	DB_FillUserHandle(cursor_results[position], handle);
+
+	return qtrue;
+}
+
+// the leaderboard ordered by the key, -1 if there isn't one
+static int DB_RankBoard(int key)
+{
+	switch( key ) {
+		case SIL_DB_RANK_LASTSEEN:
+			return SIL_DB_BOARD_LASTSEEN;
+		case SIL_DB_RANK_LASTXPSAVE:
+			return SIL_DB_BOARD_LASTXPSAVE;
+		case SIL_DB_RANK_KILLS:
+			return SIL_DB_BOARD_KILLS;
+		default:
+			return -1;
+	}
+}
+
+//
+// Offers the users of the leaderboard in the score order. The scores of the board are the keys
+// rounded to floats, the rounding keeps the order, so once the score falls below the rounded lowest
+// kept key, no further user can have a high enough key.
+static qboolean DB_RankedBoardVisit(uint32_t id, float score, void *context)
+{
+	db_search_t *search = (db_search_t*)context;
+	double lowest;
+
+	if( G_DB_TopK_Lowest(search->ranked, &lowest) && score < (float)lowest ) {
+		return qfalse;
+	}
+	// the users only in the buffer can't be found by the searches
+	if( id >= usercount_onmemory ) {
+		return qtrue;
+	}
+
+	return DB_SearchVisit(id, search);
+}
+
+int G_DB_SearchDatabaseRanked(const char *name_pattern, int32_t level, const char *IP, int key, uint32_t count)
+{
+	char		pattern[MAX_NAME_LENGTH];
+	db_search_t	search;
+	db_topk_t	topk;
+	uint32_t	candidates;
+	uint32_t	i;
+	int			board;
+	int			plan;
+
+	ranked_count = 0;
+
+	if( !db_users_info.usable || key < 0 || key >= SIL_DB_RANKKEYS ) {
+		return -1;
+	}
+	if( count > SIL_DB_MAXRANKED ) {
+		count = SIL_DB_MAXRANKED;
+	}
+
+	G_DB_NameScan_Sanitize(name_pattern ? name_pattern : "", pattern, sizeof(pattern));
+	DB_SetSearch(&search, pattern, level, IP ? IP : "");
+	search.ranked = &topk;
+	search.key = key;
+	G_DB_TopK_Begin(&topk, count);
+
+	// the leaderboard is walked unless the other predicates narrow the candidates down to a small
+	// part of the users. The users with zero key are not on the board, so the candidates are
+	// searched after all if the board ran out before the results were full.
+	board = DB_RankBoard(key);
+	plan = DB_PlanSearch(&search, &candidates);
+	if( !count || board < 0 || (plan != DB_SEARCHPLAN_SCAN && candidates <= usercount_onmemory / DB_RANKED_MAXCANDIDATESHARE)
+		|| !DB_PrepareBoards() || G_DB_SkipList_Walk(&boards[board], DB_RankedBoardVisit, &search) ) {
+		if( topk.count < topk.size ) {
+			G_DB_TopK_Begin(&topk, count);
+			DB_VisitCandidates(&search);
+		}
+	}
+
+	ranked_count = G_DB_TopK_End(&topk);
+	for( i = 0; i < ranked_count ; i++ ) {
+		ranked_results[i] = &user_cache[topk.entries[i].id];
+		ranked_scores[i] = (uint32_t)topk.entries[i].score;
+	}
+
+	return (int)ranked_count;
+}
+
+qboolean G_DB_GetRankedUser(uint32_t position, g_shrubbot_user_handle_t *handle, uint32_t *score)
+{
+	if( position >= ranked_count || !handle ) {
+		return qfalse;
+	}
+
+	DB_FillUserHandle(ranked_results[position], handle);
+	if( score ) {
+		*score = ranked_scores[position];
+	}
+
+	return qtrue;
+}
+
+//
+// Collects the player of the aliases to the table of the join, or adds the user collected with the
+// same GUID to the results. The user is taken off the table, so it is found once.
+static qboolean DB_JoinVisitAliasPlayer(const char *guid, uint32_t guidHash, void *context)
+{
+	db_join_t *join = (db_join_t*)context;
+	g_shrubbot_usercache_t *user;
+	uint32_t iterator;
+
+	if( join->collect ) {
+		if( G_DB_HashIndex_Insert(&join->table, guidHash, (void*)guid) == -1 ) {
+			join->failed = qtrue;
+			return qfalse;
+		}
+		return qtrue;
+	}
+
+	for( user = (g_shrubbot_usercache_t*)G_DB_HashIndex_First(&join->table, guidHash, &iterator) ; user ;
+		user = (g_shrubbot_usercache_t*)G_DB_HashIndex_Next(&join->table, guidHash, &iterator) ) {
+		if( G_DB_GUID_MatchesRaw(guid, user->user.sil_guid) ) {
+			G_DB_HashIndex_Remove(&join->table, guidHash, user);
+			return DB_JoinResult(join, user);
+		}
+	}
+
+	return qtrue;
+}
+
+int G_DB_JoinQuery(const g_shrubbot_joinquery_t *query)
+{
+	char		pattern[MAX_NAME_LENGTH];
+	db_search_t	search;
+	db_join_t	join;
+	g_shrubbot_usercache_t *user;
+	uint32_t	users;
+	int			players;
+	uint32_t	i, j;
+
+	join_count = 0;
+
+	if( !db_users_info.usable ) {
+		return -1;
+	}
+	players = G_DB_EstimateAliasPlayers(query->alias_pattern, query->alias_timed, query->alias_from, query->alias_to);
+	if( players < 0 ) {
+		return -1;
 	}
-	if(i!=32) { return qfalse; }
 
-	guidHash=BG_hashword((const uint32_t*)guid_t, 8, 0);
+	G_DB_NameScan_Sanitize(query->name_pattern ? query->name_pattern : "", pattern, sizeof(pattern));
+	// the exact level can use the level index
+	DB_SetSearch(&search, pattern, (query->min_level >= 0 && query->min_level == query->max_level) ? query->min_level : -1,
+		query->IP ? query->IP : "");
+	memset(&join, 0, sizeof(join));
+	join.minLevel = query->min_level;
+	join.maxLevel = query->max_level;
+	search.join = &join;
+	DB_PlanSearch(&search, &users);
+
+	// the side with fewer candidates is collected, the other one is checked against it
+	join.collect = qtrue;
+	if( (uint32_t)players <= users ) {
+		G_DB_HashIndex_Init(&join.table, (uint32_t)players);
+		G_DB_VisitAliasPlayers(query->alias_pattern, query->alias_timed, query->alias_from, query->alias_to, DB_JoinVisitAliasPlayer, &join);
+		join.collect = qfalse;
+		if( !join.failed ) {
+			DB_VisitCandidates(&search);
+		}
+	} else {
+		G_DB_HashIndex_Init(&join.table, users);
+		DB_VisitCandidates(&search);
+		join.collect = qfalse;
+		if( !join.failed ) {
+			G_DB_VisitAliasPlayers(query->alias_pattern, query->alias_timed, query->alias_from, query->alias_to, DB_JoinVisitAliasPlayer, &join);
+		}
+	}
+	G_DB_HashIndex_Free(&join.table);
+
+	if( join.failed ) {
+		G_LogPrintf("Joined query failed, out of memory.\n");
+		join_count = 0;
+		return -1;
+	}
+
+	// the results are handed out in the cache order regardless of the side they were found from
+	for( i = 1; i < join_count ; i++ ) {
+		user = join_results[i];
+		for( j = i; j > 0 && join_results[j-1] > user ; j-- ) {
+			join_results[j] = join_results[j-1];
+		}
+		join_results[j] = user;
+	}
+
+	if( join.overflow ) {
+		return -2;
+	}
+
+	return (int)join_count;
+}
+
+qboolean G_DB_GetJoinUser(uint32_t position, g_shrubbot_user_handle_t *handle)
+{
+	if( position >= join_count || !handle ) {
+		return qfalse;
+	}
+
+	DB_FillUserHandle(join_results[position], handle);
+
+	return qtrue;
+}
+
+qboolean G_DB_IsWhiteListed(const char *guid)
+{
+	db_guid_t guid_t;
+
+	if(!G_DB_GUID_Set(&guid_t, guid)) { return qfalse; }
+
+	return G_DB_IsWhiteListedGUID(&guid_t);
+}
+
+qboolean G_DB_IsWhiteListedGUID(const db_guid_t *guid)
+{
+	g_shrubbot_buffered_users_t* user=NULL;
 
-	user=DB_GetUserNode(guidHash, guid_t);
+	user=DB_GetUserNode(guid->hash, guid->guid);
 
 	if( user == NULL ) {
 		return qfalse;
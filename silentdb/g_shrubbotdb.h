@@ -56,6 +56,12 @@
  *               longer ident fields, optional aliases database. Fie handling
  *               separated to independent module.
  *               , gaoesa
+ *  2026-10-17   Database conversion to the 0.5 version. The last IP is stored
+ *               also as a binary address, so the IPv6 addresses are kept.
+ *               , agent
+ *  2026-10-17   Approximate name searches with the pattern~ and pattern~N
+ *               syntax, the ~ suffix gives the allowed edits.
+ *               , agent
  *****************************************************************************/
 
 #ifndef __G_SHRUBBOTDB_H__
@@ -63,7 +69,7 @@
 
 // Version info is used to make sure the records are compatible with the used mod version.
 // It also allows making automatic db conversions.
-#define DB_USERS_VERSION "SLEnT UDB v0.4\0\0"
+#define DB_USERS_VERSION "SLEnT UDB v0.5\0\0"
 #define DB_USERS_VERSIONSIZE 16
 #define DB_USERS_FILENAME "userdb.db"
 
@@ -71,13 +77,17 @@
 #define DB_USERSEXTRA_VERSIONSIZE 16
 #define DB_USERSEXTRA_FILENAME "userxdb.db"
 
+// optional "<level> <age>" lines, the age has the g_dbUserMaxAge units or is "never"
+#define SIL_DB_RETENTION_FILENAME "userretention.cfg"
+#define SIL_DB_MAXRETENTIONPOLICIES 32
+
 #define SIL_DB_GREETING_SIZE 128
 #define SIL_DB_GREETING_SOUND_SIZE 256
 #define SIL_DB_KEYSIZE 32
 
 // g_dbDirectory // directory under fs_game where the database files are
 
-#define SIL_SHRUBBOT_DB_GUIDLEN			32
+// SIL_SHRUBBOT_DB_GUIDLEN is defined in g_db_guid.h
 #define SIL_SHRUBBOT_IPLEN				16
 #define SIL_SHRUBBOT_USERID_SIZE		8
 #define SIL_DB_IDENT_LENGTH				8
@@ -109,6 +119,10 @@
 #define SILENT_ETTV_GUID_30 "EEEEEEEEEEEEEEEEEEEEEEEEEEEEEE"
 
 #include "g_shrubbot.h"
+#include "g_db_guid.h"
+#include "g_db_iptrie.h"
+#include "g_db_kll.h"
+#include "g_db_cursor.h"
 
 //
 // This struct holds everything that is saved in the database, and nothing more.
@@ -122,7 +136,7 @@ typedef struct g_shrubbot_user_f_s {
 	char		sil_guid[SIL_SHRUBBOT_DB_GUIDLEN];	// remember to always use Q_strncmp because there isn't terminating NUL
 	char		name[MAX_NAME_LENGTH];			// lowercase last used name of the player for name searches
 	char		sanitized_name[MAX_NAME_LENGTH];// we need this for searching
-	char		ip[SIL_SHRUBBOT_IPLEN];			// last IP of the user
+	char		ip[SIL_SHRUBBOT_IPLEN];			// last IP of the user as text without the port, cut to fit the field
 	int32_t		level;
 	char		flags[MAX_SHRUBBOT_FLAGS];
 	// xpsave
@@ -138,7 +152,8 @@ typedef struct g_shrubbot_user_f_s {
 	uint8_t		ident[SIL_DB_IDENT_LENGTH];
 	uint32_t	ident_flags;
 	uint32_t	last_xp_save;
-} g_shrubbot_user_f_t;  // size: 304 bytes for 10 000 users ~ 2,89 MB
+	db_ip_t		ip_addr;						// last IP of the user as binary, IPv4 mapped to IPv6, used by the IP searches
+} g_shrubbot_user_f_t;  // size: 320 bytes for 10 000 users ~ 3,05 MB
 
 // Extra data related to some users
 // These are so rare that guid hashes are not needed.
@@ -229,6 +244,93 @@ int G_DB_SetClientIdent(gentity_t *ent, uint8_t *ident, uint8_t identLength);
 void G_DB_ValidateClientIdentStringForUse( char *identStr );
 void G_DB_GetClientIdentString(g_shrubbot_user_handle_t *handle, char *dest, uint32_t maxsize);
 
+// alt accounts
+#define SIL_DB_MAXALTACCOUNTS	64		// the results of one search
+#define SIL_DB_ALT_IDENT		0x01	// the account has the same ident
+#define SIL_DB_ALT_IP			0x02	// the account has the same last IP
+
+/**
+ * Finds the other accounts that share the ident or the last IP with the player. The excluded
+ * idents are never matched. The results can be read with G_DB_GetAltAccount until the buffers
+ * are saved or the next search.
+ *
+ * @param guid The normalized silEnT GUID of the player, see G_DB_GUID_Set
+ * @param match SIL_DB_ALT_IDENT and/or SIL_DB_ALT_IP, what is compared
+ *
+ * @return the amount of found accounts, at most SIL_DB_MAXALTACCOUNTS, or -1 if the player is not found
+ */
+int G_DB_FindAltAccounts(const db_guid_t *guid, uint32_t match);
+/**
+ * Gets a found account of the last alt account search.
+ *
+ * @param position 0 - G_DB_FindAltAccounts()-1
+ * @param handle pointer to the handle that will be filled with the user
+ * @param shared optional, set to the SIL_DB_ALT_ flags of what the account shares with the player
+ *
+ * @return qboolean true if handle was set, false otherwise
+ */
+qboolean G_DB_GetAltAccount(uint32_t position, g_shrubbot_user_handle_t *handle, uint32_t *shared);
+
+// leaderboards
+#define SIL_DB_BOARD_RATING		0
+#define SIL_DB_BOARD_KILLRATING	1
+#define SIL_DB_BOARD_KILLS		2
+#define SIL_DB_BOARD_XP			3					// the sum of the skills
+#define SIL_DB_BOARD_SKILL(s)	(4 + (s))			// one skill, 0 - SK_NUM_SKILLS-1
+#define SIL_DB_BOARD_LASTSEEN	(4 + SK_NUM_SKILLS)	// the most recently seen first
+#define SIL_DB_BOARD_LASTXPSAVE	(5 + SK_NUM_SKILLS)	// the most recent xp save first
+#define SIL_DB_BOARDS			(6 + SK_NUM_SKILLS)
+#define SIL_DB_MAXBOARDPAGE		64					// the results of one query
+
+/**
+ * Fetches a page of a leaderboard, the highest score first. The users with zero score are not
+ * ranked. The results can be read with G_DB_GetLeaderboardUser until the buffers are saved or
+ * the next query.
+ *
+ * @param board SIL_DB_BOARD_ of the leaderboard
+ * @param rank the rank of the first user of the page, starting from 1
+ * @param count the size of the page, at most SIL_DB_MAXBOARDPAGE
+ *
+ * @return the amount of fetched users, less than count at the end of the board, or -1 on error
+ */
+int G_DB_GetLeaderboard(int board, uint32_t rank, uint32_t count);
+/**
+ * Gets a user of the last fetched leaderboard page.
+ *
+ * @param position 0 - G_DB_GetLeaderboard()-1
+ * @param handle pointer to the handle that will be filled with the user
+ * @param rank optional, set to the rank of the user
+ * @param score optional, set to the score the user is ranked by
+ *
+ * @return qboolean true if handle was set, false otherwise
+ */
+qboolean G_DB_GetLeaderboardUser(uint32_t position, g_shrubbot_user_handle_t *handle, uint32_t *rank, float *score);
+/**
+ * Finds the rank of the player on a leaderboard.
+ *
+ * @param board SIL_DB_BOARD_ of the leaderboard
+ * @param guid The normalized silEnT GUID of the player, see G_DB_GUID_Set
+ * @param ranked optional, set to the amount of the ranked users
+ *
+ * @return the rank starting from 1, 0 if the player is not ranked or -1 if the player is not found
+ */
+int G_DB_GetLeaderboardRank(int board, const db_guid_t *guid, uint32_t *ranked);
+
+// rating distributions for the team balancing, query them with G_DB_Kll_Quantile and G_DB_Kll_Rank
+/**
+ * Gets the distribution of the ratings of all the rated users. The sketch is kept up to date as the
+ * ratings are saved, so it is cheap enough to be queried every round.
+ *
+ * @return the sketch, valid until the next database call, or NULL if there isn't usable DB
+ */
+const db_kll_t* G_DB_GetRatingSketch(void);
+/**
+ * Gets the distribution of the ratings of the connected rated players.
+ *
+ * @return the sketch, valid until the next call, or NULL if there isn't usable DB
+ */
+const db_kll_t* G_DB_GetConnectedRatingSketch(void);
+
 // mutes
 void G_DB_SetMuteData(gentity_t *ent, const char *reason, const char * mutedby);
 g_shrubbot_mutedata_t* G_DB_GetMuteData(gentity_t *ent);
@@ -268,6 +370,19 @@ g_shrubbot_user_handle_t* G_DB_GetUserHandleWithoutBuffering(const char* guid);
 g_shrubbot_user_handle_t* G_DB_CreateUserRecord(const char* sil_guid, const char* pbguid);
 // for faster accesses, the rules for pointers still apply
 qboolean G_DB_GetUserHandleLocal(const char* guid, g_shrubbot_user_handle_t* handle);
+// the same with already normalized GUIDs, see G_DB_GUID_Set and G_DB_GetClientGUID
+g_shrubbot_user_handle_t* G_DB_GetUserHandleGUID(const db_guid_t* guid);
+g_shrubbot_user_handle_t* G_DB_GetUserHandlePBGUID(const db_guid_t* guid);
+qboolean G_DB_GetUserHandleLocalGUID(const db_guid_t* guid, g_shrubbot_user_handle_t* handle);
+
+/**
+ * Get the silEnT GUID of the client normalized when the client connected.
+ *
+ * @param ent The client entity
+ *
+ * @return the GUID or NULL if the client has no valid silEnT GUID
+ */
+const db_guid_t* G_DB_GetClientGUID(gentity_t *ent);
 
 // G_DB_UpdateFromHandle updates all the data there is in the handle to the
 // buffered clients. Don't use freehandle for locally created handles.
@@ -275,10 +390,42 @@ void G_DB_UpdateFromHandle(g_shrubbot_user_handle_t* handle, qboolean freehandle
 
 // Iteration through all buffered and disconnected users
 //
+// The buffered users are kept in two dense partitions, the connected and the disconnected ones, so
+// an iteration only visits the users it returns. The iterators are owned by the caller and any
+// amount of them can be used at the same time. A connect or a disconnect moves users between the
+// partitions, so an iteration over such a change may skip or repeat users.
+//
+// Example:
+//	g_shrubbot_user_iterator_t it;
+//	g_shrubbot_user_handle_t handle;
+//
+//	for( G_DB_IterateConnected(&it); G_DB_IteratorNext(&it, &handle) ; ) {
+//		...
+//	}
+
+typedef struct g_shrubbot_user_iterator_s {
+	uint32_t	position;	// within the partition
+	qboolean	connected;	// the partition
+} g_shrubbot_user_iterator_t;
+
+// Functions set the iterator to the first connected or disconnected user in the buffer
+void G_DB_IterateConnected(g_shrubbot_user_iterator_t *iterator);
+void G_DB_IterateDisconnected(g_shrubbot_user_iterator_t *iterator);
+/**
+ * Gets the user at the iterator and moves the iterator to the next user.
+ *
+ * @param iterator set with G_DB_IterateConnected or G_DB_IterateDisconnected
+ * @param handle pointer to the handle that will be filled with the user
+ *
+ * @return qboolean true if handle was set, false at the end of the partition
+ */
+qboolean G_DB_IteratorNext(g_shrubbot_user_iterator_t *iterator, g_shrubbot_user_handle_t *handle);
+
 // The G_DB_GetFirst(Disconnected/Connected) will reset internal iterator to the first disconnected
 // or connected client that is in the buffer. All subsequent calls to G_DB_GetNext(x) function
 // will give the rest of the disconnected/connected clients. When all the clients have been returned
-// exactly once, a qfalse is returned. The iterator is shared between the two function types.
+// exactly once, a qfalse is returned. The iterator is shared between the two function types, use
+// the iterators above for the nested loops.
 
 // Functions return qtrue if succesfull or qfalse if there are no more disconnected clients
 
@@ -328,6 +475,16 @@ g_shrubbot_user_handle_t* G_DB_GetUserHandleUserID(const char* userid);
  * @return handle to user
  */
 g_shrubbot_user_handle_t* G_DB_GetUserHandleUserIDPB(const char* userid);
+/**
+ * Count the users that can be found with the short id, the admin commands use
+ * this to tell that the id is ambiguous.
+ *
+ * @param userid 8 character ending of the silEnT or the PunkBuster GUID
+ *
+ * @return the amount of matching users that are not removed
+ */
+int G_DB_GetUserIDMatches(const char* userid);
+int G_DB_GetUserIDMatchesPB(const char* userid);
 uint32_t G_DB_GetUsercount(void);
 
 /**
@@ -351,6 +508,7 @@ qboolean G_DB_GetIteratedUser(g_shrubbot_user_handle_t *handle);
  *
  *  @param name The name(or pattern) to be sanitized
  *  @return pointer to a static buffer holding the sanitized output. The return value must be copied so it won't get changed in the following calls.
+ *          G_DB_NameScan_Sanitize is the reentrant version writing to the caller's buffer.
  */
 char* G_DB_SanitizeName(const char* name);
 
@@ -360,10 +518,14 @@ char* G_DB_SanitizeName(const char* name);
  * doesn't care colorcodes.
  * Users that are buffered but not in db yet are not searched.
  *
- * @param name_pattern the part of the name to search
+ * @param name_pattern the part of the name to search, ending with ~ and optionally the amount
+ *        of the allowed edits like "nade~1" for the approximate search, see g_db_fuzzy.h
  *
  * @param level level from which to search
  *
+ * @param IP address, CIDR block "a.b.c.d/n", range "a.b.c.d-e.f.g.h" or the first
+ *           octets of IPv4 address "a.b.c", IPv6 addresses are accepted too
+ *
  * @return qboolean true if results can be fetched, false otherwise
  */
 qboolean G_DB_SearchDatabase(const char* name_pattern, int32_t level, const char* IP);
@@ -394,6 +556,170 @@ qboolean G_DB_GetResultCount(void);
  */
 qboolean G_DB_GetResultUser(g_shrubbot_user_handle_t *handle);
 
+// Search sessions
+//
+// The functions above use the session of the console. Every client has its own session, so the
+// admins paging their own searches don't replace each other's results. The recent results are
+// shared between the sessions and reused until a searched value of a record changes, the results
+// that are not current anymore are searched again. The session of a client is cleared when the
+// client disconnects.
+
+/**
+ * Works like G_DB_SearchDatabase for the session of the client.
+ *
+ * @param clientNum the client slot, -1 for the console
+ */
+qboolean G_DB_SearchDatabaseSession(int clientNum, const char* name_pattern, int32_t level, const char* IP);
+/**
+ * Works like G_DB_GetResultCount for the session of the client.
+ *
+ * @param clientNum the client slot, -1 for the console
+ */
+uint32_t G_DB_GetResultCountSession(int clientNum);
+/**
+ * Works like G_DB_SetResultStart for the session of the client.
+ *
+ * @param clientNum the client slot, -1 for the console
+ */
+qboolean G_DB_SetResultStartSession(int clientNum, uint32_t index);
+/**
+ * Works like G_DB_GetResultUser for the session of the client.
+ *
+ * @param clientNum the client slot, -1 for the console
+ */
+qboolean G_DB_GetResultUserSession(int clientNum, g_shrubbot_user_handle_t *handle);
+
+// Streaming search cursors
+//
+// The cursor hands out the matches of a search a page at a time in the cache order, without the
+// result limit of G_DB_SearchDatabase. Only the last fetched page is kept, the cursor itself is
+// owned by the caller and continues from where the last page ended, so any amount of cursors can
+// be kept open and one can be stored to continue later. The cursors are valid until the cache is
+// loaded again.
+
+typedef struct g_shrubbot_searchcursor_s {
+	char		pattern[MAX_NAME_LENGTH];	// sanitized
+	int32_t		level;
+	char		IP[20];
+	uint32_t	position;	// the cache position the next page starts from
+	uint32_t	returned;	// the amount of the fetched users
+	uint32_t	total;		// the amount of the matches, an upper bound until exact is set
+	qboolean	exact;
+	qboolean	finished;	// all the matches have been fetched
+} g_shrubbot_searchcursor_t;
+
+/**
+ * Opens a cursor for the search. The parameters are the same as with G_DB_SearchDatabase, nothing
+ * is searched before the first fetch.
+ *
+ * @param cursor the cursor to open
+ * @param name_pattern the part of the name to search, NULL or empty for any name
+ * @param level level from which to search, -1 for any level
+ * @param IP the searched addresses like with G_DB_SearchDatabase, NULL or empty for any address
+ *
+ * @return qboolean true if the cursor can be fetched, false otherwise
+ */
+qboolean G_DB_OpenSearchCursor(g_shrubbot_searchcursor_t *cursor, const char *name_pattern, int32_t level, const char *IP);
+/**
+ * Fetches the next page of the matches of the cursor. The users are read with G_DB_GetCursorUser.
+ *
+ * @param cursor the opened cursor
+ * @param count the size of the page, from 1 to SIL_DB_MAXCURSORPAGE
+ *
+ * @return the amount of the fetched users, 0 once the cursor is finished, or -1 on error
+ */
+int G_DB_FetchSearchCursor(g_shrubbot_searchcursor_t *cursor, uint32_t count);
+/**
+ * Gets a user of the last fetched cursor page.
+ *
+ * @param position 0 - G_DB_FetchSearchCursor()-1
+ * @param handle pointer to the handle that will be filled with the user
+ *
+ * @return qboolean true if handle was set, false otherwise
+ */
+qboolean G_DB_GetCursorUser(uint32_t position, g_shrubbot_user_handle_t *handle);
+
+// Ranked searches
+//
+// The ranked search finds the matches of a search with the highest ranking key, like the most
+// recently seen players with the name. Only the best matches are kept, and with a key that has a
+// leaderboard the search walks the leaderboard from the top and stops as soon as no further match
+// can rank high enough, so the cost follows the amount of the wanted results more than the size of
+// the database.
+
+#define SIL_DB_RANK_LASTSEEN	0	// the last time the player was seen
+#define SIL_DB_RANK_LASTXPSAVE	1	// the last xp save of the player
+#define SIL_DB_RANK_PLAYTIME	2	// the time played with all the aliases, no leaderboard
+#define SIL_DB_RANK_KILLS		3
+#define SIL_DB_RANKKEYS			4
+#define SIL_DB_MAXRANKED		64	// the results of one ranked search
+
+/**
+ * Searches the users like G_DB_SearchDatabase and keeps the matches with the highest key, the equal
+ * keys in the cache order. The results can be read with G_DB_GetRankedUser until the cache is loaded
+ * again or the next ranked search.
+ *
+ * @param name_pattern the name searched
+ * @param level the level searched, -1 for any level
+ * @param IP the IP or the IP range searched, empty for any IP
+ * @param key SIL_DB_RANK_ of the ranking
+ * @param count the amount of the wanted results, at most SIL_DB_MAXRANKED
+ *
+ * @return the amount of the found users, less than count if there were fewer matches, or -1 on error
+ */
+int G_DB_SearchDatabaseRanked(const char *name_pattern, int32_t level, const char *IP, int key, uint32_t count);
+/**
+ * Gets a user of the last ranked search, the highest key first.
+ *
+ * @param position 0 - G_DB_SearchDatabaseRanked()-1
+ * @param handle pointer to the handle that will be filled with the user
+ * @param score optional, set to the key the user was ranked by
+ *
+ * @return qboolean true if handle was set, false otherwise
+ */
+qboolean G_DB_GetRankedUser(uint32_t position, g_shrubbot_user_handle_t *handle, uint32_t *score);
+
+// Joined user and alias queries
+//
+// The joined query finds the users fitting the user search whose aliases fit the alias search, like
+// the admins who have ever used a name. The side with fewer candidates is collected to a hash table
+// by the GUID hash and the other side is checked against it, so both databases are searched once.
+
+typedef struct g_shrubbot_joinquery_s {
+	const char	*alias_pattern;	// a name the user has used, NULL or empty for any
+	qboolean	alias_timed;	// only the aliases in use between alias_from and alias_to
+	int			alias_from;
+	int			alias_to;
+	const char	*name_pattern;	// the last used name of the user, NULL or empty for any
+	int32_t		min_level;		// -1 for no lower limit
+	int32_t		max_level;		// -1 for no upper limit
+	const char	*IP;			// like with G_DB_SearchDatabase, NULL or empty for any
+} g_shrubbot_joinquery_t;
+
+#define SIL_DB_MAXJOINRESULTS	256
+
+/**
+ * Runs the joined query. The patterns are searched like with G_DB_SearchDatabase and
+ * G_DB_SearchAliasesNamePattern, the fuzzy patterns included. The results are in the cache order
+ * and can be read with G_DB_GetJoinUser until the cache is loaded again or the next joined query.
+ * Users that are buffered but not in db yet are not searched.
+ *
+ * @param query the searches of both sides
+ *
+ * @return the amount of the found users, -1 if the DB or the aliases are not in use or out of
+ *         memory, or -2 if all the found ones can't fit into the results
+ */
+int G_DB_JoinQuery(const g_shrubbot_joinquery_t *query);
+/**
+ * Gets a user of the last joined query.
+ *
+ * @param position 0 - G_DB_JoinQuery()-1
+ * @param handle pointer to the handle that will be filled with the user
+ *
+ * @return qboolean true if handle was set, false otherwise
+ */
+qboolean G_DB_GetJoinUser(uint32_t position, g_shrubbot_user_handle_t *handle);
+
 /**
  * Check is the player whitelisted from IP bans
  *
@@ -402,8 +728,13 @@ qboolean G_DB_GetResultUser(g_shrubbot_user_handle_t *handle);
  * @return qboolean true if player is whitelisted, qfalse otherwise
  */
 qboolean G_DB_IsWhiteListed(const char *guid);
+qboolean G_DB_IsWhiteListedGUID(const db_guid_t *guid);
 
-
+/**
+ * Function marks the users who have not been seen within the retention of their level for
+ * removal. The retention comes from SIL_DB_RETENTION_FILENAME or from g_dbUserMaxAge for the levels
+ * not listed there. Only the expired users are visited.
+ */
 void G_DB_PruneUsers(void);
 
 #endif